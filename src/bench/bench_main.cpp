@@ -0,0 +1,152 @@
+#include "../game/main_app.h"
+
+// 3rd party
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
+
+// std
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// one turn around the spot the scenes are built around, looking at it the whole way
+	oeg::OegCameraPath makeOrbitPath(uint64_t frameCount)
+	{
+		constexpr int keyframeCount = 64;
+		const glm::vec3 center{0.0f, 0.0f, 2.5f};
+		constexpr float radius = 3.0f;
+		// the engine plays a path one simulation step per frame
+		const float duration = static_cast<float>(frameCount) * oeg::OegFixedTimestep::DEFAULT_STEP;
+
+		oeg::OegCameraPath path;
+		for (int i = 0; i <= keyframeCount; i++)
+		{
+			const float turn = static_cast<float>(i) / keyframeCount;
+			const float angle = turn * glm::two_pi<float>();
+			path.addKeyframe(oeg::CameraKeyframe{
+				turn * duration,
+				center + radius * glm::vec3(-std::sin(angle), 0.0f, -std::cos(angle)),
+				glm::vec3(0.0f, angle, 0.0f)
+			});
+		}
+		return path;
+	}
+
+	void printSummary(const std::string& name, const oeg::FrameStatSummary& summary)
+	{
+		// the time columns end in Ms, the others are counts
+		const char* unit = name.ends_with("Ms") ? " ms" : "";
+		std::cout << name << ": mean " << summary.mean << unit << ", p50 " << summary.p50 << unit << ", p95 "
+			<< summary.p95 << unit << ", p99 " << summary.p99 << unit << ", max " << summary.max << unit << " over "
+			<< summary.count << " frames\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	// flies a camera path through a scene for a fixed number of frames and writes the per-frame stage
+	// times, draw counts and pipeline statistics to PREFIX.csv and their percentiles to PREFIX.json, so
+	// runs can be compared across changes
+	oeg::EngineOptions options{};
+	options.recordFrameStats = true;
+	options.frameCount = 1000;
+	options.warmupFrames = 60;
+
+	std::string pathFile;
+	std::string outputPrefix = "bench";
+	std::string label;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (argument == "--frames" && i + 1 < argc)
+		{
+			options.frameCount = std::stoull(argv[++i]);
+		}
+		else if (argument == "--warmup" && i + 1 < argc)
+		{
+			options.warmupFrames = std::stoull(argv[++i]);
+		}
+		else if (argument == "--scene" && i + 1 < argc)
+		{
+			options.scene = argv[++i];
+		}
+		else if (argument == "--path" && i + 1 < argc)
+		{
+			pathFile = argv[++i];
+		}
+		else if (argument == "--output" && i + 1 < argc)
+		{
+			outputPrefix = argv[++i];
+		}
+		else if (argument == "--label" && i + 1 < argc)
+		{
+			label = argv[++i];
+		}
+		else if (argument == "--trace" && i + 1 < argc)
+		{
+			options.traceFile = argv[++i];
+		}
+		else if (argument == "--metrics" && i + 1 < argc)
+		{
+			options.metricsFile = argv[++i];
+		}
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--headless] [--frames N] [--warmup N] [--scene NAME]"
+				<< " [--path FILE] [--output PREFIX] [--label TEXT] [--trace FILE] [--metrics FILE]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (options.frameCount == 0 || options.warmupFrames >= options.frameCount)
+	{
+		std::cerr << "--frames has to be larger than --warmup\n";
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		options.cameraPath = pathFile.empty()
+			? makeOrbitPath(options.frameCount)
+			: oeg::OegCameraPath::loadFromFile(pathFile);
+
+		oeg::OegEngine app{options};
+		app.run();
+
+		const oeg::OegFrameStats& stats = *app.getFrameStats();
+		const std::vector<std::pair<std::string, std::string>> metadata{
+			{"scene", options.scene},
+			{"path", pathFile.empty() ? "orbit" : pathFile},
+			{"device", app.getDeviceName()},
+			{"headless", options.headless ? "true" : "false"},
+			{"label", label}
+		};
+		stats.writeCsv(outputPrefix + ".csv");
+		stats.writeJson(outputPrefix + ".json", metadata);
+
+		for (size_t column = 0; column < stats.getColumnNames().size(); column++)
+		{
+			printSummary(stats.getColumnNames()[column], stats.summarize(column));
+		}
+		std::cout << stats.countStutters() << " stutters over " << oeg::OegFrameStats::STUTTER_FACTOR
+			<< "x the median frame time\n";
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
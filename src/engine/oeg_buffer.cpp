@@ -6,6 +6,7 @@
  */
 
 #include "oeg_buffer.h"
+#include "oeg_trace.h"
 
 // std
 #include <cassert>
@@ -64,6 +65,7 @@ namespace oeg
 		{
 			throw std::runtime_error("Failed to create buffer with VMA");
 		}
+		OEG_TRACE_INSTANT("allocateBuffer", bufferSize);
 	}
 
 	OegBuffer::~OegBuffer()
@@ -73,6 +75,7 @@ namespace oeg
 			unmap(); // Ensure buffer is unmapped before destruction
 		}
 		vmaDestroyBuffer(allocator, buffer, allocation);
+		OEG_TRACE_INSTANT("freeBuffer", bufferSize);
 	}
 
 	/**
@@ -125,6 +128,7 @@ namespace oeg
 		auto memOffset = static_cast<char*>(mapped);
 		memOffset += offset;
 		memcpy(memOffset, data, size);
+		countUpload(size);
 	}
 
 	/**
@@ -140,20 +144,8 @@ namespace oeg
 	 */
 	VkResult OegBuffer::flush(VkDeviceSize size, VkDeviceSize offset) const
 	{
-		if (size == VK_WHOLE_SIZE)
-		{
-			size = bufferSize;
-		}
-
-		VmaAllocationInfo allocInfo;
-		vmaGetAllocationInfo(allocator, allocation, &allocInfo);
-
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = allocInfo.deviceMemory;
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkFlushMappedMemoryRanges(oegDevice.device(), 1, &mappedRange);
+		// vma adds the allocation's offset into its memory block and aligns to nonCoherentAtomSize
+		return vmaFlushAllocation(allocator, allocation, offset, size);
 	}
 
 	/**
@@ -169,12 +161,7 @@ namespace oeg
 	 */
 	VkResult OegBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	{
-		VkMappedMemoryRange mappedRange = {};
-		mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		mappedRange.memory = reinterpret_cast<VkDeviceMemory>(allocation);
-		mappedRange.offset = offset;
-		mappedRange.size = size;
-		return vkInvalidateMappedMemoryRanges(oegDevice.device(), 1, &mappedRange);
+		return vmaInvalidateAllocation(allocator, allocation, offset, size);
 	}
 
 	/**
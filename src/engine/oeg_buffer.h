@@ -2,6 +2,10 @@
 
 #include "oeg_device.h"
 
+// std
+#include <atomic>
+#include <cstdint>
+
 namespace oeg
 {
 	class OegBuffer
@@ -42,9 +46,16 @@ namespace oeg
 		VkMemoryPropertyFlags getMemoryPropertyFlags() const { return memoryPropertyFlags; }
 		VkDeviceSize getBufferSize() const { return bufferSize; }
 
+		// writes through getMappedMemory count themselves, writeToBuffer does it for its callers
+		static void countUpload(VkDeviceSize bytes) { uploadedBytes.fetch_add(bytes, std::memory_order_relaxed); }
+		// bytes written to mapped buffers by every thread since the last call
+		static uint64_t takeUploadedBytes() { return uploadedBytes.exchange(0, std::memory_order_relaxed); }
+
 	private:
 		static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
 
+		static inline std::atomic<uint64_t> uploadedBytes{0};
+
 
 		OegDevice& oegDevice;
 		void* mapped = nullptr;
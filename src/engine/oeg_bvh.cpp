@@ -0,0 +1,619 @@
+#include "oeg_bvh.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <numeric>
+
+namespace oeg
+{
+	namespace
+	{
+		struct Bin
+		{
+			glm::vec3 min{FLT_MAX};
+			glm::vec3 max{-FLT_MAX};
+			uint32_t count{0};
+		};
+
+		float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+		{
+			const glm::vec3 size = max - min;
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		bool overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+		{
+			return minA.x <= maxB.x && maxA.x >= minB.x &&
+				minA.y <= maxB.y && maxA.y >= minB.y &&
+				minA.z <= maxB.z && maxA.z >= minB.z;
+		}
+
+		// distance along the ray to where it enters the box, FLT_MAX if it misses
+		float intersectRay(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max)
+		{
+			const glm::vec3 t0 = (min - origin) * inverseDirection;
+			const glm::vec3 t1 = (max - origin) * inverseDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			const float exit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+			return enter <= exit ? enter : FLT_MAX;
+		}
+
+		enum class FrustumTest
+		{
+			Outside,
+			Intersecting,
+			Inside
+		};
+
+		FrustumTest testFrustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& min, const glm::vec3& max)
+		{
+			const glm::vec3 center = (min + max) * 0.5f;
+			const glm::vec3 extent = (max - min) * 0.5f;
+
+			FrustumTest result = FrustumTest::Inside;
+			for (const glm::vec4& plane : planes)
+			{
+				const glm::vec3 normal{plane};
+				const float distance = glm::dot(normal, center) + plane.w;
+				const float radius = glm::dot(glm::abs(normal), extent);
+				if (distance + radius < 0.0f)
+				{
+					return FrustumTest::Outside;
+				}
+				if (distance - radius < 0.0f)
+				{
+					result = FrustumTest::Intersecting;
+				}
+			}
+			return result;
+		}
+
+		// adds one query's time to the totals when it goes out of scope, whichever way the query returns
+		class QueryTimer
+		{
+		public:
+			QueryTimer(std::atomic<uint64_t>& nanoseconds, std::atomic<uint32_t>& count)
+				: nanoseconds{nanoseconds}, count{count}, startTime{std::chrono::high_resolution_clock::now()}
+			{
+			}
+
+			~QueryTimer()
+			{
+				const auto elapsed = std::chrono::high_resolution_clock::now() - startTime;
+				nanoseconds.fetch_add(
+					static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+					std::memory_order_relaxed);
+				count.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			QueryTimer(const QueryTimer&) = delete;
+			QueryTimer& operator=(const QueryTimer&) = delete;
+
+		private:
+			std::atomic<uint64_t>& nanoseconds;
+			std::atomic<uint32_t>& count;
+			std::chrono::high_resolution_clock::time_point startTime;
+		};
+	}
+
+	BoundingBox transformBox(const BoundingBox& box, const glm::mat4& modelMatrix)
+	{
+		const glm::vec3 center{modelMatrix * glm::vec4{box.center(), 1.0f}};
+		const glm::vec3 extent = box.extent();
+		const glm::vec3 worldExtent{
+			glm::abs(modelMatrix[0][0]) * extent.x + glm::abs(modelMatrix[1][0]) * extent.y + glm::abs(modelMatrix[2][0]) * extent.z,
+			glm::abs(modelMatrix[0][1]) * extent.x + glm::abs(modelMatrix[1][1]) * extent.y + glm::abs(modelMatrix[2][1]) * extent.z,
+			glm::abs(modelMatrix[0][2]) * extent.x + glm::abs(modelMatrix[1][2]) * extent.y + glm::abs(modelMatrix[2][2]) * extent.z
+		};
+		return BoundingBox{center - worldExtent, center + worldExtent};
+	}
+
+	void OegBvh::updateLeafBounds(BvhNode& node) const
+	{
+		node.min = glm::vec3{FLT_MAX};
+		node.max = glm::vec3{-FLT_MAX};
+		for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+		{
+			const BoundingBox& bounds = primitiveBounds[primitiveOrder[i]];
+			node.min = glm::min(node.min, bounds.min);
+			node.max = glm::max(node.max, bounds.max);
+		}
+	}
+
+	/**
+		* Bins the centroids along every axis and picks the split with the lowest surface area
+		* heuristic, left area * left count + right area * right count. Children are allocated as a
+		* pair from the shared node counter, so subtrees on different threads never touch the same
+		* nodes or the same part of primitiveOrder.
+	*/
+	void OegBvh::subdivide(uint32_t nodeIndex)
+	{
+		BvhNode& node = nodes[nodeIndex];
+		if (node.count <= MAX_LEAF_SIZE)
+		{
+			return;
+		}
+
+		const auto begin = primitiveOrder.begin() + node.leftFirst;
+		const auto end = begin + node.count;
+
+		glm::vec3 centroidMin{FLT_MAX};
+		glm::vec3 centroidMax{-FLT_MAX};
+		for (auto it = begin; it != end; ++it)
+		{
+			centroidMin = glm::min(centroidMin, centroids[*it]);
+			centroidMax = glm::max(centroidMax, centroids[*it]);
+		}
+
+		// all three axes are binned in one pass, so every primitive is only loaded once
+		const glm::vec3 centroidExtent = centroidMax - centroidMin;
+		glm::vec3 scale{0.0f};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scale[axis] = centroidExtent[axis] > 0.0f ? BIN_COUNT / centroidExtent[axis] : 0.0f;
+		}
+		std::array<std::array<Bin, BIN_COUNT>, 3> axisBins{};
+		for (auto it = begin; it != end; ++it)
+		{
+			const glm::vec3 offset = (centroids[*it] - centroidMin) * scale;
+			const BoundingBox& bounds = primitiveBounds[*it];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				Bin& bin = axisBins[axis][std::min(BIN_COUNT - 1, static_cast<uint32_t>(offset[axis]))];
+				bin.count++;
+				bin.min = glm::min(bin.min, bounds.min);
+				bin.max = glm::max(bin.max, bounds.max);
+			}
+		}
+
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (centroidExtent[axis] <= 0.0f)
+			{
+				continue;
+			}
+			const std::array<Bin, BIN_COUNT>& bins = axisBins[axis];
+
+			// split s puts bins [0, s] on the left
+			std::array<float, BIN_COUNT - 1> leftCosts{};
+			Bin left{};
+			for (uint32_t s = 0; s < BIN_COUNT - 1; s++)
+			{
+				left.count += bins[s].count;
+				left.min = glm::min(left.min, bins[s].min);
+				left.max = glm::max(left.max, bins[s].max);
+				leftCosts[s] = left.count > 0 ? left.count * surfaceArea(left.min, left.max) : 0.0f;
+			}
+			Bin right{};
+			for (uint32_t s = BIN_COUNT - 1; s > 0; s--)
+			{
+				right.count += bins[s].count;
+				right.min = glm::min(right.min, bins[s].min);
+				right.max = glm::max(right.max, bins[s].max);
+				const float cost = leftCosts[s - 1] + (right.count > 0 ? right.count * surfaceArea(right.min, right.max) : 0.0f);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = s - 1;
+				}
+			}
+		}
+
+		// every centroid in the same spot, no split separates them
+		if (bestAxis < 0)
+		{
+			return;
+		}
+
+		const auto middle = std::partition(begin, end, [&](uint32_t primitive)
+		{
+			const float offset = (centroids[primitive][bestAxis] - centroidMin[bestAxis]) * scale[bestAxis];
+			return std::min(BIN_COUNT - 1, static_cast<uint32_t>(offset)) <= bestSplit;
+		});
+		const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+		if (leftCount == 0 || leftCount == node.count)
+		{
+			return;
+		}
+
+		const uint32_t leftChild = nodeCount.fetch_add(2);
+		nodes[leftChild] = BvhNode{{}, node.leftFirst, {}, leftCount};
+		nodes[leftChild + 1] = BvhNode{{}, node.leftFirst + leftCount, {}, node.count - leftCount};
+		nodeParents[leftChild] = nodeIndex;
+		nodeParents[leftChild + 1] = nodeIndex;
+		updateLeafBounds(nodes[leftChild]);
+		updateLeafBounds(nodes[leftChild + 1]);
+
+		const uint32_t count = node.count;
+		node.leftFirst = leftChild;
+		node.count = 0;
+
+		// every large subtree becomes a job, idle workers steal the ones this thread has not reached yet
+		if (count > PARALLEL_THRESHOLD)
+		{
+			OegJobSystem& jobSystem = OegJobSystem::get();
+			JobCounter counter;
+			jobSystem.schedule([this, leftChild]
+			{
+				subdivide(leftChild);
+			}, &counter);
+			subdivide(leftChild + 1);
+			jobSystem.wait(counter);
+		}
+		else
+		{
+			subdivide(leftChild);
+			subdivide(leftChild + 1);
+		}
+	}
+
+	void OegBvh::build(const OegRegistry& registry)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		const std::vector<std::shared_ptr<OegModel>>& models = registry.getModels();
+		const std::vector<WorldTransform>& worldTransforms = registry.getWorldTransforms();
+
+		primitiveBounds.clear();
+		centroids.clear();
+		objectIndices.clear();
+		primitiveOfObject.assign(registry.size(), NO_PRIMITIVE);
+		for (uint32_t i = 0; i < registry.size(); i++)
+		{
+			if (!models[i])
+			{
+				continue;
+			}
+			primitiveOfObject[i] = static_cast<uint32_t>(objectIndices.size());
+			objectIndices.push_back(i);
+			primitiveBounds.push_back(transformBox(models[i]->getBoundingBox(), worldTransforms[i].modelMatrix));
+			centroids.push_back(primitiveBounds.back().center());
+		}
+
+		const uint32_t primitiveCount = static_cast<uint32_t>(objectIndices.size());
+		primitiveOrder.resize(primitiveCount);
+		std::iota(primitiveOrder.begin(), primitiveOrder.end(), 0u);
+		leafOfPrimitive.resize(primitiveCount);
+
+		nodes.clear();
+		nodeParents.clear();
+		nodeCount = 0;
+		if (primitiveCount > 0)
+		{
+			// a binary tree with at most one primitive per leaf never needs more
+			nodes.resize(2 * static_cast<size_t>(primitiveCount) - 1);
+			nodeParents.assign(nodes.size(), NO_NODE);
+			nodes[0] = BvhNode{{}, 0, {}, primitiveCount};
+			updateLeafBounds(nodes[0]);
+			nodeCount = 1;
+			subdivide(0);
+
+			nodes.resize(nodeCount);
+			nodeParents.resize(nodeCount);
+			for (uint32_t i = 0; i < nodes.size(); i++)
+			{
+				const BvhNode& node = nodes[i];
+				for (uint32_t p = node.leftFirst; p < node.leftFirst + node.count; p++)
+				{
+					leafOfPrimitive[primitiveOrder[p]] = i;
+				}
+			}
+		}
+
+		areaSum = computeAreaSum();
+		builtLayoutVersion = registry.getLayoutVersion();
+
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.nodeCount = static_cast<uint32_t>(nodes.size());
+		stats.primitiveCount = primitiveCount;
+		stats.rebuildCount++;
+		stats.buildSahCost = sahCost();
+		stats.sahCost = stats.buildSahCost;
+		stats.buildTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+
+	bool OegBvh::refitNode(uint32_t nodeIndex)
+	{
+		BvhNode& node = nodes[nodeIndex];
+		const glm::vec3 oldMin = node.min;
+		const glm::vec3 oldMax = node.max;
+		if (node.isLeaf())
+		{
+			updateLeafBounds(node);
+		}
+		else
+		{
+			const BvhNode& left = nodes[node.leftFirst];
+			const BvhNode& right = nodes[node.leftFirst + 1];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+
+		if (node.min == oldMin && node.max == oldMax)
+		{
+			return false;
+		}
+		areaSum += static_cast<double>(surfaceArea(node.min, node.max) - surfaceArea(oldMin, oldMax)) * nodeWeight(node);
+		return true;
+	}
+
+	/**
+		* Few moved objects walk up from their leaves and stop at the first node whose bounds stay the
+		* same. Many moved objects take one pass over all nodes from the back, children always sit
+		* after their parent so they are refitted first.
+	*/
+	void OegBvh::refit(const OegRegistry& registry, const std::vector<DirtyRange>& worldDirty)
+	{
+		const std::vector<std::shared_ptr<OegModel>>& models = registry.getModels();
+		const std::vector<WorldTransform>& worldTransforms = registry.getWorldTransforms();
+
+		std::vector<uint32_t> movedPrimitives;
+		for (const DirtyRange& range : worldDirty)
+		{
+			for (uint32_t i = range.first; i < range.first + range.count; i++)
+			{
+				const uint32_t primitive = primitiveOfObject[i];
+				if (primitive == NO_PRIMITIVE)
+				{
+					continue;
+				}
+				primitiveBounds[primitive] = transformBox(models[i]->getBoundingBox(), worldTransforms[i].modelMatrix);
+				centroids[primitive] = primitiveBounds[primitive].center();
+				movedPrimitives.push_back(primitive);
+			}
+		}
+
+		uint32_t refitCount = 0;
+		if (movedPrimitives.size() > FULL_REFIT_FRACTION * objectIndices.size())
+		{
+			for (uint32_t i = static_cast<uint32_t>(nodes.size()); i-- > 0;)
+			{
+				refitNode(i);
+			}
+			// the incremental sum drifts over many refits, start over from the exact one
+			areaSum = computeAreaSum();
+			refitCount = static_cast<uint32_t>(nodes.size());
+		}
+		else
+		{
+			for (uint32_t primitive : movedPrimitives)
+			{
+				uint32_t node = leafOfPrimitive[primitive];
+				while (node != NO_NODE && refitNode(node))
+				{
+					refitCount++;
+					node = nodeParents[node];
+				}
+			}
+		}
+		stats.refitNodeCount = refitCount;
+	}
+
+	void OegBvh::update(const OegRegistry& registry, const std::vector<DirtyRange>& worldDirty)
+	{
+		queryNanoseconds.store(0, std::memory_order_relaxed);
+		queryCount.store(0, std::memory_order_relaxed);
+		// a frame that rebuilds does not refit
+		stats.refitNodeCount = 0;
+		stats.refitTimeMs = 0.0f;
+
+		if (registry.getLayoutVersion() != builtLayoutVersion)
+		{
+			build(registry);
+			return;
+		}
+
+		if (worldDirty.empty() || nodes.empty())
+		{
+			return;
+		}
+
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		refit(registry, worldDirty);
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.refitTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+
+		stats.sahCost = sahCost();
+		if (stats.sahCost > stats.buildSahCost * REBUILD_COST_RATIO)
+		{
+			build(registry);
+		}
+	}
+
+	double OegBvh::computeAreaSum() const
+	{
+		double sum = 0.0;
+		for (const BvhNode& node : nodes)
+		{
+			sum += static_cast<double>(surfaceArea(node.min, node.max)) * nodeWeight(node);
+		}
+		return sum;
+	}
+
+	// expected cost of a random ray through the tree, relative to testing the root's box once
+	float OegBvh::sahCost() const
+	{
+		if (nodes.empty())
+		{
+			return 0.0f;
+		}
+		const float rootArea = surfaceArea(nodes[0].min, nodes[0].max);
+		return rootArea > 0.0f ? static_cast<float>(areaSum / rootArea) : 0.0f;
+	}
+
+	void OegBvh::collectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& results) const
+	{
+		std::vector<uint32_t> stack{nodeIndex};
+		while (!stack.empty())
+		{
+			const BvhNode& node = nodes[stack.back()];
+			stack.pop_back();
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				{
+					results.push_back(objectIndices[primitiveOrder[i]]);
+				}
+			}
+			else
+			{
+				stack.push_back(node.leftFirst);
+				stack.push_back(node.leftFirst + 1);
+			}
+		}
+	}
+
+	BvhStats OegBvh::getStats() const
+	{
+		BvhStats current = stats;
+		current.queryCount = queryCount.load(std::memory_order_relaxed);
+		current.queryTimeMs = static_cast<float>(queryNanoseconds.load(std::memory_order_relaxed)) / 1000000.0f;
+		return current;
+	}
+
+	void OegBvh::queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const
+	{
+		QueryTimer timer{queryNanoseconds, queryCount};
+		results.clear();
+		if (nodes.empty())
+		{
+			return;
+		}
+
+		std::vector<uint32_t> stack{0};
+		while (!stack.empty())
+		{
+			const BvhNode& node = nodes[stack.back()];
+			stack.pop_back();
+			if (!overlaps(node.min, node.max, box.min, box.max))
+			{
+				continue;
+			}
+			if (!node.isLeaf())
+			{
+				stack.push_back(node.leftFirst);
+				stack.push_back(node.leftFirst + 1);
+				continue;
+			}
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const BoundingBox& bounds = primitiveBounds[primitiveOrder[i]];
+				if (overlaps(bounds.min, bounds.max, box.min, box.max))
+				{
+					results.push_back(objectIndices[primitiveOrder[i]]);
+				}
+			}
+		}
+	}
+
+	void OegBvh::queryFrustum(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>& results) const
+	{
+		QueryTimer timer{queryNanoseconds, queryCount};
+		results.clear();
+		if (nodes.empty())
+		{
+			return;
+		}
+
+		std::vector<uint32_t> stack{0};
+		while (!stack.empty())
+		{
+			const uint32_t nodeIndex = stack.back();
+			const BvhNode& node = nodes[nodeIndex];
+			stack.pop_back();
+
+			const FrustumTest test = testFrustum(frustumPlanes, node.min, node.max);
+			if (test == FrustumTest::Outside)
+			{
+				continue;
+			}
+			// nothing below a node that is fully inside needs testing
+			if (test == FrustumTest::Inside)
+			{
+				collectSubtree(nodeIndex, results);
+				continue;
+			}
+			if (!node.isLeaf())
+			{
+				stack.push_back(node.leftFirst);
+				stack.push_back(node.leftFirst + 1);
+				continue;
+			}
+			for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+			{
+				const BoundingBox& bounds = primitiveBounds[primitiveOrder[i]];
+				if (testFrustum(frustumPlanes, bounds.min, bounds.max) != FrustumTest::Outside)
+				{
+					results.push_back(objectIndices[primitiveOrder[i]]);
+				}
+			}
+		}
+	}
+
+	bool OegBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+	{
+		QueryTimer timer{queryNanoseconds, queryCount};
+		if (nodes.empty())
+		{
+			return false;
+		}
+
+		// divisions by zero give infinities, which the slab test handles
+		const glm::vec3 inverseDirection = 1.0f / direction;
+		float closest = maxDistance;
+		bool found = false;
+
+		std::vector<uint32_t> stack{0};
+		while (!stack.empty())
+		{
+			const BvhNode& node = nodes[stack.back()];
+			stack.pop_back();
+			if (intersectRay(origin, inverseDirection, node.min, node.max) >= closest)
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				{
+					const BoundingBox& bounds = primitiveBounds[primitiveOrder[i]];
+					const float distance = intersectRay(origin, inverseDirection, bounds.min, bounds.max);
+					if (distance < closest)
+					{
+						closest = distance;
+						hit = RayHit{objectIndices[primitiveOrder[i]], distance};
+						found = true;
+					}
+				}
+				continue;
+			}
+
+			// the nearer child goes on top, so hits found there prune the farther one
+			const uint32_t left = node.leftFirst;
+			const uint32_t right = node.leftFirst + 1;
+			const float leftDistance = intersectRay(origin, inverseDirection, nodes[left].min, nodes[left].max);
+			const float rightDistance = intersectRay(origin, inverseDirection, nodes[right].min, nodes[right].max);
+			if (leftDistance < rightDistance)
+			{
+				stack.push_back(right);
+				stack.push_back(left);
+			}
+			else
+			{
+				stack.push_back(left);
+				stack.push_back(right);
+			}
+		}
+		return found;
+	}
+}
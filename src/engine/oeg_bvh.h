@@ -0,0 +1,138 @@
+#pragma once
+
+#include "oeg_model.h"
+#include "oeg_registry.h"
+#include "oeg_transform_updater.h"
+
+// glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * \brief Axis aligned box of a model moved into world space, still tight for rotated boxes' extents
+	 */
+	BoundingBox transformBox(const BoundingBox& box, const glm::mat4& modelMatrix);
+
+	// 32 bytes, two per cache line
+	struct BvhNode
+	{
+		glm::vec3 min{0.0f};
+		uint32_t leftFirst{0}; // left child for inner nodes, right child is leftFirst + 1, first primitive for leaves
+		glm::vec3 max{0.0f};
+		uint32_t count{0}; // primitives in a leaf, 0 for inner nodes
+
+		bool isLeaf() const { return count > 0; }
+	};
+
+	struct RayHit
+	{
+		uint32_t objectIndex{0};
+		float distance{0.0f};
+	};
+
+	struct BvhStats
+	{
+		uint32_t nodeCount{0};
+		uint32_t primitiveCount{0};
+		uint32_t refitNodeCount{0};
+		uint32_t rebuildCount{0};
+		float buildSahCost{0.0f};
+		float sahCost{0.0f};
+		float buildTimeMs{0.0f};
+		float refitTimeMs{0.0f};
+		// queries since the last update, summed over every thread that ran one
+		uint32_t queryCount{0};
+		float queryTimeMs{0.0f};
+	};
+
+	/**
+	 * Bounding volume hierarchy over the world space bounds of every entity with a model, for
+	 * "what is in this box, frustum or along this ray" without scanning every object. Results are
+	 * dense registry indices.
+	 *
+	 * The tree is built top down with binned SAH splits, large subtrees as jobs. When
+	 * objects move their leaves are refitted and the change is walked up only as far as it grows a
+	 * parent. Refitting never changes the topology, so moving objects slowly degrade the tree; once its
+	 * SAH cost has grown by REBUILD_COST_RATIO over the cost at build time it is rebuilt from scratch.
+	 */
+	class OegBvh
+	{
+	public:
+		static constexpr uint32_t MAX_LEAF_SIZE = 4;
+		static constexpr uint32_t BIN_COUNT = 16;
+		// subtrees with more primitives than this are split as their own job
+		static constexpr size_t PARALLEL_THRESHOLD = 4096;
+		static constexpr float REBUILD_COST_RATIO = 1.5f;
+		// above this share of moved primitives one bottom up pass over all nodes beats walking up from each leaf
+		static constexpr float FULL_REFIT_FRACTION = 0.25f;
+
+		OegBvh() = default;
+
+		OegBvh(const OegBvh&) = delete;
+		OegBvh& operator=(const OegBvh&) = delete;
+
+		/**
+		 * \brief Builds when entities were created or destroyed since the last build, otherwise refits the
+		 * entities in worldDirty (see OegSceneGraph::getDirtyRanges) and rebuilds if the tree got too loose
+		 */
+		void update(const OegRegistry& registry, const std::vector<DirtyRange>& worldDirty);
+		void build(const OegRegistry& registry);
+
+		// queries only read the tree, any number of threads may run them at once
+		void queryBox(const BoundingBox& box, std::vector<uint32_t>& results) const;
+		void queryFrustum(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>& results) const;
+		// closest object whose bounds the ray enters within maxDistance, direction must be normalized
+		bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const;
+
+		const std::vector<BvhNode>& getNodes() const { return nodes; }
+		// a copy, the query totals keep changing while queries run
+		BvhStats getStats() const;
+
+	private:
+		static constexpr uint32_t NO_PRIMITIVE = ~0u;
+		static constexpr uint32_t NO_NODE = ~0u;
+
+		void subdivide(uint32_t nodeIndex);
+		void updateLeafBounds(BvhNode& node) const;
+		// returns whether the bounds changed
+		bool refitNode(uint32_t nodeIndex);
+		void refit(const OegRegistry& registry, const std::vector<DirtyRange>& worldDirty);
+		double computeAreaSum() const;
+		float nodeWeight(const BvhNode& node) const { return node.isLeaf() ? static_cast<float>(node.count) : 1.0f; }
+		float sahCost() const;
+		// leaves of one subtree, for queries that hit a node fully inside the volume
+		void collectSubtree(uint32_t nodeIndex, std::vector<uint32_t>& results) const;
+
+		std::vector<BvhNode> nodes;
+		std::vector<uint32_t> nodeParents;
+		std::atomic<uint32_t> nodeCount{0};
+
+		// indexed by primitive, primitives are the entities with a model
+		std::vector<BoundingBox> primitiveBounds;
+		std::vector<glm::vec3> centroids;
+		std::vector<uint32_t> objectIndices;
+		std::vector<uint32_t> leafOfPrimitive;
+		// leaves reference consecutive runs of this, reordered during the build
+		std::vector<uint32_t> primitiveOrder;
+		// primitive of every dense index, NO_PRIMITIVE for entities without a model
+		std::vector<uint32_t> primitiveOfObject;
+
+		// sum of surface area times SAH weight over all nodes, kept up to date by the refit
+		double areaSum{0.0};
+		uint64_t builtLayoutVersion{~0ull};
+
+		BvhStats stats{};
+		// written by const queries from any thread, reset by update
+		mutable std::atomic<uint64_t> queryNanoseconds{0};
+		mutable std::atomic<uint32_t> queryCount{0};
+	};
+}
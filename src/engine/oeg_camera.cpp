@@ -106,4 +106,35 @@ namespace oeg
 		viewMatrix[3][1] = -dot(v, position);
 		viewMatrix[3][2] = -dot(w, position);
 	}
+
+	/**
+		* Extracts the world space frustum planes from projection * view (Gribb/Hartmann).
+		* Planes point inwards and are normalized, so dot(plane.xyz, p) + plane.w is the signed
+		* distance of p to the plane. Clip space depth is [0, 1] (GLM_FORCE_DEPTH_ZERO_TO_ONE).
+		*
+		* @return The left, right, bottom, top, near and far planes, in that order.
+	*/
+	std::array<glm::vec4, 6> OegCamera::getFrustumPlanes() const
+	{
+		const glm::mat4 projectionView = projectionMatrix * viewMatrix;
+		const glm::vec4 row0{projectionView[0][0], projectionView[1][0], projectionView[2][0], projectionView[3][0]};
+		const glm::vec4 row1{projectionView[0][1], projectionView[1][1], projectionView[2][1], projectionView[3][1]};
+		const glm::vec4 row2{projectionView[0][2], projectionView[1][2], projectionView[2][2], projectionView[3][2]};
+		const glm::vec4 row3{projectionView[0][3], projectionView[1][3], projectionView[2][3], projectionView[3][3]};
+
+		std::array<glm::vec4, 6> planes{
+			row3 + row0, // left
+			row3 - row0, // right
+			row3 + row1, // bottom
+			row3 - row1, // top
+			row2, // near
+			row3 - row2, // far
+		};
+
+		for (auto& plane : planes)
+		{
+			plane /= glm::length(glm::vec3{plane});
+		}
+		return planes;
+	}
 }
@@ -5,6 +5,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm/glm.hpp"
 
+// std
+#include <array>
+
 namespace oeg
 {
 	class OegCamera
@@ -37,6 +40,11 @@ namespace oeg
 		const glm::mat4& getProjection() const { return projectionMatrix; }
 		const glm::mat4& getView() const { return viewMatrix; }
 
+		/**
+		 * \brief World space frustum planes (left, right, bottom, top, near, far), xyz = normal, w = distance
+		 */
+		std::array<glm::vec4, 6> getFrustumPlanes() const;
+
 	private:
 		glm::mat4 projectionMatrix{1.0f};
 		glm::mat4 viewMatrix{1.0f};
@@ -0,0 +1,101 @@
+#include "oeg_camera_path.h"
+#include "oeg_fixed_timestep.h"
+
+// std
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace oeg
+{
+	OegCameraPath OegCameraPath::loadFromFile(const std::string& filepath)
+	{
+		std::ifstream file{filepath};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open camera path: " + filepath);
+		}
+
+		OegCameraPath path;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream stream{line};
+			CameraKeyframe keyframe{};
+			stream >> keyframe.time
+				>> keyframe.translation.x >> keyframe.translation.y >> keyframe.translation.z
+				>> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z;
+			if (stream.fail())
+			{
+				throw std::runtime_error("malformed camera path keyframe in " + filepath + ": " + line);
+			}
+			path.addKeyframe(keyframe);
+		}
+		return path;
+	}
+
+	void OegCameraPath::saveToFile(const std::string& filepath) const
+	{
+		std::ofstream file{filepath};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to write camera path: " + filepath);
+		}
+
+		file << "# time x y z rotationX rotationY rotationZ\n";
+		for (const CameraKeyframe& keyframe : keyframes)
+		{
+			file << keyframe.time << ' '
+				<< keyframe.translation.x << ' ' << keyframe.translation.y << ' ' << keyframe.translation.z << ' '
+				<< keyframe.rotation.x << ' ' << keyframe.rotation.y << ' ' << keyframe.rotation.z << '\n';
+		}
+	}
+
+	void OegCameraPath::addKeyframe(const CameraKeyframe& keyframe)
+	{
+		if (!keyframes.empty() && keyframe.time < keyframes.back().time)
+		{
+			throw std::runtime_error("camera path keyframes have to be added in order of time");
+		}
+		keyframes.push_back(keyframe);
+	}
+
+	CameraKeyframe OegCameraPath::sample(float time) const
+	{
+		if (keyframes.empty())
+		{
+			return {};
+		}
+
+		// first keyframe after time
+		const auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+		                                   [](float value, const CameraKeyframe& keyframe)
+		                                   {
+			                                   return value < keyframe.time;
+		                                   });
+		if (next == keyframes.begin())
+		{
+			return keyframes.front();
+		}
+		if (next == keyframes.end())
+		{
+			return keyframes.back();
+		}
+
+		const CameraKeyframe& from = *(next - 1);
+		const CameraKeyframe& to = *next;
+		const float alpha = (time - from.time) / (to.time - from.time);
+
+		CameraKeyframe result{};
+		result.time = time;
+		result.translation = glm::mix(from.translation, to.translation, alpha);
+		result.rotation = interpolateAngles(from.rotation, to.rotation, alpha);
+		return result;
+	}
+}
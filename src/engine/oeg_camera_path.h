@@ -0,0 +1,45 @@
+#pragma once
+
+// glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	// camera pose at a point in time, rotation as the Euler angles OegCamera::setViewYXZ takes
+	struct CameraKeyframe
+	{
+		float time{0.0f};
+		glm::vec3 translation{0.0f};
+		glm::vec3 rotation{0.0f};
+	};
+
+	/**
+	 * Camera poses over time, recorded from a flight or written by hand, played back by sampling
+	 * between the keyframes. Files are plain text with one keyframe per line,
+	 * "time x y z rotationX rotationY rotationZ", and lines starting with # are ignored.
+	 */
+	class OegCameraPath
+	{
+	public:
+		static OegCameraPath loadFromFile(const std::string& filepath);
+		void saveToFile(const std::string& filepath) const;
+
+		// keyframes have to be added in order of time
+		void addKeyframe(const CameraKeyframe& keyframe);
+
+		// pose at time, held at the first and last keyframe outside of the path
+		CameraKeyframe sample(float time) const;
+
+		bool empty() const { return keyframes.empty(); }
+		float getDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+	private:
+		std::vector<CameraKeyframe> keyframes;
+	};
+}
@@ -0,0 +1,228 @@
+#include "oeg_command_recorder.h"
+
+// std
+#include <algorithm>
+#include <cstring>
+
+namespace oeg
+{
+	void OegCommandRecorder::begin(VkCommandBuffer newCommandBuffer)
+	{
+		commandBuffer = newCommandBuffer;
+		stats = {};
+		invalidate();
+	}
+
+	void OegCommandRecorder::invalidate()
+	{
+		graphicsState = {};
+		computeState = {};
+		vertexBindings = {};
+		indexBuffer = VK_NULL_HANDLE;
+		pushLayout = VK_NULL_HANDLE;
+		pushStages = 0;
+		pushBegin = 0;
+		pushEnd = 0;
+	}
+
+	OegCommandRecorder::BindPointState& OegCommandRecorder::stateFor(VkPipelineBindPoint bindPoint)
+	{
+		return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? computeState : graphicsState;
+	}
+
+	void OegCommandRecorder::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline)
+	{
+		BindPointState& state = stateFor(bindPoint);
+		if (state.pipeline == pipeline)
+		{
+			stats.eliminatedCalls++;
+			return;
+		}
+
+		vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+		state.pipeline = pipeline;
+		stats.bindCalls++;
+	}
+
+	void OegCommandRecorder::bindDescriptorSets(
+		VkPipelineBindPoint bindPoint,
+		VkPipelineLayout layout,
+		uint32_t firstSet,
+		uint32_t descriptorSetCount,
+		const VkDescriptorSet* descriptorSets,
+		uint32_t dynamicOffsetCount,
+		const uint32_t* dynamicOffsets)
+	{
+		BindPointState& state = stateFor(bindPoint);
+
+		// dynamic offsets are not tracked, those binds always go through
+		bool redundant = dynamicOffsetCount == 0 && firstSet + descriptorSetCount <= MAX_DESCRIPTOR_SETS;
+		for (uint32_t i = 0; i < descriptorSetCount && redundant; i++)
+		{
+			redundant = state.setLayouts[firstSet + i] == layout && state.sets[firstSet + i] == descriptorSets[i];
+		}
+		if (redundant)
+		{
+			stats.eliminatedCalls++;
+			return;
+		}
+
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			bindPoint,
+			layout,
+			firstSet,
+			descriptorSetCount,
+			descriptorSets,
+			dynamicOffsetCount,
+			dynamicOffsets);
+		stats.bindCalls++;
+
+		// a different layout can disturb the other sets, only keep the ones bound with the same layout
+		for (uint32_t set = 0; set < MAX_DESCRIPTOR_SETS; set++)
+		{
+			const bool written = set >= firstSet && set < firstSet + descriptorSetCount;
+			if (written && dynamicOffsetCount == 0)
+			{
+				state.setLayouts[set] = layout;
+				state.sets[set] = descriptorSets[set - firstSet];
+			}
+			else if (written || state.setLayouts[set] != layout)
+			{
+				state.setLayouts[set] = VK_NULL_HANDLE;
+				state.sets[set] = VK_NULL_HANDLE;
+			}
+		}
+	}
+
+	void OegCommandRecorder::bindVertexBuffers(
+		uint32_t firstBinding,
+		uint32_t bindingCount,
+		const VkBuffer* buffers,
+		const VkDeviceSize* offsets)
+	{
+		bool redundant = firstBinding + bindingCount <= MAX_VERTEX_BINDINGS;
+		for (uint32_t i = 0; i < bindingCount && redundant; i++)
+		{
+			const VertexBinding& binding = vertexBindings[firstBinding + i];
+			redundant = binding.buffer == buffers[i] && binding.offset == offsets[i];
+		}
+		if (redundant)
+		{
+			stats.eliminatedCalls++;
+			return;
+		}
+
+		vkCmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, buffers, offsets);
+		stats.bindCalls++;
+
+		for (uint32_t i = 0; i < bindingCount && firstBinding + i < MAX_VERTEX_BINDINGS; i++)
+		{
+			vertexBindings[firstBinding + i] = {buffers[i], offsets[i]};
+		}
+	}
+
+	void OegCommandRecorder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type)
+	{
+		if (indexBuffer == buffer && indexOffset == offset && indexType == type)
+		{
+			stats.eliminatedCalls++;
+			return;
+		}
+
+		vkCmdBindIndexBuffer(commandBuffer, buffer, offset, type);
+		indexBuffer = buffer;
+		indexOffset = offset;
+		indexType = type;
+		stats.bindCalls++;
+	}
+
+	/**
+		* Push constants are compared byte for byte against the last contiguous range pushed with the
+		* same layout and stages. Anything pushed with a different layout starts a new range.
+	*/
+	void OegCommandRecorder::pushConstants(
+		VkPipelineLayout layout,
+		VkShaderStageFlags stageFlags,
+		uint32_t offset,
+		uint32_t size,
+		const void* values)
+	{
+		const uint32_t end = offset + size;
+		const bool sameTarget = pushLayout == layout && pushStages == stageFlags;
+		if (sameTarget && offset >= pushBegin && end <= pushEnd &&
+			std::memcmp(&pushData[offset], values, size) == 0)
+		{
+			stats.eliminatedCalls++;
+			return;
+		}
+
+		vkCmdPushConstants(commandBuffer, layout, stageFlags, offset, size, values);
+		stats.pushConstantCalls++;
+
+		if (end > MAX_PUSH_CONSTANT_SIZE)
+		{
+			pushLayout = VK_NULL_HANDLE;
+			return;
+		}
+
+		std::memcpy(&pushData[offset], values, size);
+		if (sameTarget && offset <= pushEnd && end >= pushBegin)
+		{
+			pushBegin = std::min(pushBegin, offset);
+			pushEnd = std::max(pushEnd, end);
+		}
+		else
+		{
+			pushLayout = layout;
+			pushStages = stageFlags;
+			pushBegin = offset;
+			pushEnd = end;
+		}
+	}
+
+	void OegCommandRecorder::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+	{
+		vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		stats.drawCalls++;
+		stats.instanceCount += instanceCount;
+		stats.triangleCount += static_cast<uint64_t>(vertexCount / 3) * instanceCount;
+	}
+
+	void OegCommandRecorder::drawIndexed(
+		uint32_t indexCount,
+		uint32_t instanceCount,
+		uint32_t firstIndex,
+		int32_t vertexOffset,
+		uint32_t firstInstance)
+	{
+		vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		stats.drawCalls++;
+		stats.instanceCount += instanceCount;
+		stats.triangleCount += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+	}
+
+	void OegCommandRecorder::drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+		stats.drawCalls++;
+	}
+
+	void OegCommandRecorder::drawIndexedIndirectCount(
+		VkBuffer buffer,
+		VkDeviceSize offset,
+		VkBuffer countBuffer,
+		VkDeviceSize countBufferOffset,
+		uint32_t maxDrawCount,
+		uint32_t stride)
+	{
+		vkCmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+		stats.drawCalls++;
+	}
+
+	void OegCommandRecorder::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+	{
+		vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+		stats.dispatchCalls++;
+	}
+}
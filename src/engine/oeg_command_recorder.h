@@ -0,0 +1,106 @@
+#pragma once
+
+// 3rd party
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <cstdint>
+
+namespace oeg
+{
+	struct CommandRecorderStats
+	{
+		uint32_t bindCalls{0}; // binds that reached the command buffer
+		uint32_t pushConstantCalls{0}; // push constants that reached the command buffer
+		uint32_t eliminatedCalls{0}; // binds and push constants dropped because the state was already set
+		uint32_t drawCalls{0};
+		uint32_t dispatchCalls{0};
+		// of the direct draws, the counts of indirect ones are only known to the GPU
+		uint32_t instanceCount{0};
+		// every pipeline draws triangle lists
+		uint64_t triangleCount{0};
+	};
+
+	/**
+	 * Thin wrapper around a command buffer that remembers the bound pipelines, descriptor sets,
+	 * vertex and index buffers and push constant contents, and drops calls that would set state
+	 * that is already set. Commands recorded directly on the command buffer bypass the tracking,
+	 * call invalidate() after them.
+	 */
+	class OegCommandRecorder
+	{
+	public:
+		static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+		static constexpr uint32_t MAX_VERTEX_BINDINGS = 4;
+		static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 256;
+
+		// starts tracking a freshly begun command buffer, resets state and stats
+		void begin(VkCommandBuffer commandBuffer);
+		void invalidate();
+
+		VkCommandBuffer getCommandBuffer() const { return commandBuffer; }
+		const CommandRecorderStats& getStats() const { return stats; }
+
+		void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+		void bindDescriptorSets(
+			VkPipelineBindPoint bindPoint,
+			VkPipelineLayout layout,
+			uint32_t firstSet,
+			uint32_t descriptorSetCount,
+			const VkDescriptorSet* descriptorSets,
+			uint32_t dynamicOffsetCount = 0,
+			const uint32_t* dynamicOffsets = nullptr);
+		void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+		void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* values);
+
+		void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+		void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+		void drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride);
+		void drawIndexedIndirectCount(
+			VkBuffer buffer,
+			VkDeviceSize offset,
+			VkBuffer countBuffer,
+			VkDeviceSize countBufferOffset,
+			uint32_t maxDrawCount,
+			uint32_t stride);
+		void dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
+	private:
+		// graphics and compute have separate bind points
+		struct BindPointState
+		{
+			VkPipeline pipeline{VK_NULL_HANDLE};
+			std::array<VkPipelineLayout, MAX_DESCRIPTOR_SETS> setLayouts{};
+			std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> sets{};
+		};
+
+		struct VertexBinding
+		{
+			VkBuffer buffer{VK_NULL_HANDLE};
+			VkDeviceSize offset{0};
+		};
+
+		BindPointState& stateFor(VkPipelineBindPoint bindPoint);
+
+		VkCommandBuffer commandBuffer{VK_NULL_HANDLE};
+
+		BindPointState graphicsState{};
+		BindPointState computeState{};
+
+		std::array<VertexBinding, MAX_VERTEX_BINDINGS> vertexBindings{};
+		VkBuffer indexBuffer{VK_NULL_HANDLE};
+		VkDeviceSize indexOffset{0};
+		VkIndexType indexType{VK_INDEX_TYPE_UINT32};
+
+		// contents of the last pushed range [pushBegin, pushEnd) for pushLayout and pushStages
+		VkPipelineLayout pushLayout{VK_NULL_HANDLE};
+		VkShaderStageFlags pushStages{0};
+		uint32_t pushBegin{0};
+		uint32_t pushEnd{0};
+		std::array<uint8_t, MAX_PUSH_CONSTANT_SIZE> pushData{};
+
+		CommandRecorderStats stats{};
+	};
+}
@@ -0,0 +1,422 @@
+#include "oeg_depth_pyramid.h"
+#include "oeg_trace.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace oeg
+{
+	struct DepthReducePushConstantData
+	{
+		uint32_t sourceSize[2];
+		uint32_t destinationSize[2];
+	};
+
+	// largest power of two that is not larger than value
+	static uint32_t previousPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result * 2 <= value)
+		{
+			result *= 2;
+		}
+		return result;
+	}
+
+	static bool hasStencilComponent(VkFormat format)
+	{
+		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+	}
+
+	OegDepthPyramid::OegDepthPyramid(OegDevice& device, const std::string& reduceShaderFilepath)
+		: oegDevice{device}
+	{
+		createPipeline(reduceShaderFilepath);
+		createSampler();
+	}
+
+	OegDepthPyramid::~OegDepthPyramid()
+	{
+		destroyPyramid();
+		vkDestroySampler(oegDevice.device(), sampler, nullptr);
+		vkDestroyPipelineLayout(oegDevice.device(), pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(oegDevice.device(), descriptorSetLayout, nullptr);
+	}
+
+	void OegDepthPyramid::createPipeline(const std::string& reduceShaderFilepath)
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(oegDevice.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+		}
+
+		VkPushConstantRange pushConstantRange{
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(DepthReducePushConstantData)
+		};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(oegDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+		}
+
+		reducePipeline = std::make_unique<OegComputePipeline>(oegDevice, reduceShaderFilepath, pipelineLayout);
+	}
+
+	void OegDepthPyramid::createSampler()
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		if (vkCreateSampler(oegDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid sampler!");
+		}
+	}
+
+	bool OegDepthPyramid::update(VkExtent2D depthExtent, VkFormat depthFormat, const std::vector<VkImageView>& depthViews)
+	{
+		if (depthExtent.width == sourceExtent.width && depthExtent.height == sourceExtent.height &&
+			depthFormat == sourceFormat && depthViews == sourceViews)
+		{
+			return false;
+		}
+
+		// the old pyramid and its descriptor sets may still be used by frames in flight
+		vkDeviceWaitIdle(oegDevice.device());
+		destroyPyramid();
+
+		sourceExtent = depthExtent;
+		sourceFormat = depthFormat;
+		sourceViews = depthViews;
+		createPyramid(depthExtent);
+		createDescriptorSets(depthViews);
+		return true;
+	}
+
+	void OegDepthPyramid::createPyramid(VkExtent2D depthExtent)
+	{
+		// power of two sizes make every level an exact 2x2 reduction of the one below
+		pyramidExtent = {previousPowerOfTwo(depthExtent.width), previousPowerOfTwo(depthExtent.height)};
+		mipCount = 1;
+		while ((std::max(pyramidExtent.width, pyramidExtent.height) >> mipCount) > 0)
+		{
+			mipCount++;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = {pyramidExtent.width, pyramidExtent.height, 1};
+		imageInfo.mipLevels = mipCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocCreateInfo = {};
+		allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+		VmaAllocationInfo allocationInfo{};
+		if (vmaCreateImage(oegDevice.getAllocator(), &imageInfo, &allocCreateInfo, &pyramidImage,
+		                   &pyramidAllocation, &allocationInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create depth pyramid image!");
+		}
+		OEG_TRACE_INSTANT("allocateImage", allocationInfo.size);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramidImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipCount;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(oegDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create depth pyramid image view!");
+		}
+
+		mipViews.resize(mipCount);
+		for (uint32_t i = 0; i < mipCount; i++)
+		{
+			viewInfo.subresourceRange.baseMipLevel = i;
+			viewInfo.subresourceRange.levelCount = 1;
+			if (vkCreateImageView(oegDevice.device(), &viewInfo, nullptr, &mipViews[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create depth pyramid mip view!");
+			}
+		}
+
+		// the pyramid is written and sampled in general layout, so it is transitioned once here
+		VkCommandBuffer commandBuffer = oegDevice.beginSingleTimeCommands();
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramidImage;
+		barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+		oegDevice.endSingleTimeCommands(commandBuffer);
+	}
+
+	void OegDepthPyramid::createDescriptorSets(const std::vector<VkImageView>& depthViews)
+	{
+		const uint32_t setCount = static_cast<uint32_t>(depthViews.size()) + mipCount - 1;
+
+		std::array<VkDescriptorPoolSize, 2> poolSizes{
+			VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount},
+			VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount},
+		};
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(oegDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = setCount;
+		allocInfo.pSetLayouts = layouts.data();
+
+		std::vector<VkDescriptorSet> sets(setCount);
+		if (vkAllocateDescriptorSets(oegDevice.device(), &allocInfo, sets.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+		}
+		depthDescriptorSets.assign(sets.begin(), sets.begin() + depthViews.size());
+		mipDescriptorSets.assign(sets.begin() + depthViews.size(), sets.end());
+
+		auto writeSet = [this](VkDescriptorSet set, VkImageView source, VkImageLayout sourceLayout, VkImageView destination)
+		{
+			VkDescriptorImageInfo sourceInfo{sampler, source, sourceLayout};
+			VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, destination, VK_IMAGE_LAYOUT_GENERAL};
+
+			std::array<VkWriteDescriptorSet, 2> writes{};
+			writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[0].dstSet = set;
+			writes[0].dstBinding = 0;
+			writes[0].descriptorCount = 1;
+			writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[0].pImageInfo = &sourceInfo;
+			writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[1].dstSet = set;
+			writes[1].dstBinding = 1;
+			writes[1].descriptorCount = 1;
+			writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[1].pImageInfo = &destinationInfo;
+			vkUpdateDescriptorSets(oegDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		};
+
+		for (size_t i = 0; i < depthViews.size(); i++)
+		{
+			writeSet(depthDescriptorSets[i], depthViews[i], VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, mipViews[0]);
+		}
+		for (uint32_t i = 1; i < mipCount; i++)
+		{
+			writeSet(mipDescriptorSets[i - 1], mipViews[i - 1], VK_IMAGE_LAYOUT_GENERAL, mipViews[i]);
+		}
+	}
+
+	void OegDepthPyramid::destroyPyramid()
+	{
+		if (descriptorPool != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorPool(oegDevice.device(), descriptorPool, nullptr);
+			descriptorPool = VK_NULL_HANDLE;
+		}
+		depthDescriptorSets.clear();
+		mipDescriptorSets.clear();
+
+		for (auto view : mipViews)
+		{
+			vkDestroyImageView(oegDevice.device(), view, nullptr);
+		}
+		mipViews.clear();
+
+		if (pyramidView != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(oegDevice.device(), pyramidView, nullptr);
+			pyramidView = VK_NULL_HANDLE;
+		}
+		if (pyramidImage != VK_NULL_HANDLE)
+		{
+			vmaDestroyImage(oegDevice.getAllocator(), pyramidImage, pyramidAllocation);
+			pyramidImage = VK_NULL_HANDLE;
+		}
+	}
+
+	VkDescriptorImageInfo OegDepthPyramid::descriptorInfo() const
+	{
+		return VkDescriptorImageInfo{sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL};
+	}
+
+	void OegDepthPyramid::build(OegCommandRecorder& recorder, uint32_t imageIndex, VkImage depthImage)
+	{
+		assert(pyramidImage != VK_NULL_HANDLE && "Call update before building the depth pyramid");
+
+		VkCommandBuffer commandBuffer = recorder.getCommandBuffer();
+
+		const VkImageAspectFlags depthAspect = hasStencilComponent(sourceFormat)
+			                                       ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
+			                                       : VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		std::array<VkImageMemoryBarrier, 2> beginBarriers{};
+		// depth attachment writes -> sampled by the reduction
+		beginBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		beginBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		beginBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		beginBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		beginBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		beginBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[0].image = depthImage;
+		beginBarriers[0].subresourceRange = {depthAspect, 0, 1, 0, 1};
+		// culling of an earlier frame may still be reading the pyramid
+		beginBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		beginBarriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		beginBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		beginBarriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		beginBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		beginBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		beginBarriers[1].image = pyramidImage;
+		beginBarriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(beginBarriers.size()), beginBarriers.data());
+
+		reducePipeline->bind(recorder);
+
+		VkExtent2D levelSource = sourceExtent;
+		for (uint32_t level = 0; level < mipCount; level++)
+		{
+			const VkExtent2D levelExtent{
+				std::max(pyramidExtent.width >> level, 1u),
+				std::max(pyramidExtent.height >> level, 1u)
+			};
+
+			VkDescriptorSet set = level == 0 ? depthDescriptorSets[imageIndex] : mipDescriptorSets[level - 1];
+			recorder.bindDescriptorSets(
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineLayout,
+				0,
+				1,
+				&set);
+
+			DepthReducePushConstantData push{
+				{levelSource.width, levelSource.height},
+				{levelExtent.width, levelExtent.height}
+			};
+			recorder.pushConstants(
+				pipelineLayout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				0,
+				sizeof(DepthReducePushConstantData),
+				&push);
+
+			recorder.dispatch((levelExtent.width + 7) / 8, (levelExtent.height + 7) / 8, 1);
+
+			// the next level (or culling, after the last one) reads what was just written
+			VkImageMemoryBarrier levelBarrier{};
+			levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			levelBarrier.image = pyramidImage;
+			levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				1, &levelBarrier);
+
+			levelSource = levelExtent;
+		}
+
+		// hand the depth image back to the render pass that continues the frame
+		VkImageMemoryBarrier depthBarrier{};
+		depthBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask =
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		depthBarrier.image = depthImage;
+		depthBarrier.subresourceRange = {depthAspect, 0, 1, 0, 1};
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &depthBarrier);
+	}
+}
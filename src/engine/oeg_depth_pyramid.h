@@ -0,0 +1,69 @@
+#pragma once
+
+#include "oeg_device.h"
+#include "oeg_pipeline.h"
+
+// std
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * Hierarchical depth buffer built from the swapchain depth attachment. Every texel of a mip
+	 * holds the farthest depth of the texels it covers in the level below, so a bounding volume
+	 * whose nearest depth is behind that value is hidden.
+	 */
+	class OegDepthPyramid
+	{
+	public:
+		OegDepthPyramid(OegDevice& device, const std::string& reduceShaderFilepath);
+		~OegDepthPyramid();
+
+		OegDepthPyramid(const OegDepthPyramid&) = delete;
+		OegDepthPyramid& operator=(const OegDepthPyramid&) = delete;
+
+		/**
+		 * \brief Recreates the pyramid when the swapchain depth images changed, returns true if it did.
+		 * Must be called before anything that samples the pyramid is recorded for the frame.
+		 */
+		bool update(VkExtent2D depthExtent, VkFormat depthFormat, const std::vector<VkImageView>& depthViews);
+
+		// records the reduction, outside of a render pass, with the depth image in attachment layout
+		void build(OegCommandRecorder& recorder, uint32_t imageIndex, VkImage depthImage);
+
+		VkDescriptorImageInfo descriptorInfo() const;
+		VkExtent2D getExtent() const { return pyramidExtent; }
+		uint32_t getMipCount() const { return mipCount; }
+
+	private:
+		void createPipeline(const std::string& reduceShaderFilepath);
+		void createSampler();
+		void createPyramid(VkExtent2D depthExtent);
+		void createDescriptorSets(const std::vector<VkImageView>& depthViews);
+		void destroyPyramid();
+
+		OegDevice& oegDevice;
+
+		VkDescriptorSetLayout descriptorSetLayout{};
+		VkPipelineLayout pipelineLayout{};
+		std::unique_ptr<OegComputePipeline> reducePipeline;
+		VkSampler sampler{};
+
+		VkImage pyramidImage{};
+		VmaAllocation pyramidAllocation{};
+		VkImageView pyramidView{}; // all mips, sampled by culling
+		std::vector<VkImageView> mipViews; // one per mip, written by the reduction
+		VkExtent2D pyramidExtent{0, 0};
+		uint32_t mipCount{0};
+
+		VkDescriptorPool descriptorPool{};
+		std::vector<VkDescriptorSet> depthDescriptorSets; // level 0, one per swapchain depth image
+		std::vector<VkDescriptorSet> mipDescriptorSets; // level i reads mip i - 1
+
+		VkExtent2D sourceExtent{0, 0};
+		VkFormat sourceFormat{VK_FORMAT_UNDEFINED};
+		std::vector<VkImageView> sourceViews;
+	};
+}
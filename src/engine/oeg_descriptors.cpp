@@ -0,0 +1,214 @@
+#include "oeg_descriptors.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace oeg
+{
+	OegDescriptorSetLayout::Builder& OegDescriptorSetLayout::Builder::addBinding(
+		uint32_t binding,
+		VkDescriptorType descriptorType,
+		VkShaderStageFlags stageFlags,
+		uint32_t count)
+	{
+		assert(bindings.count(binding) == 0 && "Binding already in use");
+		VkDescriptorSetLayoutBinding layoutBinding{};
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorType = descriptorType;
+		layoutBinding.descriptorCount = count;
+		layoutBinding.stageFlags = stageFlags;
+		bindings[binding] = layoutBinding;
+		return *this;
+	}
+
+	std::unique_ptr<OegDescriptorSetLayout> OegDescriptorSetLayout::Builder::build() const
+	{
+		return std::make_unique<OegDescriptorSetLayout>(oegDevice, bindings);
+	}
+
+	OegDescriptorSetLayout::OegDescriptorSetLayout(
+		OegDevice& device,
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+		: oegDevice{device}, bindings{std::move(bindings)}
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+		for (const auto& [binding, layoutBinding] : this->bindings)
+		{
+			setLayoutBindings.push_back(layoutBinding);
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+		layoutInfo.pBindings = setLayoutBindings.data();
+
+		if (vkCreateDescriptorSetLayout(oegDevice.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+	}
+
+	OegDescriptorSetLayout::~OegDescriptorSetLayout()
+	{
+		vkDestroyDescriptorSetLayout(oegDevice.device(), descriptorSetLayout, nullptr);
+	}
+
+	OegDescriptorAllocator::OegDescriptorAllocator(
+		OegDevice& device,
+		uint32_t initialSets,
+		std::vector<PoolSizeRatio> poolRatios)
+		: oegDevice{device}, ratios{std::move(poolRatios)}, setsPerPool{initialSets}
+	{
+		readyPools.push_back(createPool(setsPerPool));
+	}
+
+	OegDescriptorAllocator::~OegDescriptorAllocator()
+	{
+		for (VkDescriptorPool pool : readyPools)
+		{
+			vkDestroyDescriptorPool(oegDevice.device(), pool, nullptr);
+		}
+		for (VkDescriptorPool pool : fullPools)
+		{
+			vkDestroyDescriptorPool(oegDevice.device(), pool, nullptr);
+		}
+	}
+
+	VkDescriptorPool OegDescriptorAllocator::createPool(uint32_t setCount) const
+	{
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const PoolSizeRatio& ratio : ratios)
+		{
+			poolSizes.push_back({ratio.type, std::max(1u, static_cast<uint32_t>(ratio.ratio * setCount))});
+		}
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = setCount;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(oegDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+		return pool;
+	}
+
+	VkDescriptorPool OegDescriptorAllocator::getPool()
+	{
+		if (!readyPools.empty())
+		{
+			VkDescriptorPool pool = readyPools.back();
+			readyPools.pop_back();
+			return pool;
+		}
+
+		// grow, so a scene that keeps allocating ends up with a handful of pools rather than hundreds.
+		// Half of a pool of one set is nothing, so it grows by at least one
+		setsPerPool = std::min(std::max(setsPerPool + 1, setsPerPool + setsPerPool / 2), MAX_SETS_PER_POOL);
+		return createPool(setsPerPool);
+	}
+
+	VkDescriptorSet OegDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+	{
+		VkDescriptorPool pool = getPool();
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(oegDevice.device(), &allocInfo, &set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			fullPools.push_back(pool);
+			pool = getPool();
+			allocInfo.descriptorPool = pool;
+			result = vkAllocateDescriptorSets(oegDevice.device(), &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		readyPools.push_back(pool);
+		return set;
+	}
+
+	void OegDescriptorAllocator::resetPools()
+	{
+		for (VkDescriptorPool pool : fullPools)
+		{
+			readyPools.push_back(pool);
+		}
+		fullPools.clear();
+		for (VkDescriptorPool pool : readyPools)
+		{
+			vkResetDescriptorPool(oegDevice.device(), pool, 0);
+		}
+	}
+
+	OegDescriptorWriter::OegDescriptorWriter(OegDescriptorSetLayout& setLayout, OegDescriptorAllocator& allocator)
+		: setLayout{setLayout}, allocator{allocator}
+	{
+	}
+
+	OegDescriptorWriter& OegDescriptorWriter::writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo)
+	{
+		assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+		const VkDescriptorSetLayoutBinding& bindingDescription = setLayout.bindings[binding];
+		assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.descriptorType = bindingDescription.descriptorType;
+		write.dstBinding = binding;
+		write.pBufferInfo = bufferInfo;
+		write.descriptorCount = 1;
+		writes.push_back(write);
+		return *this;
+	}
+
+	OegDescriptorWriter& OegDescriptorWriter::writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo)
+	{
+		assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+		const VkDescriptorSetLayoutBinding& bindingDescription = setLayout.bindings[binding];
+		assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.descriptorType = bindingDescription.descriptorType;
+		write.dstBinding = binding;
+		write.pImageInfo = imageInfo;
+		write.descriptorCount = 1;
+		writes.push_back(write);
+		return *this;
+	}
+
+	VkDescriptorSet OegDescriptorWriter::build()
+	{
+		VkDescriptorSet set = allocator.allocate(setLayout.getDescriptorSetLayout());
+		overwrite(set);
+		return set;
+	}
+
+	void OegDescriptorWriter::overwrite(VkDescriptorSet set)
+	{
+		for (auto& write : writes)
+		{
+			write.dstSet = set;
+		}
+		vkUpdateDescriptorSets(
+			setLayout.oegDevice.device(),
+			static_cast<uint32_t>(writes.size()),
+			writes.data(),
+			0,
+			nullptr);
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "oeg_device.h"
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace oeg
+{
+	class OegDescriptorSetLayout
+	{
+	public:
+		class Builder
+		{
+		public:
+			explicit Builder(OegDevice& device) : oegDevice{device} {}
+
+			Builder& addBinding(
+				uint32_t binding,
+				VkDescriptorType descriptorType,
+				VkShaderStageFlags stageFlags,
+				uint32_t count = 1);
+			std::unique_ptr<OegDescriptorSetLayout> build() const;
+
+		private:
+			OegDevice& oegDevice;
+			std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+		};
+
+		OegDescriptorSetLayout(OegDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+		~OegDescriptorSetLayout();
+
+		OegDescriptorSetLayout(const OegDescriptorSetLayout&) = delete;
+		OegDescriptorSetLayout& operator=(const OegDescriptorSetLayout&) = delete;
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+	private:
+		OegDevice& oegDevice;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+
+		friend class OegDescriptorWriter;
+	};
+
+	/**
+	 * Hands out descriptor sets from a list of pools. When a pool runs out another one is created,
+	 * each new pool holding more sets than the last, so callers never have to size pools up front.
+	 * Sets are only returned all at once through resetPools.
+	 */
+	class OegDescriptorAllocator
+	{
+	public:
+		// descriptors of a type per set, a pool of N sets gets N * ratio descriptors of that type
+		struct PoolSizeRatio
+		{
+			VkDescriptorType type;
+			float ratio;
+		};
+
+		OegDescriptorAllocator(OegDevice& device, uint32_t initialSets, std::vector<PoolSizeRatio> poolRatios);
+		~OegDescriptorAllocator();
+
+		OegDescriptorAllocator(const OegDescriptorAllocator&) = delete;
+		OegDescriptorAllocator& operator=(const OegDescriptorAllocator&) = delete;
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		// every set handed out so far becomes invalid, the GPU must be done with them
+		void resetPools();
+
+		uint32_t getPoolCount() const { return static_cast<uint32_t>(readyPools.size() + fullPools.size()); }
+
+	private:
+		static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+		VkDescriptorPool getPool();
+		VkDescriptorPool createPool(uint32_t setCount) const;
+
+		OegDevice& oegDevice;
+		std::vector<PoolSizeRatio> ratios;
+		std::vector<VkDescriptorPool> readyPools;
+		std::vector<VkDescriptorPool> fullPools;
+		uint32_t setsPerPool;
+	};
+
+	class OegDescriptorWriter
+	{
+	public:
+		OegDescriptorWriter(OegDescriptorSetLayout& setLayout, OegDescriptorAllocator& allocator);
+
+		// the infos are read when the set is built, they have to outlive the writer
+		OegDescriptorWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo* bufferInfo);
+		OegDescriptorWriter& writeImage(uint32_t binding, const VkDescriptorImageInfo* imageInfo);
+
+		VkDescriptorSet build();
+		void overwrite(VkDescriptorSet set);
+
+	private:
+		OegDescriptorSetLayout& setLayout;
+		OegDescriptorAllocator& allocator;
+		std::vector<VkWriteDescriptorSet> writes;
+	};
+}
@@ -1,4 +1,5 @@
 #include "oeg_device.h"
+#include "oeg_trace.h"
 
 // std headers
 #include <cstring>
@@ -56,8 +57,10 @@ namespace oeg
 		setupDebugMessenger();
 		createSurface();
 		pickPhysicalDevice();
+		queryOptionalFeatures();
 		createLogicalDevice();
 		createCommandPool();
+		pipelineCache = std::make_unique<OegPipelineCache>(device_, properties, PIPELINE_CACHE_FILE);
 
 		// Initialize VMA Allocator
 		VmaAllocatorCreateInfo allocatorInfo = {};
@@ -69,6 +72,8 @@ namespace oeg
 
 	OegDevice::~OegDevice()
 	{
+		// written to disk while the device is still alive
+		pipelineCache.reset();
 		vkDestroyCommandPool(device_, commandPool, nullptr);
 		vkDestroyDevice(device_, nullptr);
 
@@ -77,7 +82,10 @@ namespace oeg
 			DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 		}
 
-		vkDestroySurfaceKHR(instance, surface_, nullptr);
+		if (surface_ != VK_NULL_HANDLE)
+		{
+			vkDestroySurfaceKHR(instance, surface_, nullptr);
+		}
 		vkDestroyInstance(instance, nullptr);
 
 		// Destroy VMA Allocator
@@ -161,6 +169,51 @@ namespace oeg
 		std::cout << "physical device: " << properties.deviceName << std::endl;
 	}
 
+	void OegDevice::queryOptionalFeatures()
+	{
+		const bool hasPipelineLibraryExtensions =
+			hasDeviceExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+			hasDeviceExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+		pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.pNext = hasPipelineLibraryExtensions ? &pipelineLibraryFeatures : nullptr;
+
+		VkPhysicalDeviceFeatures2 supportedFeatures{};
+		supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		// the 1.2 feature struct is only valid to chain on 1.2+ devices
+		supportedFeatures.pNext = properties.apiVersion >= VK_API_VERSION_1_2 ? &vulkan12Features : nullptr;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+		multiDrawIndirectSupported = supportedFeatures.features.multiDrawIndirect;
+		drawIndirectFirstInstanceSupported = supportedFeatures.features.drawIndirectFirstInstance;
+		pipelineStatisticsQuerySupported = supportedFeatures.features.pipelineStatisticsQuery;
+		drawIndirectCountSupported = vulkan12Features.drawIndirectCount;
+
+		if (pipelineLibraryFeatures.graphicsPipelineLibrary)
+		{
+			VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProperties{};
+			pipelineLibraryProperties.sType =
+				VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+			VkPhysicalDeviceProperties2 properties2{};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties2.pNext = &pipelineLibraryProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+			// without fast linking a linked pipeline costs about as much as a monolithic one
+			graphicsPipelineLibrarySupported = pipelineLibraryProperties.graphicsPipelineLibraryFastLinking;
+		}
+
+		std::cout << "multiDrawIndirect: " << multiDrawIndirectSupported
+			<< ", drawIndirectCount: " << drawIndirectCountSupported
+			<< ", pipelineStatisticsQuery: " << pipelineStatisticsQuerySupported
+			<< ", graphicsPipelineLibrary: " << graphicsPipelineLibrarySupported << std::endl;
+	}
+
 	void OegDevice::createLogicalDevice()
 	{
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
@@ -179,18 +232,40 @@ namespace oeg
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		VkPhysicalDeviceFeatures deviceFeatures = {};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+		pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+		pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.pNext = graphicsPipelineLibrarySupported ? &pipelineLibraryFeatures : nullptr;
+		vulkan12Features.drawIndirectCount = drawIndirectCountSupported;
+
+		VkPhysicalDeviceFeatures2 deviceFeatures = {};
+		deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures.pNext = properties.apiVersion >= VK_API_VERSION_1_2 ? &vulkan12Features : nullptr;
+		deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.features.multiDrawIndirect = multiDrawIndirectSupported;
+		deviceFeatures.features.drawIndirectFirstInstance = drawIndirectFirstInstanceSupported;
+		deviceFeatures.features.pipelineStatisticsQuery = pipelineStatisticsQuerySupported;
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		// features are passed through pNext so the 1.2 feature struct can be chained
+		createInfo.pNext = &deviceFeatures;
 
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		createInfo.pEnabledFeatures = nullptr;
+		std::vector<const char*> enabledExtensions = getRequiredDeviceExtensions();
+		if (graphicsPipelineLibrarySupported)
+		{
+			enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+			enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		}
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		// might not really be necessary anymore because device specific validation layers
 		// have been deprecated
@@ -229,7 +304,13 @@ namespace oeg
 		}
 	}
 
-	void OegDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+	void OegDevice::createSurface()
+	{
+		if (!isHeadless())
+		{
+			window.createWindowSurface(instance, &surface_);
+		}
+	}
 
 	bool OegDevice::isDeviceSuitable(VkPhysicalDevice device)
 	{
@@ -237,8 +318,9 @@ namespace oeg
 
 		bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported)
+		// offscreen rendering needs no surface, so software implementations like lavapipe qualify too
+		bool swapChainAdequate = isHeadless();
+		if (extensionsSupported && !isHeadless())
 		{
 			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -308,11 +390,13 @@ namespace oeg
 
 	std::vector<const char*> OegDevice::getRequiredExtensions()
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions;
+		if (!isHeadless())
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (enableValidationLayers)
 		{
@@ -322,6 +406,15 @@ namespace oeg
 		return extensions;
 	}
 
+	std::vector<const char*> OegDevice::getRequiredDeviceExtensions() const
+	{
+		if (isHeadless())
+		{
+			return {};
+		}
+		return {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	}
+
 	void OegDevice::hasGflwRequiredInstanceExtensions()
 	{
 		uint32_t extensionCount = 0;
@@ -349,6 +442,24 @@ namespace oeg
 		}
 	}
 
+	bool OegDevice::hasDeviceExtension(const char* extensionName)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions)
+		{
+			if (std::strcmp(extension.extensionName, extensionName) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	bool OegDevice::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	{
 		uint32_t extensionCount;
@@ -361,6 +472,7 @@ namespace oeg
 			&extensionCount,
 			availableExtensions.data());
 
+		const std::vector<const char*> deviceExtensions = getRequiredDeviceExtensions();
 		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
 		for (const auto& extension : availableExtensions)
@@ -389,8 +501,16 @@ namespace oeg
 				indices.graphicsFamily = i;
 				indices.graphicsFamilyHasValue = true;
 			}
+			// nothing is presented headless, the graphics queue stands in for the present queue
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			if (isHeadless())
+			{
+				presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+			}
 			if (queueFamily.queueCount > 0 && presentSupport)
 			{
 				indices.presentFamily = i;
@@ -509,6 +629,7 @@ namespace oeg
 
 	void OegDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 	{
+		OEG_TRACE_ZONE("copyBuffer");
 		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
 		VkBufferCopy copyRegion{};
@@ -555,10 +676,12 @@ namespace oeg
 		VmaAllocation& allocation) const
 	// Updated to use VMA allocation
 	{
-		if (vmaCreateImage(allocator_, &imageInfo, nullptr, &image, &allocation, nullptr) != VK_SUCCESS)
+		VmaAllocationInfo allocationInfo{};
+		if (vmaCreateImage(allocator_, &imageInfo, nullptr, &image, &allocation, &allocationInfo) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create image!");
 		}
+		OEG_TRACE_INSTANT("allocateImage", allocationInfo.size);
 	}
 
 	VmaAllocator OegDevice::getAllocator() const
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "oeg_pipeline_cache.h"
 #include "oeg_window.h"
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h> // Include VMA header
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -47,6 +49,7 @@ namespace oeg
 
 		VkCommandPool getCommandPool() { return commandPool; }
 		VkDevice device() { return device_; }
+		// VK_NULL_HANDLE for a headless window
 		VkSurfaceKHR surface() { return surface_; }
 		VkQueue graphicsQueue() { return graphicsQueue_; }
 		VkQueue presentQueue() { return presentQueue_; }
@@ -77,18 +80,36 @@ namespace oeg
 
 		VmaAllocator getAllocator() const;
 
+		// shared by all pipeline creation, persisted to PIPELINE_CACHE_FILE
+		OegPipelineCache& getPipelineCache() { return *pipelineCache; }
+		static constexpr const char* PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+		// optional features, enabled when the physical device supports them
+		bool supportsMultiDrawIndirect() const { return multiDrawIndirectSupported; }
+		bool supportsDrawIndirectCount() const { return drawIndirectCountSupported; }
+		bool supportsDrawIndirectFirstInstance() const { return drawIndirectFirstInstanceSupported; }
+		bool supportsPipelineStatisticsQuery() const { return pipelineStatisticsQuerySupported; }
+		// VK_EXT_graphics_pipeline_library with fast linking
+		bool supportsGraphicsPipelineLibrary() const { return graphicsPipelineLibrarySupported; }
+
+		// no surface and no swapchain extension, any device with a graphics queue will do
+		bool isHeadless() const { return window.isHeadless(); }
+
 	private:
 		void createInstance();
 		void setupDebugMessenger();
 		void createSurface();
 		void pickPhysicalDevice();
+		void queryOptionalFeatures();
 		void createLogicalDevice();
 		void createCommandPool();
 
 
 		// Helper functions (unchanged)
 		bool isDeviceSuitable(VkPhysicalDevice device);
+		bool hasDeviceExtension(const char* extensionName);
 		std::vector<const char*> getRequiredExtensions();
+		std::vector<const char*> getRequiredDeviceExtensions() const;
 		bool checkValidationLayerSupport();
 		QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 		void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
@@ -103,13 +124,19 @@ namespace oeg
 		VkCommandPool commandPool;
 
 		VkDevice device_;
-		VkSurfaceKHR surface_;
+		VkSurfaceKHR surface_{VK_NULL_HANDLE};
 		VkQueue graphicsQueue_;
 		VkQueue presentQueue_;
 
 		VmaAllocator allocator_;
+		std::unique_ptr<OegPipelineCache> pipelineCache;
+
+		bool multiDrawIndirectSupported = false;
+		bool drawIndirectCountSupported = false;
+		bool drawIndirectFirstInstanceSupported = false;
+		bool pipelineStatisticsQuerySupported = false;
+		bool graphicsPipelineLibrarySupported = false;
 
 		const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-		const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 	};
 }
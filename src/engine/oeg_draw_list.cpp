@@ -0,0 +1,144 @@
+#include "oeg_draw_list.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+namespace oeg
+{
+	namespace
+	{
+		constexpr uint32_t RADIX_BITS = 8;
+		constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+		constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+		using Histogram = std::array<uint32_t, RADIX_SIZE>;
+
+		uint32_t digitOf(uint64_t key, uint32_t pass)
+		{
+			return static_cast<uint32_t>(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+		}
+	}
+
+	uint64_t OegDrawList::makeSortKey(uint32_t pipelineId, uint32_t modelId, float viewDepth)
+	{
+		assert(pipelineId < (1u << PIPELINE_BITS) && modelId < (1u << MODEL_BITS));
+
+		// the bits of a non negative float sort the same way as its value
+		const float depth = std::max(viewDepth, 0.0f);
+		uint32_t depthBits;
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+		return (static_cast<uint64_t>(pipelineId) << (MODEL_BITS + DEPTH_BITS)) |
+			(static_cast<uint64_t>(modelId) << DEPTH_BITS) |
+			depthBits;
+	}
+
+	void OegDrawList::countBinds(const std::vector<DrawItem>& drawItems, uint32_t& pipelineBinds, uint32_t& modelBinds)
+	{
+		pipelineBinds = 0;
+		modelBinds = 0;
+		for (size_t i = 0; i < drawItems.size(); i++)
+		{
+			const uint64_t key = drawItems[i].sortKey;
+			if (i == 0 || pipelineFromKey(key) != pipelineFromKey(drawItems[i - 1].sortKey))
+			{
+				pipelineBinds++;
+			}
+			// a pipeline change does not unbind the vertex buffers, only a different model needs a bind
+			if (i == 0 || modelFromKey(key) != modelFromKey(drawItems[i - 1].sortKey))
+			{
+				modelBinds++;
+			}
+		}
+	}
+
+	/**
+		* LSD radix sort, one byte per pass. Each pass builds a histogram per chunk, turns the
+		* histograms into scatter offsets ordered by digit then chunk, and scatters every chunk into
+		* its own ranges, which keeps the sort stable. Passes where all keys share the digit are
+		* skipped, which is common for the pipeline and model bytes.
+	*/
+	void OegDrawList::sort()
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		stats.drawCount = static_cast<uint32_t>(items.size());
+		countBinds(items, stats.unsortedPipelineBinds, stats.unsortedModelBinds);
+
+		const size_t count = items.size();
+		OegJobSystem& jobSystem = OegJobSystem::get();
+		const size_t chunkCount = count < PARALLEL_THRESHOLD ? 1 : jobSystem.getThreadCount();
+		const size_t chunkSize = (count + chunkCount - 1) / std::max<size_t>(chunkCount, 1);
+
+		scratch.resize(count);
+		std::vector<Histogram> histograms(chunkCount);
+
+		// runs fn(chunk, begin, end) for every chunk as a job, the calling thread takes the last one
+		auto forEachChunk = [&](auto&& fn)
+		{
+			JobCounter counter;
+			for (size_t chunk = 0; chunk + 1 < chunkCount; chunk++)
+			{
+				const size_t begin = std::min(count, chunk * chunkSize);
+				const size_t end = std::min(count, begin + chunkSize);
+				jobSystem.schedule([&fn, chunk, begin, end] { fn(chunk, begin, end); }, &counter);
+			}
+			const size_t lastChunk = chunkCount - 1;
+			fn(lastChunk, std::min(count, lastChunk * chunkSize), count);
+			jobSystem.wait(counter);
+		};
+
+		for (uint32_t pass = 0; pass < RADIX_PASSES && count > 1; pass++)
+		{
+			forEachChunk([&](size_t chunk, size_t begin, size_t end)
+			{
+				Histogram& histogram = histograms[chunk];
+				histogram.fill(0);
+				for (size_t i = begin; i < end; i++)
+				{
+					histogram[digitOf(items[i].sortKey, pass)]++;
+				}
+			});
+
+			// exclusive prefix sum over (digit, chunk), the histograms become scatter offsets
+			uint32_t offset = 0;
+			bool singleDigit = false;
+			for (uint32_t digit = 0; digit < RADIX_SIZE; digit++)
+			{
+				uint32_t digitTotal = 0;
+				for (auto& histogram : histograms)
+				{
+					const uint32_t bucketCount = histogram[digit];
+					histogram[digit] = offset;
+					offset += bucketCount;
+					digitTotal += bucketCount;
+				}
+				singleDigit |= digitTotal == count;
+			}
+			if (singleDigit)
+			{
+				continue;
+			}
+
+			forEachChunk([&](size_t chunk, size_t begin, size_t end)
+			{
+				Histogram& offsets = histograms[chunk];
+				for (size_t i = begin; i < end; i++)
+				{
+					scratch[offsets[digitOf(items[i].sortKey, pass)]++] = items[i];
+				}
+			});
+			items.swap(scratch);
+		}
+
+		countBinds(items, stats.pipelineBinds, stats.modelBinds);
+
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.sortTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	struct DrawListStats
+	{
+		uint32_t drawCount{0};
+		// binds needed when drawing in submission order vs sorted order
+		uint32_t unsortedPipelineBinds{0};
+		uint32_t unsortedModelBinds{0};
+		uint32_t pipelineBinds{0};
+		uint32_t modelBinds{0};
+		float sortTimeMs{0.0f};
+	};
+
+	/**
+	 * Per frame list of draws ordered by a 64 bit sort key. From the most significant bit down the
+	 * key holds the pipeline, the model and the view depth, so draws are grouped by state first and
+	 * go front to back within a group. Sorting uses an LSD radix sort that is split across threads
+	 * for large lists.
+	 */
+	class OegDrawList
+	{
+	public:
+		struct DrawItem
+		{
+			uint64_t sortKey;
+			uint32_t objectIndex;
+		};
+
+		// below this many draws splitting the sort into jobs costs more than it saves
+		static constexpr size_t PARALLEL_THRESHOLD = 16384;
+
+		static constexpr uint32_t PIPELINE_BITS = 8;
+		static constexpr uint32_t MODEL_BITS = 24;
+		static constexpr uint32_t DEPTH_BITS = 32;
+
+		/**
+		 * \brief Builds the key for an opaque draw, viewDepth is the view space distance along the camera axis
+		 */
+		static uint64_t makeSortKey(uint32_t pipelineId, uint32_t modelId, float viewDepth);
+
+		static uint32_t pipelineFromKey(uint64_t key) { return static_cast<uint32_t>(key >> (MODEL_BITS + DEPTH_BITS)); }
+		static uint32_t modelFromKey(uint64_t key)
+		{
+			return static_cast<uint32_t>(key >> DEPTH_BITS) & ((1u << MODEL_BITS) - 1);
+		}
+
+		void clear() { items.clear(); }
+		void add(uint64_t sortKey, uint32_t objectIndex) { items.push_back({sortKey, objectIndex}); }
+
+		// sorts by key, stable, and updates the stats
+		void sort();
+
+		const std::vector<DrawItem>& getItems() const { return items; }
+		const DrawListStats& getStats() const { return stats; }
+
+	private:
+		static void countBinds(const std::vector<DrawItem>& drawItems, uint32_t& pipelineBinds, uint32_t& modelBinds);
+
+		std::vector<DrawItem> items;
+		std::vector<DrawItem> scratch;
+
+		DrawListStats stats{};
+	};
+}
@@ -0,0 +1,60 @@
+#include "oeg_fixed_timestep.h"
+
+// 3rd party
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace oeg
+{
+	OegFixedTimestep::OegFixedTimestep(float step, uint32_t maxStepsPerFrame)
+		: step{step}, maxStepsPerFrame{maxStepsPerFrame}
+	{
+		assert(step > 0.0f && "The simulation step has to be positive");
+		assert(maxStepsPerFrame > 0 && "A frame has to be able to run at least one step");
+	}
+
+	uint32_t OegFixedTimestep::advance(float frameTime)
+	{
+		accumulator += std::max(frameTime, 0.0f);
+
+		const double steps = std::floor(accumulator / step);
+		stats.stepCount = static_cast<uint32_t>(std::min(steps, static_cast<double>(maxStepsPerFrame)));
+		accumulator -= stats.stepCount * static_cast<double>(step);
+
+		// behind by more than the limit, keep the fraction of a step so interpolation does not jump but
+		// drop the whole steps, catching up on them would only make the next frame longer
+		if (steps > maxStepsPerFrame)
+		{
+			const double dropped = std::floor(accumulator / step) * step;
+			accumulator -= dropped;
+			stats.clampedFrameCount++;
+			stats.droppedTimeMs += static_cast<float>(dropped * 1000.0);
+		}
+		return stats.stepCount;
+	}
+
+	glm::vec3 interpolateTranslation(const TransformComponent& previous, const TransformComponent& current, float alpha)
+	{
+		return glm::mix(previous.getTranslation(), current.getTranslation(), alpha);
+	}
+
+	glm::vec3 interpolateRotation(const TransformComponent& previous, const TransformComponent& current, float alpha)
+	{
+		return interpolateAngles(previous.getRotation(), current.getRotation(), alpha);
+	}
+
+	glm::vec3 interpolateAngles(const glm::vec3& from, const glm::vec3& to, float alpha)
+	{
+		glm::vec3 delta = to - from;
+		for (int i = 0; i < 3; i++)
+		{
+			// into [-pi, pi)
+			delta[i] -= glm::two_pi<float>() * std::floor((delta[i] + glm::pi<float>()) / glm::two_pi<float>());
+		}
+		return from + delta * alpha;
+	}
+}
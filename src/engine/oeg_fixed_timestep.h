@@ -0,0 +1,65 @@
+#pragma once
+
+#include "oeg_game_object.h"
+
+// glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <cstdint>
+
+namespace oeg
+{
+	struct FixedTimestepStats
+	{
+		// steps simulated by the last advance
+		uint32_t stepCount{0};
+		// frames that hit the step limit since the clock was created
+		uint32_t clampedFrameCount{0};
+		// simulation time thrown away by those frames
+		float droppedTimeMs{0.0f};
+	};
+
+	/**
+	 * Turns variable frame times into a whole number of fixed simulation steps. Time that does not
+	 * fill a step is carried over to the next frame, and the fraction of a step it represents is what
+	 * the renderer interpolates by, between the state before and after the latest step.
+	 *
+	 * A frame never runs more than maxStepsPerFrame steps. Anything beyond that is dropped, so a frame
+	 * that took too long cannot make the next one take even longer.
+	 */
+	class OegFixedTimestep
+	{
+	public:
+		static constexpr float DEFAULT_STEP = 1.0f / 60.0f;
+		static constexpr uint32_t DEFAULT_MAX_STEPS_PER_FRAME = 5;
+
+		explicit OegFixedTimestep(float step = DEFAULT_STEP, uint32_t maxStepsPerFrame = DEFAULT_MAX_STEPS_PER_FRAME);
+
+		// adds the time of a frame in seconds, returns how many steps to simulate this frame
+		uint32_t advance(float frameTime);
+
+		float getStep() const { return step; }
+		// how far the time carried over lies into the next step, [0, 1)
+		float getAlpha() const { return static_cast<float>(accumulator / step); }
+		const FixedTimestepStats& getStats() const { return stats; }
+
+	private:
+		float step;
+		uint32_t maxStepsPerFrame;
+		// double, so the carried over time does not drift after hours of small additions
+		double accumulator{0.0};
+
+		FixedTimestepStats stats{};
+	};
+
+	/**
+	 * \brief State of a transform alpha of the way from previous to current. Euler angles take the
+	 * shorter way around, so an angle that wrapped at 2 pi during the step does not spin back
+	 */
+	glm::vec3 interpolateTranslation(const TransformComponent& previous, const TransformComponent& current, float alpha);
+	glm::vec3 interpolateRotation(const TransformComponent& previous, const TransformComponent& current, float alpha);
+	glm::vec3 interpolateAngles(const glm::vec3& from, const glm::vec3& to, float alpha);
+}
@@ -0,0 +1,88 @@
+#include "oeg_flight_recorder.h"
+#include "oeg_job_system.h"
+#include "oeg_trace.h"
+
+// std
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+namespace oeg
+{
+	OegFlightRecorder::OegFlightRecorder(std::string outputPrefix, float spikeFactor, uint32_t windowFrames)
+		: outputPrefix{std::move(outputPrefix)}, spikeFactor{spikeFactor}, windowFrames{std::max(windowFrames, 1u)}
+	{
+		frameTimes.assign(this->windowFrames, 0.0f);
+		frameEndNs.assign(this->windowFrames, 0);
+		sortedFrameTimes.reserve(this->windowFrames);
+		OegTrace::setEnabled(true);
+	}
+
+	void OegFlightRecorder::endFrame(uint64_t frameNumber, float frameMs)
+	{
+		// compared against the frames before it, so a spike does not raise its own threshold
+		if (recordedFrames >= windowFrames)
+		{
+			sortedFrameTimes.assign(frameTimes.begin(), frameTimes.end());
+			const auto middle = sortedFrameTimes.begin() + sortedFrameTimes.size() / 2;
+			std::nth_element(sortedFrameTimes.begin(), middle, sortedFrameTimes.end());
+			thresholdMs = *middle * spikeFactor;
+
+			if (frameMs > thresholdMs && !dumpPending && frameNumber >= nextSpikeFrame && dumpCount < MAX_DUMPS)
+			{
+				dumpPending = true;
+				spikeFrame = frameNumber;
+				spikeFrameMs = frameMs;
+				spikeMedianMs = *middle;
+				dumpFrame = frameNumber + DUMP_DELAY_FRAMES;
+			}
+		}
+
+		const size_t slot = recordedFrames % windowFrames;
+		frameTimes[slot] = frameMs;
+		frameEndNs[slot] = OegTrace::now();
+		recordedFrames++;
+
+		if (dumpPending && frameNumber >= dumpFrame)
+		{
+			dump();
+		}
+	}
+
+	void OegFlightRecorder::dump()
+	{
+		dumpPending = false;
+		nextSpikeFrame = spikeFrame + windowFrames;
+		dumpCount++;
+
+		// the oldest frame of the window started where the one before it ended, that end is gone from the ring
+		const size_t oldest = recordedFrames % windowFrames;
+		const uint64_t oldestFrameNs = static_cast<uint64_t>(static_cast<double>(frameTimes[oldest]) * 1000000.0);
+		const uint64_t sinceNs = frameEndNs[oldest] > oldestFrameNs ? frameEndNs[oldest] - oldestFrameNs : 0;
+
+		lastDumpFile = outputPrefix + "_frame" + std::to_string(spikeFrame) + ".json";
+		std::vector<std::pair<std::string, std::string>> metadata{
+			{"spikeFrame", std::to_string(spikeFrame)},
+			{"spikeFrameMs", std::to_string(spikeFrameMs)},
+			{"medianFrameMs", std::to_string(spikeMedianMs)},
+			{"spikeFactor", std::to_string(spikeFactor)},
+			{"windowFrames", std::to_string(windowFrames)}
+		};
+
+		// writing takes longer than a frame, it would be the next spike on the main thread
+		OegJobSystem::get().scheduleBackground(
+			[filepath = lastDumpFile, sinceNs, metadata = std::move(metadata)]
+			{
+				try
+				{
+					OegTrace::writeChromeTraceSince(filepath, sinceNs, metadata);
+					std::cout << "Frame spike, wrote " << filepath << "\n";
+				}
+				catch (const std::exception& e)
+				{
+					std::cerr << e.what() << "\n";
+				}
+			});
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * Writes a trace of the frames leading up to a hitch. OegTrace keeps recording into its rings, which
+	 * hold the CPU zones, GPU scopes, allocations and upload counters of the last few hundred frames;
+	 * when a frame takes longer than spikeFactor times the median of the window before it, those frames
+	 * are written to PREFIX_frameN.json on a background job.
+	 *
+	 * The write waits DUMP_DELAY_FRAMES frames so the spike's render thread work and GPU scopes have
+	 * arrived, and a spike inside the window of the previous dump does not start another one.
+	 */
+	class OegFlightRecorder
+	{
+	public:
+		static constexpr uint32_t DEFAULT_WINDOW_FRAMES = 300;
+		static constexpr float DEFAULT_SPIKE_FACTOR = 2.0f;
+		static constexpr uint32_t DUMP_DELAY_FRAMES = 4;
+		// a session with constant hitches should not fill the disk
+		static constexpr uint32_t MAX_DUMPS = 20;
+
+		// enables OegTrace
+		OegFlightRecorder(std::string outputPrefix, float spikeFactor = DEFAULT_SPIKE_FACTOR,
+		                  uint32_t windowFrames = DEFAULT_WINDOW_FRAMES);
+
+		OegFlightRecorder(const OegFlightRecorder&) = delete;
+		OegFlightRecorder& operator=(const OegFlightRecorder&) = delete;
+
+		// once per frame on one thread, as the frame ends, with its total time
+		void endFrame(uint64_t frameNumber, float frameMs);
+
+		// 0 until the window is full
+		float getThresholdMs() const { return thresholdMs; }
+		uint32_t getDumpCount() const { return dumpCount; }
+		const std::string& getLastDumpFile() const { return lastDumpFile; }
+
+	private:
+		void dump();
+
+		std::string outputPrefix;
+		float spikeFactor;
+		uint32_t windowFrames;
+
+		// rings of the last windowFrames frames
+		std::vector<float> frameTimes;
+		std::vector<uint64_t> frameEndNs;
+		uint64_t recordedFrames{0};
+		std::vector<float> sortedFrameTimes;
+		float thresholdMs{0.0f};
+
+		bool dumpPending{false};
+		uint64_t spikeFrame{0};
+		float spikeFrameMs{0.0f};
+		float spikeMedianMs{0.0f};
+		uint64_t dumpFrame{0};
+		// frames before this one are part of the previous dump
+		uint64_t nextSpikeFrame{0};
+		uint32_t dumpCount{0};
+		std::string lastDumpFile;
+	};
+}
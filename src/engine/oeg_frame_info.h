@@ -1,6 +1,7 @@
 #pragma once
 
 #include "oeg_camera.h"
+#include "oeg_command_recorder.h"
 
 //	lib
 
@@ -14,5 +15,7 @@ namespace oeg
 		float frameTime;
 		VkCommandBuffer commandBuffer;
 		OegCamera& camera;
+		OegCommandRecorder& recorder; // records into commandBuffer, drops redundant binds
+		VkDescriptorSet globalDescriptorSet; // GlobalUbo of this frame, bound at set 0
 	};
 }
@@ -0,0 +1,149 @@
+#include "oeg_frame_stats.h"
+#include "oeg_utils.h"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace oeg
+{
+	namespace
+	{
+		// nearest rank of a sorted, non empty list
+		float percentile(const std::vector<float>& sorted, float fraction)
+		{
+			const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<float>(sorted.size())));
+			return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+		}
+	}
+
+	OegFrameStats::OegFrameStats(std::vector<std::string> columnNames, uint64_t frameCount, uint64_t warmupFrames)
+		: columnNames{std::move(columnNames)}, frameCount{frameCount}, warmupFrames{std::min(warmupFrames, frameCount)}
+	{
+		values.assign(frameCount * this->columnNames.size(), std::numeric_limits<float>::quiet_NaN());
+	}
+
+	void OegFrameStats::set(uint64_t frame, size_t column, float value)
+	{
+		if (frame < frameCount && column < columnNames.size())
+		{
+			values[frame * columnNames.size() + column] = value;
+		}
+	}
+
+	FrameStatSummary OegFrameStats::summarize(size_t column) const
+	{
+		std::vector<float> sorted;
+		sorted.reserve(frameCount - warmupFrames);
+		for (uint64_t frame = warmupFrames; frame < frameCount; frame++)
+		{
+			const float value = values[frame * columnNames.size() + column];
+			if (!std::isnan(value))
+			{
+				sorted.push_back(value);
+			}
+		}
+		if (sorted.empty())
+		{
+			return {};
+		}
+		std::sort(sorted.begin(), sorted.end());
+
+		FrameStatSummary summary{};
+		double total = 0.0;
+		for (float value : sorted)
+		{
+			total += value;
+		}
+		summary.mean = static_cast<float>(total / static_cast<double>(sorted.size()));
+		summary.p50 = percentile(sorted, 0.50f);
+		summary.p95 = percentile(sorted, 0.95f);
+		summary.p99 = percentile(sorted, 0.99f);
+		summary.max = sorted.back();
+		summary.count = sorted.size();
+		return summary;
+	}
+
+	uint32_t OegFrameStats::countStutters() const
+	{
+		const float threshold = summarize(0).p50 * STUTTER_FACTOR;
+		uint32_t stutters = 0;
+		for (uint64_t frame = warmupFrames; frame < frameCount; frame++)
+		{
+			if (values[frame * columnNames.size()] > threshold)
+			{
+				stutters++;
+			}
+		}
+		return stutters;
+	}
+
+	void OegFrameStats::writeCsv(const std::string& filepath) const
+	{
+		std::ofstream file{filepath};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to write frame stats: " + filepath);
+		}
+
+		file << "frame";
+		for (const std::string& name : columnNames)
+		{
+			file << ',' << name;
+		}
+		file << '\n';
+
+		for (uint64_t frame = 0; frame < frameCount; frame++)
+		{
+			file << frame;
+			for (size_t column = 0; column < columnNames.size(); column++)
+			{
+				file << ',';
+				const float value = values[frame * columnNames.size() + column];
+				if (!std::isnan(value))
+				{
+					file << value;
+				}
+			}
+			file << '\n';
+		}
+	}
+
+	void OegFrameStats::writeJson(const std::string& filepath,
+	                              const std::vector<std::pair<std::string, std::string>>& metadata) const
+	{
+		std::ofstream file{filepath};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to write frame stats: " + filepath);
+		}
+
+		file << "{\n";
+		for (const auto& [key, value] : metadata)
+		{
+			file << "  \"" << escapeJson(key) << "\": \"" << escapeJson(value) << "\",\n";
+		}
+		file << "  \"frames\": " << frameCount << ",\n";
+		file << "  \"warmupFrames\": " << warmupFrames << ",\n";
+		file << "  \"stutterFactor\": " << STUTTER_FACTOR << ",\n";
+		file << "  \"stutters\": " << countStutters() << ",\n";
+		file << "  \"columns\": {\n";
+		for (size_t column = 0; column < columnNames.size(); column++)
+		{
+			const FrameStatSummary summary = summarize(column);
+			file << "    \"" << escapeJson(columnNames[column]) << "\": {"
+				<< "\"mean\": " << summary.mean
+				<< ", \"p50\": " << summary.p50
+				<< ", \"p95\": " << summary.p95
+				<< ", \"p99\": " << summary.p99
+				<< ", \"max\": " << summary.max
+				<< ", \"count\": " << summary.count << "}"
+				<< (column + 1 < columnNames.size() ? ",\n" : "\n");
+		}
+		file << "  }\n";
+		file << "}\n";
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace oeg
+{
+	struct FrameStatSummary
+	{
+		float mean{0.0f};
+		float p50{0.0f};
+		float p95{0.0f};
+		float p99{0.0f};
+		float max{0.0f};
+		// frames after warmup that set the column
+		uint64_t count{0};
+	};
+
+	/**
+	 * Per-frame timings and counts of a run with a known number of frames, one named column per stage or
+	 * counter. Every row is allocated up front, so threads can fill different columns of the same frame
+	 * without locking; results are only read once they have all stopped.
+	 *
+	 * The first warmup frames are kept in the CSV but left out of the summaries, they include pipeline
+	 * compilation and first touches of every buffer.
+	 *
+	 * A value a frame never set is NaN, an empty CSV field and no sample of the summary. GPU columns
+	 * arrive frames late and some stages do not run every frame, a 0 in their place would pull the
+	 * percentiles down.
+	 */
+	class OegFrameStats
+	{
+	public:
+		// a frame is counted as a stutter when its column 0 time exceeds this factor of the median
+		static constexpr float STUTTER_FACTOR = 2.0f;
+
+		OegFrameStats(std::vector<std::string> columnNames, uint64_t frameCount, uint64_t warmupFrames = 0);
+
+		// milliseconds or a count, frames past frameCount are ignored
+		void set(uint64_t frame, size_t column, float value);
+
+		uint64_t getFrameCount() const { return frameCount; }
+		const std::vector<std::string>& getColumnNames() const { return columnNames; }
+		// over the frames after warmup that set the column, all 0 if none did
+		FrameStatSummary summarize(size_t column) const;
+		uint32_t countStutters() const;
+
+		// one row per frame, one column per stage
+		void writeCsv(const std::string& filepath) const;
+		// summary of every column, metadata is written as string fields
+		void writeJson(const std::string& filepath,
+		               const std::vector<std::pair<std::string, std::string>>& metadata) const;
+
+	private:
+		std::vector<std::string> columnNames;
+		uint64_t frameCount;
+		uint64_t warmupFrames;
+		// frame major, frameCount rows of columnNames.size() values
+		std::vector<float> values;
+	};
+}
@@ -0,0 +1,165 @@
+#include "oeg_frustum_culler.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+// SIMD, AVX when the compiler targets it (/arch:AVX, -mavx), otherwise SSE which every x64 cpu has
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OEG_CULL_AVX
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define OEG_CULL_SSE
+#endif
+
+namespace oeg
+{
+	BoundingSphere transformSphere(const BoundingSphere& sphere, const glm::mat4& modelMatrix)
+	{
+		const float maxScale = glm::max(
+			glm::length(glm::vec3{modelMatrix[0]}),
+			glm::max(glm::length(glm::vec3{modelMatrix[1]}), glm::length(glm::vec3{modelMatrix[2]})));
+
+		return BoundingSphere{
+			glm::vec3{modelMatrix * glm::vec4{sphere.center, 1.0f}},
+			sphere.radius * maxScale
+		};
+	}
+
+	BoundingSphere transformSphere(const BoundingSphere& sphere, const PackedTransform& transform)
+	{
+		const glm::quat rotation{transform.rotation.w, transform.rotation.x, transform.rotation.y, transform.rotation.z};
+		const glm::vec3 absScale = glm::abs(transform.scale);
+
+		return BoundingSphere{
+			transform.translation + rotation * (transform.scale * sphere.center),
+			sphere.radius * glm::max(absScale.x, glm::max(absScale.y, absScale.z))
+		};
+	}
+
+	void OegFrustumCuller::resize(size_t count)
+	{
+		objectCount = count;
+		const size_t paddedCount = (count + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+
+		centersX.resize(paddedCount, 0.0f);
+		centersY.resize(paddedCount, 0.0f);
+		centersZ.resize(paddedCount, 0.0f);
+		radii.resize(paddedCount, 0.0f);
+		visibility.resize(paddedCount, 0);
+	}
+
+	/**
+		* Tests the spheres in [begin, end) against all six planes. begin and end must be multiples
+		* of BATCH_WIDTH; a sphere is visible unless it lies fully behind one of the planes.
+	*/
+	void OegFrustumCuller::cullRange(const FrustumPlanesSoA& planes, size_t begin, size_t end)
+	{
+		assert(begin % BATCH_WIDTH == 0 && end % BATCH_WIDTH == 0);
+
+#if defined(OEG_CULL_AVX)
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		for (size_t i = begin; i < end; i += 8)
+		{
+			const __m256 centerX = _mm256_loadu_ps(&centersX[i]);
+			const __m256 centerY = _mm256_loadu_ps(&centersY[i]);
+			const __m256 centerZ = _mm256_loadu_ps(&centersZ[i]);
+			const __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&radii[i]), signMask);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 distance = _mm256_mul_ps(_mm256_set1_ps(planes.normalsX[p]), centerX);
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalsY[p]), centerY));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes.normalsZ[p]), centerZ));
+				distance = _mm256_add_ps(distance, _mm256_set1_ps(planes.distances[p]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+			}
+
+			const int mask = _mm256_movemask_ps(inside);
+			for (int lane = 0; lane < 8; lane++)
+			{
+				visibility[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+			}
+		}
+#elif defined(OEG_CULL_SSE)
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (size_t i = begin; i < end; i += 4)
+		{
+			const __m128 centerX = _mm_loadu_ps(&centersX[i]);
+			const __m128 centerY = _mm_loadu_ps(&centersY[i]);
+			const __m128 centerZ = _mm_loadu_ps(&centersZ[i]);
+			const __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&radii[i]), signMask);
+
+			__m128 inside = _mm_cmpeq_ps(centerX, centerX);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_mul_ps(_mm_set1_ps(planes.normalsX[p]), centerX);
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalsY[p]), centerY));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes.normalsZ[p]), centerZ));
+				distance = _mm_add_ps(distance, _mm_set1_ps(planes.distances[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				visibility[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+			}
+		}
+#else
+		for (size_t i = begin; i < end; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				const float distance = planes.normalsX[p] * centersX[i] + planes.normalsY[p] * centersY[i] +
+					planes.normalsZ[p] * centersZ[i] + planes.distances[p];
+				inside = distance >= -radii[i];
+			}
+			visibility[i] = inside ? 1 : 0;
+		}
+#endif
+	}
+
+	void OegFrustumCuller::cull(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>& visibleIndices)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		FrustumPlanesSoA planes{};
+		for (int p = 0; p < 6; p++)
+		{
+			planes.normalsX[p] = frustumPlanes[p].x;
+			planes.normalsY[p] = frustumPlanes[p].y;
+			planes.normalsZ[p] = frustumPlanes[p].z;
+			planes.distances[p] = frustumPlanes[p].w;
+		}
+
+		// whole batches per job
+		OegJobSystem::get().parallelFor(
+			radii.size() / BATCH_WIDTH,
+			PARALLEL_THRESHOLD / BATCH_WIDTH,
+			[this, &planes](size_t beginBatch, size_t endBatch)
+			{
+				cullRange(planes, beginBatch * BATCH_WIDTH, endBatch * BATCH_WIDTH);
+			});
+
+		visibleIndices.clear();
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			if (visibility[i])
+			{
+				visibleIndices.push_back(static_cast<uint32_t>(i));
+			}
+		}
+
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.testedCount = static_cast<uint32_t>(objectCount);
+		stats.visibleCount = static_cast<uint32_t>(visibleIndices.size());
+		stats.culledCount = stats.testedCount - stats.visibleCount;
+		stats.cullTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+}
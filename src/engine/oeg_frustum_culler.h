@@ -0,0 +1,82 @@
+#pragma once
+
+#include "oeg_game_object.h"
+#include "oeg_model.h"
+
+// glm
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	struct CullingStats
+	{
+		uint32_t testedCount{0};
+		uint32_t visibleCount{0};
+		uint32_t culledCount{0};
+		float cullTimeMs{0.0f};
+	};
+
+	/**
+	 * \brief Bounding sphere of a model moved into world space by its model matrix
+	 */
+	BoundingSphere transformSphere(const BoundingSphere& sphere, const glm::mat4& modelMatrix);
+	BoundingSphere transformSphere(const BoundingSphere& sphere, const PackedTransform& transform);
+
+	/**
+	 * Tests world space bounding spheres against the camera frustum. Spheres are stored as
+	 * structure of arrays so the kernel can test 4 (SSE) or 8 (AVX) objects per iteration, and
+	 * large object counts are split across worker threads.
+	 */
+	class OegFrustumCuller
+	{
+	public:
+		// smallest run of objects handed to a job, fewer stay on the calling thread
+		static constexpr size_t PARALLEL_THRESHOLD = 4096;
+		static constexpr size_t BATCH_WIDTH = 8;
+
+		void resize(size_t objectCount);
+
+		void setSphere(size_t index, const BoundingSphere& worldSphere)
+		{
+			centersX[index] = worldSphere.center.x;
+			centersY[index] = worldSphere.center.y;
+			centersZ[index] = worldSphere.center.z;
+			radii[index] = worldSphere.radius;
+		}
+
+		/**
+		 * \brief Fills visibleIndices with the indices of all spheres inside the frustum, in ascending order
+		 */
+		void cull(const std::array<glm::vec4, 6>& frustumPlanes, std::vector<uint32_t>& visibleIndices);
+
+		const CullingStats& getStats() const { return stats; }
+
+	private:
+		struct FrustumPlanesSoA
+		{
+			float normalsX[6];
+			float normalsY[6];
+			float normalsZ[6];
+			float distances[6];
+		};
+
+		void cullRange(const FrustumPlanesSoA& planes, size_t begin, size_t end);
+
+		// padded up to a multiple of BATCH_WIDTH so the kernel never needs a scalar tail
+		std::vector<float> centersX;
+		std::vector<float> centersY;
+		std::vector<float> centersZ;
+		std::vector<float> radii;
+		std::vector<uint8_t> visibility;
+		size_t objectCount{0};
+
+		CullingStats stats{};
+	};
+}
@@ -2,64 +2,69 @@
 
 namespace oeg
 {
-	glm::mat4 TransformComponent::mat4()
+	const glm::mat4& TransformComponent::mat4()
 	{
-		const float c3 = glm::cos(rotation.z);
-		const float s3 = glm::sin(rotation.z);
-		const float c2 = glm::cos(rotation.x);
-		const float s2 = glm::sin(rotation.x);
-		const float c1 = glm::cos(rotation.y);
-		const float s1 = glm::sin(rotation.y);
-		return glm::mat4
+		if (dirty)
 		{
-			{
-				scale.x * (c1 * c3 + s1 * s2 * s3),
-				scale.x * (c2 * s3),
-				scale.x * (c1 * s2 * s3 - c3 * s1),
-				0.0f,
-			},
-			{
-				scale.y * (c3 * s1 * s2 - c1 * s3),
-				scale.y * (c2 * c3),
-				scale.y * (c1 * c3 * s2 + s1 * s3),
-				0.0f,
-			},
-			{
-				scale.z * (c2 * s1),
-				scale.z * (-s2),
-				scale.z * (c1 * c2),
-				0.0f,
-			},
-			{translation.x, translation.y, translation.z, 1.0f}
-		};
+			rebuild(
+				glm::sin(rotation.x), glm::cos(rotation.x),
+				glm::sin(rotation.y), glm::cos(rotation.y),
+				glm::sin(rotation.z), glm::cos(rotation.z));
+		}
+		return modelMatrix;
+	}
+
+	const glm::mat3& TransformComponent::normalMatrix()
+	{
+		mat4();
+		return normal;
 	}
 
-	glm::mat3 TransformComponent::normalMatrix()
+	void TransformComponent::rebuild(float sinX, float cosX, float sinY, float cosY, float sinZ, float cosZ)
 	{
-		const float c3 = glm::cos(rotation.z);
-		const float s3 = glm::sin(rotation.z);
-		const float c2 = glm::cos(rotation.x);
-		const float s2 = glm::sin(rotation.x);
-		const float c1 = glm::cos(rotation.y);
-		const float s1 = glm::sin(rotation.y);
+		const float c3 = cosZ;
+		const float s3 = sinZ;
+		const float c2 = cosX;
+		const float s2 = sinX;
+		const float c1 = cosY;
+		const float s1 = sinY;
+
+		// the rotation part shared by both matrices
+		const glm::vec3 right{c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1};
+		const glm::vec3 up{c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3};
+		const glm::vec3 forward{c2 * s1, -s2, c1 * c2};
+
+		modelMatrix = glm::mat4{
+			glm::vec4{scale.x * right, 0.0f},
+			glm::vec4{scale.y * up, 0.0f},
+			glm::vec4{scale.z * forward, 0.0f},
+			glm::vec4{translation, 1.0f}
+		};
+
 		const glm::vec3 invScale = 1.0f / scale;
-		return glm::mat3
-		{
-			{
-				invScale.x * (c1 * c3 + s1 * s2 * s3),
-				invScale.x * (c2 * s3),
-				invScale.x * (c1 * s2 * s3 - c3 * s1),
-			},
-			{
-				invScale.y * (c3 * s1 * s2 - c1 * s3),
-				invScale.y * (c2 * c3),
-				invScale.y * (c1 * c3 * s2 + s1 * s3),
-			},
-			{
-				invScale.z * (c2 * s1),
-				invScale.z * (-s2),
-				invScale.z * (c1 * c2),
-			},
+		normal = glm::mat3{invScale.x * right, invScale.y * up, invScale.z * forward};
+		// the basis is orthonormal, no lengths to divide out first
+		orientation = glm::quat_cast(glm::mat3{right, up, forward});
+		dirty = false;
+	}
+
+	PackedTransform TransformComponent::packed()
+	{
+		mat4();
+		return PackedTransform{
+			glm::vec4{orientation.x, orientation.y, orientation.z, orientation.w}, translation, scale
+		};
+	}
+
+	PackedTransform composeTransforms(const PackedTransform& parent, const PackedTransform& local)
+	{
+		const glm::quat parentRotation{parent.rotation.w, parent.rotation.x, parent.rotation.y, parent.rotation.z};
+		const glm::quat localRotation{local.rotation.w, local.rotation.x, local.rotation.y, local.rotation.z};
+		const glm::quat rotation = parentRotation * localRotation;
+		return PackedTransform{
+			glm::vec4{rotation.x, rotation.y, rotation.z, rotation.w},
+			parent.translation + parentRotation * (parent.scale * local.translation),
+			parent.scale * local.scale
 		};
 	}
 }
@@ -4,53 +4,79 @@
 
 //libs
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 //std
 #include <memory>
 
 namespace oeg
 {
-	struct TransformComponent
+	/**
+	 * \brief Translation, rotation and scale as the GPU reads them, 40 bytes instead of a model and
+	 * normal matrix. Tightly packed, shaders read it as 10 floats.
+	 */
+	struct PackedTransform
 	{
-		glm::vec3 translation{}; //position offset
+		glm::vec4 rotation{0.f, 0.f, 0.f, 1.f}; // quaternion, xyzw
+		glm::vec3 translation{};
 		glm::vec3 scale{1.f, 1.f, 1.f};
-		glm::vec3 rotation; // spinnnn
-
-
-		// matrix translates to Ry * Rz * Rx * scale transformation, using tait-bryan angles with the order
-		// as follows: Y(1), X(2), Z(3)
-		// https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
-		glm::mat4 mat4();
-		glm::mat3 normalMatrix();
 	};
 
-	class OegGameObject
+	static_assert(sizeof(PackedTransform) == 10 * sizeof(float), "PackedTransform must stay tightly packed");
+
+	/**
+	 * \brief Translation, Euler rotation and scale, with the model and normal matrices cached until one
+	 * of them changes. Changes only go through the setters, so the dirty flag cannot be missed.
+	 */
+	class TransformComponent
 	{
 	public:
-		using idType = unsigned int;
+		const glm::vec3& getTranslation() const { return translation; }
+		const glm::vec3& getRotation() const { return rotation; }
+		const glm::vec3& getScale() const { return scale; }
 
-		static OegGameObject createGameObject()
-		{
-			static idType currentID = 0;
-			return OegGameObject{currentID++};
-		}
+		void setTranslation(const glm::vec3& value) { translation = value; dirty = true; }
+		void setRotation(const glm::vec3& value) { rotation = value; dirty = true; }
+		void setScale(const glm::vec3& value) { scale = value; dirty = true; }
 
-		OegGameObject(const OegGameObject&) = delete;
-		OegGameObject& operator=(const OegGameObject&) = delete;
-		OegGameObject(OegGameObject&&) = default;
-		OegGameObject& operator=(OegGameObject&&) = default;
+		bool isDirty() const { return dirty; }
 
-		idType getID() { return id; }
+		// matrix translates to Ry * Rz * Rx * scale transformation, using tait-bryan angles with the order
+		// as follows: Y(1), X(2), Z(3)
+		// https://en.wikipedia.org/wiki/Euler_angles#Rotation_matrix
+		// rebuilt here if nothing rebuilt it since the last change, see OegTransformUpdater
+		const glm::mat4& mat4();
+		const glm::mat3& normalMatrix();
+		// rotation of mat4 as a quaternion, translation and scale are the components as they are
+		PackedTransform packed();
 
-		std::shared_ptr<OegModel> model{};
-		glm::vec3 color{};
-		TransformComponent transform{};
+		// refreshes the cached matrices from the sines and cosines of rotation x, y and z, clears the dirty flag
+		void rebuild(float sinX, float cosX, float sinY, float cosY, float sinZ, float cosZ);
 
 	private:
-		OegGameObject(idType objectID) : id{objectID}
-		{
-		};
+		glm::vec3 translation{}; //position offset
+		glm::vec3 scale{1.f, 1.f, 1.f};
+		glm::vec3 rotation{}; // spinnnn
 
-		idType id;
+		glm::mat4 modelMatrix{1.f};
+		glm::mat3 normal{1.f};
+		glm::quat orientation{1.f, 0.f, 0.f, 0.f};
+		bool dirty{true};
 	};
+
+	/**
+	 * \brief Local transform combined with every parent's, what gets drawn. Roots have their local
+	 * matrices here, see OegSceneGraph
+	 */
+	struct WorldTransform
+	{
+		glm::mat4 modelMatrix{1.f};
+		glm::mat3 normalMatrix{1.f};
+		// composed from the local transforms alongside the matrices, exact as long as no parent scales non
+		// uniformly; a matrix with shear has no translation, rotation and scale to pack
+		PackedTransform packed{};
+	};
+
+	// local relative to parent, the translation, rotation and scale of parent * local
+	PackedTransform composeTransforms(const PackedTransform& parent, const PackedTransform& local);
 }
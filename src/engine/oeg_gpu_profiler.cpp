@@ -0,0 +1,396 @@
+#include "oeg_gpu_profiler.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace oeg
+{
+	namespace
+	{
+		// scope past MAX_SCOPES_PER_FRAME, still has to be closed
+		constexpr uint32_t UNTIMED_SCOPE = UINT32_MAX;
+
+		// the results of a query come in the order of these bits
+		constexpr VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+		constexpr uint32_t PIPELINE_STATISTIC_COUNT = 5;
+
+		std::vector<VkQueryPool> createQueryPools(OegDevice& device, const VkQueryPoolCreateInfo& queryPoolInfo,
+		                                          uint32_t count)
+		{
+			std::vector<VkQueryPool> queryPools(count, VK_NULL_HANDLE);
+			for (VkQueryPool& queryPool : queryPools)
+			{
+				if (vkCreateQueryPool(device.device(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create GPU profiler query pool!");
+				}
+			}
+			return queryPools;
+		}
+	}
+
+	OegGpuProfiler::OegGpuProfiler(OegDevice& device, uint32_t frameSlotCount)
+		: oegDevice{device}
+	{
+		// the limit promises timestamps on every graphics queue, but how many bits they have is up to the family
+		VkPhysicalDevice physicalDevice = oegDevice.getPhysicalDevice();
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+		const uint32_t timestampValidBits =
+			queueFamilies[oegDevice.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+
+		if (oegDevice.properties.limits.timestampComputeAndGraphics && timestampValidBits > 0)
+		{
+			timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolInfo.queryCount = 2 * MAX_SCOPES_PER_FRAME;
+			queryPools = createQueryPools(oegDevice, queryPoolInfo, frameSlotCount);
+			// a value and its availability per query
+			queryResults.resize(2 * queryPoolInfo.queryCount);
+		}
+
+		if (oegDevice.supportsPipelineStatisticsQuery())
+		{
+			VkQueryPoolCreateInfo queryPoolInfo{};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			queryPoolInfo.queryCount = MAX_STATISTICS_RANGES_PER_FRAME;
+			queryPoolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+			statisticsQueryPools = createQueryPools(oegDevice, queryPoolInfo, frameSlotCount);
+			// the values and their availability per query
+			statisticsResults.resize((PIPELINE_STATISTIC_COUNT + 1) * MAX_STATISTICS_RANGES_PER_FRAME);
+		}
+
+		if (!isSupported() && !supportsPipelineStatistics())
+		{
+			return;
+		}
+		frameSlots.resize(frameSlotCount);
+		for (FrameSlot& frameSlot : frameSlots)
+		{
+			frameSlot.scopes.reserve(MAX_SCOPES_PER_FRAME);
+		}
+		traceTrack = &OegTrace::createTrack("GPU");
+	}
+
+	OegGpuProfiler::~OegGpuProfiler()
+	{
+		for (VkQueryPool queryPool : queryPools)
+		{
+			vkDestroyQueryPool(oegDevice.device(), queryPool, nullptr);
+		}
+		for (VkQueryPool queryPool : statisticsQueryPools)
+		{
+			vkDestroyQueryPool(oegDevice.device(), queryPool, nullptr);
+		}
+	}
+
+	void OegGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frameId)
+	{
+		if (frameSlots.empty())
+		{
+			return;
+		}
+
+		readSlot(slot);
+
+		currentSlot = slot;
+		FrameSlot& frameSlot = frameSlots[slot];
+		frameSlot.frameId = frameId;
+		frameSlot.scopes.clear();
+		frameSlot.statisticsRangeCount = 0;
+		frameSlot.written = true;
+		openScopes.clear();
+		statisticsRangeOpen = false;
+
+		if (supportsPipelineStatistics())
+		{
+			vkCmdResetQueryPool(commandBuffer, statisticsQueryPools[slot], 0, MAX_STATISTICS_RANGES_PER_FRAME);
+		}
+		if (isSupported())
+		{
+			vkCmdResetQueryPool(commandBuffer, queryPools[slot], 0, 2 * MAX_SCOPES_PER_FRAME);
+			beginScope(commandBuffer, "frame");
+		}
+	}
+
+	void OegGpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+	{
+		if (frameSlots.empty())
+		{
+			return;
+		}
+		assert(!statisticsRangeOpen && "Every pipeline statistics range has to be closed before the frame ends");
+		if (isSupported())
+		{
+			assert(openScopes.size() == 1 && "Every GPU scope has to be closed before the frame ends");
+			endScope(commandBuffer);
+		}
+		frameSlots[currentSlot].recordEndNs = OegTrace::now();
+	}
+
+	void OegGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+	{
+		if (!isSupported())
+		{
+			return;
+		}
+
+		FrameSlot& frameSlot = frameSlots[currentSlot];
+		if (frameSlot.scopes.size() >= MAX_SCOPES_PER_FRAME)
+		{
+			openScopes.push_back(UNTIMED_SCOPE);
+			return;
+		}
+
+		const uint32_t scope = static_cast<uint32_t>(frameSlot.scopes.size());
+		frameSlot.scopes.push_back(Scope{name, static_cast<uint32_t>(openScopes.size()), false});
+		openScopes.push_back(scope);
+		writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 2 * scope);
+	}
+
+	void OegGpuProfiler::endScope(VkCommandBuffer commandBuffer)
+	{
+		if (!isSupported())
+		{
+			return;
+		}
+		assert(!openScopes.empty() && "endScope without a matching beginScope");
+
+		const uint32_t scope = openScopes.back();
+		openScopes.pop_back();
+		if (scope == UNTIMED_SCOPE)
+		{
+			return;
+		}
+
+		writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2 * scope + 1);
+		frameSlots[currentSlot].scopes[scope].ended = true;
+	}
+
+	void OegGpuProfiler::beginPipelineStatistics(VkCommandBuffer commandBuffer)
+	{
+		if (!supportsPipelineStatistics())
+		{
+			return;
+		}
+		assert(!statisticsRangeOpen && "Pipeline statistics ranges can not nest");
+
+		FrameSlot& frameSlot = frameSlots[currentSlot];
+		statisticsRangeOpen = true;
+		statisticsRangeCounted = frameSlot.statisticsRangeCount < MAX_STATISTICS_RANGES_PER_FRAME;
+		if (statisticsRangeCounted)
+		{
+			vkCmdBeginQuery(commandBuffer, statisticsQueryPools[currentSlot], frameSlot.statisticsRangeCount, 0);
+		}
+	}
+
+	void OegGpuProfiler::endPipelineStatistics(VkCommandBuffer commandBuffer)
+	{
+		if (!supportsPipelineStatistics())
+		{
+			return;
+		}
+		assert(statisticsRangeOpen && "endPipelineStatistics without a matching beginPipelineStatistics");
+
+		statisticsRangeOpen = false;
+		if (statisticsRangeCounted)
+		{
+			FrameSlot& frameSlot = frameSlots[currentSlot];
+			vkCmdEndQuery(commandBuffer, statisticsQueryPools[currentSlot], frameSlot.statisticsRangeCount);
+			frameSlot.statisticsRangeCount++;
+		}
+	}
+
+	std::vector<GpuFrameProfile> OegGpuProfiler::readPendingProfiles(uint32_t oldestSlot)
+	{
+		std::vector<GpuFrameProfile> profiles;
+		for (uint32_t i = 0; i < frameSlots.size(); i++)
+		{
+			const uint32_t slot = (oldestSlot + i) % static_cast<uint32_t>(frameSlots.size());
+			if (frameSlots[slot].written)
+			{
+				readSlot(slot);
+				if (lastProfile.valid || lastProfile.pipelineStatistics.valid)
+				{
+					profiles.push_back(lastProfile);
+				}
+			}
+		}
+		return profiles;
+	}
+
+	void OegGpuProfiler::readSlot(uint32_t slot)
+	{
+		FrameSlot& frameSlot = frameSlots[slot];
+		if (!frameSlot.written)
+		{
+			return;
+		}
+		frameSlot.written = false;
+
+		lastProfile.frameId = frameSlot.frameId;
+		lastProfile.scopes.clear();
+		lastProfile.valid = false;
+		lastProfile.pipelineStatistics = {};
+
+		readTimestamps(slot);
+		readPipelineStatistics(slot);
+
+		if (OegTrace::isEnabled())
+		{
+			traceProfile(frameSlot.recordEndNs);
+		}
+	}
+
+	void OegGpuProfiler::readTimestamps(uint32_t slot)
+	{
+		const FrameSlot& frameSlot = frameSlots[slot];
+		if (frameSlot.scopes.empty())
+		{
+			return;
+		}
+
+		// no wait flag, VK_NOT_READY only means some of the queries are missing and availability says which
+		const uint32_t queryCount = 2 * static_cast<uint32_t>(frameSlot.scopes.size());
+		const VkResult result = vkGetQueryPoolResults(
+			oegDevice.device(),
+			queryPools[slot],
+			0,
+			queryCount,
+			2 * queryCount * sizeof(uint64_t),
+			queryResults.data(),
+			2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			return;
+		}
+
+		const double millisecondsPerTick = oegDevice.properties.limits.timestampPeriod / 1000000.0;
+		const uint64_t frameBegin = queryResults[0] & timestampMask;
+		auto measureScope = [&](uint32_t scope, float& startMilliseconds, float& milliseconds)
+		{
+			const uint64_t* begin = &queryResults[4 * scope];
+			const uint64_t* end = &queryResults[4 * scope + 2];
+			if (!frameSlot.scopes[scope].ended || begin[1] == 0 || end[1] == 0)
+			{
+				return false;
+			}
+			// the bits above the valid ones are undefined, a wrapped counter comes out right modulo the mask
+			const uint64_t beginTicks = begin[0] & timestampMask;
+			const uint64_t endTicks = end[0] & timestampMask;
+			startMilliseconds = static_cast<float>(
+				static_cast<double>((beginTicks - frameBegin) & timestampMask) * millisecondsPerTick);
+			milliseconds = static_cast<float>(
+				static_cast<double>((endTicks - beginTicks) & timestampMask) * millisecondsPerTick);
+			return true;
+		};
+
+		float frameStartMilliseconds = 0.0f;
+		if (!measureScope(0, frameStartMilliseconds, lastProfile.frameMilliseconds))
+		{
+			return;
+		}
+		for (uint32_t scope = 1; scope < frameSlot.scopes.size(); scope++)
+		{
+			GpuScopeTime scopeTime{frameSlot.scopes[scope].name, frameSlot.scopes[scope].depth - 1};
+			if (measureScope(scope, scopeTime.startMilliseconds, scopeTime.milliseconds))
+			{
+				lastProfile.scopes.push_back(scopeTime);
+			}
+		}
+		lastProfile.valid = true;
+	}
+
+	void OegGpuProfiler::readPipelineStatistics(uint32_t slot)
+	{
+		const FrameSlot& frameSlot = frameSlots[slot];
+		if (frameSlot.statisticsRangeCount == 0)
+		{
+			return;
+		}
+
+		const uint32_t stride = (PIPELINE_STATISTIC_COUNT + 1) * sizeof(uint64_t);
+		const VkResult result = vkGetQueryPoolResults(
+			oegDevice.device(),
+			statisticsQueryPools[slot],
+			0,
+			frameSlot.statisticsRangeCount,
+			frameSlot.statisticsRangeCount * stride,
+			statisticsResults.data(),
+			stride,
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			return;
+		}
+
+		// a sum with a range missing would read as less work, so the frame has none instead
+		GpuPipelineStatistics statistics{};
+		for (uint32_t range = 0; range < frameSlot.statisticsRangeCount; range++)
+		{
+			const uint64_t* values = &statisticsResults[(PIPELINE_STATISTIC_COUNT + 1) * range];
+			if (values[PIPELINE_STATISTIC_COUNT] == 0)
+			{
+				return;
+			}
+			statistics.inputAssemblyPrimitives += values[0];
+			statistics.vertexShaderInvocations += values[1];
+			statistics.clippingInvocations += values[2];
+			statistics.clippingPrimitives += values[3];
+			statistics.fragmentShaderInvocations += values[4];
+		}
+		statistics.valid = true;
+		lastProfile.pipelineStatistics = statistics;
+	}
+
+	void OegGpuProfiler::traceProfile(uint64_t recordEndNs)
+	{
+		auto toNanoseconds = [](float milliseconds)
+		{
+			return static_cast<uint64_t>(static_cast<double>(milliseconds) * 1000000.0);
+		};
+
+		if (lastProfile.valid)
+		{
+			traceTrack->record(TraceEvent{"frame", recordEndNs, toNanoseconds(lastProfile.frameMilliseconds)});
+			for (const GpuScopeTime& scope : lastProfile.scopes)
+			{
+				traceTrack->record(TraceEvent{
+					scope.name, recordEndNs + toNanoseconds(scope.startMilliseconds), toNanoseconds(scope.milliseconds)
+				});
+			}
+		}
+
+		const GpuPipelineStatistics& statistics = lastProfile.pipelineStatistics;
+		if (statistics.valid)
+		{
+			traceTrack->record(TraceEvent{
+				"vertexShaderInvocations", recordEndNs, 0, TraceEventKind::Counter, statistics.vertexShaderInvocations
+			});
+			traceTrack->record(TraceEvent{
+				"clippingPrimitives", recordEndNs, 0, TraceEventKind::Counter, statistics.clippingPrimitives
+			});
+			traceTrack->record(TraceEvent{
+				"fragmentShaderInvocations", recordEndNs, 0, TraceEventKind::Counter,
+				statistics.fragmentShaderInvocations
+			});
+		}
+	}
+
+	void OegGpuProfiler::writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query)
+	{
+		vkCmdWriteTimestamp(commandBuffer, stage, queryPools[currentSlot], query);
+	}
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "oeg_device.h"
+#include "oeg_trace.h"
+
+// 3rd party
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	struct GpuScopeTime
+	{
+		// the literal the scope was opened with
+		const char* name{nullptr};
+		// number of scopes it is nested in
+		uint32_t depth{0};
+		// from the start of the frame
+		float startMilliseconds{0.0f};
+		float milliseconds{0.0f};
+	};
+
+	// graphics pipeline counters summed over the statistics ranges of a frame
+	struct GpuPipelineStatistics
+	{
+		uint64_t inputAssemblyPrimitives{0};
+		uint64_t vertexShaderInvocations{0};
+		// primitives that reached clipping and the ones it passed on to the rasterizer
+		uint64_t clippingInvocations{0};
+		uint64_t clippingPrimitives{0};
+		uint64_t fragmentShaderInvocations{0};
+		bool valid{false};
+	};
+
+	// GPU times of one finished frame, scopes in the order they were opened
+	struct GpuFrameProfile
+	{
+		uint64_t frameId{0};
+		// between the first and the last command of the frame
+		float frameMilliseconds{0.0f};
+		std::vector<GpuScopeTime> scopes;
+		// the times, the statistics have their own flag
+		bool valid{false};
+		GpuPipelineStatistics pipelineStatistics{};
+	};
+
+	/**
+	 * Times named scopes of a frame's command buffer with timestamp queries, one query pool per frame
+	 * in flight. A frame's results are read when its slot comes around again, after the fence of that
+	 * slot was waited for, so reading never stalls; a scope whose queries are not available yet is
+	 * dropped instead of waited for.
+	 *
+	 * The begin of a scope is written at the top of the pipe and its end at the bottom, so a scope also
+	 * covers work of earlier commands that is still in flight when it begins. Devices without
+	 * timestamps on graphics and compute queues get empty profiles. Timestamps only have the graphics
+	 * family's timestampValidBits, differences are taken modulo that so a counter that wraps mid-frame
+	 * still measures right.
+	 *
+	 * Pipeline statistics are counted the same way, over the ranges between beginPipelineStatistics and
+	 * endPipelineStatistics, and need the device's pipelineStatisticsQuery feature.
+	 *
+	 * While OegTrace is enabled the scopes and statistics also go to a "GPU" trace track. GPU and CPU clocks are not
+	 * calibrated against each other, so a frame is placed at the time its recording ended; it ran no
+	 * earlier than that.
+	 */
+	class OegGpuProfiler
+	{
+	public:
+		static constexpr uint32_t MAX_SCOPES_PER_FRAME = 64;
+		static constexpr uint32_t MAX_STATISTICS_RANGES_PER_FRAME = 4;
+
+		OegGpuProfiler(OegDevice& device, uint32_t frameSlotCount);
+		~OegGpuProfiler();
+
+		OegGpuProfiler(const OegGpuProfiler&) = delete;
+		OegGpuProfiler& operator=(const OegGpuProfiler&) = delete;
+
+		// timestamps
+		bool isSupported() const { return !queryPools.empty(); }
+		bool supportsPipelineStatistics() const { return !statisticsQueryPools.empty(); }
+
+		// reads what the slot's previous frame wrote, then resets the slot and starts the frame scope.
+		// Has to be recorded outside of a render pass
+		void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frameId);
+		void endFrame(VkCommandBuffer commandBuffer);
+
+		// name has to outlive the profile, scopes past MAX_SCOPES_PER_FRAME are not timed
+		void beginScope(VkCommandBuffer commandBuffer, const char* name);
+		// closes the innermost open scope
+		void endScope(VkCommandBuffer commandBuffer);
+
+		// ranges do not nest; one begun in a render pass has to end in the same subpass, one begun outside
+		// has to end outside. The frame's statistics are their sum, ranges past MAX_STATISTICS_RANGES_PER_FRAME
+		// are not counted
+		void beginPipelineStatistics(VkCommandBuffer commandBuffer);
+		void endPipelineStatistics(VkCommandBuffer commandBuffer);
+
+		// newest frame that was read, MAX_FRAMES_IN_FLIGHT frames behind the one being recorded
+		const GpuFrameProfile& getLastProfile() const { return lastProfile; }
+		// the device has to be idle, reads every slot that has not been read yet, oldest first
+		std::vector<GpuFrameProfile> readPendingProfiles(uint32_t oldestSlot);
+
+	private:
+		struct Scope
+		{
+			const char* name;
+			uint32_t depth;
+			bool ended;
+		};
+
+		struct FrameSlot
+		{
+			uint64_t frameId{0};
+			// OegTrace::now at endFrame
+			uint64_t recordEndNs{0};
+			// the frame scope is scope 0
+			std::vector<Scope> scopes;
+			uint32_t statisticsRangeCount{0};
+			bool written{false};
+		};
+
+		void readSlot(uint32_t slot);
+		void readTimestamps(uint32_t slot);
+		void readPipelineStatistics(uint32_t slot);
+		void writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query);
+		void traceProfile(uint64_t recordEndNs);
+
+		OegDevice& oegDevice;
+		// two queries per scope, the begin at 2 * scope
+		std::vector<VkQueryPool> queryPools;
+		// one query per statistics range
+		std::vector<VkQueryPool> statisticsQueryPools;
+		std::vector<FrameSlot> frameSlots;
+		std::vector<uint64_t> queryResults;
+		std::vector<uint64_t> statisticsResults;
+		// the bits of a timestamp the graphics family writes
+		uint64_t timestampMask{0};
+		GpuFrameProfile lastProfile{};
+		OegTraceTrack* traceTrack{nullptr};
+
+		uint32_t currentSlot{0};
+		std::vector<uint32_t> openScopes;
+		bool statisticsRangeOpen{false};
+		// false for a range past MAX_STATISTICS_RANGES_PER_FRAME
+		bool statisticsRangeCounted{false};
+	};
+}
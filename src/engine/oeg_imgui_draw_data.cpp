@@ -0,0 +1,32 @@
+#include "oeg_imgui_draw_data.h"
+
+namespace oeg
+{
+	OegImGuiDrawData::~OegImGuiDrawData()
+	{
+		clear();
+	}
+
+	void OegImGuiDrawData::copyFrom(const ImDrawData& source)
+	{
+		clear();
+
+		// the header fields are plain values, only the lists point into ImGui's frame
+		drawData = source;
+		for (ImDrawList*& list : drawData.CmdLists)
+		{
+			list = list->CloneOutput();
+		}
+		valid = true;
+	}
+
+	void OegImGuiDrawData::clear()
+	{
+		for (ImDrawList* list : drawData.CmdLists)
+		{
+			IM_DELETE(list);
+		}
+		drawData.Clear();
+		valid = false;
+	}
+}
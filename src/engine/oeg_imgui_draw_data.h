@@ -0,0 +1,32 @@
+#pragma once
+
+#include <imgui.h>
+
+namespace oeg
+{
+	/**
+	 * Owned copy of a frame's ImGui draw data. ImGui reuses its draw lists on the next NewFrame, so a
+	 * render thread that records the UI of an earlier frame needs its own copy of the vertices and
+	 * commands.
+	 */
+	class OegImGuiDrawData
+	{
+	public:
+		OegImGuiDrawData() = default;
+		~OegImGuiDrawData();
+
+		OegImGuiDrawData(const OegImGuiDrawData&) = delete;
+		OegImGuiDrawData& operator=(const OegImGuiDrawData&) = delete;
+
+		// copies the result of ImGui::Render, call on the thread that owns the ImGui context
+		void copyFrom(const ImDrawData& source);
+		void clear();
+
+		// nullptr when nothing was copied
+		ImDrawData* get() { return valid ? &drawData : nullptr; }
+
+	private:
+		ImDrawData drawData{};
+		bool valid{false};
+	};
+}
@@ -0,0 +1,368 @@
+#include "oeg_job_system.h"
+#include "oeg_trace.h"
+
+// std
+#include <cassert>
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace oeg
+{
+	namespace
+	{
+		OegJobSystem* instance = nullptr;
+
+		// deque of the current thread, 0 for threads that are not workers
+		thread_local uint32_t currentQueueIndex = 0;
+		// jobs run inside a wait are nested, only the outermost one counts towards the busy time
+		thread_local uint32_t jobDepth = 0;
+
+		// a job without a counter has nobody waiting for it, rethrowing would end the thread and the process
+		void logUnhandled(const std::exception_ptr& exception)
+		{
+			try
+			{
+				std::rethrow_exception(exception);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "job without a counter failed: " << e.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::cerr << "job without a counter failed with an unknown exception" << std::endl;
+			}
+		}
+	}
+
+	uint32_t OegJobSystem::defaultWorkerCount()
+	{
+		const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	OegJobSystem::OegJobSystem(uint32_t workerCount)
+	{
+		assert(instance == nullptr && "There is only one job system per process");
+		instance = this;
+
+		mainThreadId = std::this_thread::get_id();
+		lastSampleTime = std::chrono::steady_clock::now();
+
+		for (uint32_t i = 0; i < workerCount + 1; i++)
+		{
+			queues.push_back(std::make_unique<WorkerQueue>());
+		}
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&OegJobSystem::workerLoop, this, i + 1);
+		}
+	}
+
+	OegJobSystem::~OegJobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		sleepCondition.notify_all();
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		instance = nullptr;
+	}
+
+	OegJobSystem& OegJobSystem::get()
+	{
+		assert(instance != nullptr && "The job system has to be created before jobs are scheduled");
+		return *instance;
+	}
+
+	void OegJobSystem::schedule(std::function<void()> function, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		push(Job{std::move(function), counter});
+	}
+
+	void OegJobSystem::scheduleAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job job{std::move(function), counter};
+		{
+			// the last job of dependency takes the lock to collect continuations, see finish
+			std::lock_guard<std::mutex> lock(dependency.mutex);
+			if (!dependency.isDone())
+			{
+				dependency.continuations.push_back(std::move(job));
+				return;
+			}
+		}
+		push(std::move(job));
+	}
+
+	void OegJobSystem::scheduleBackground(std::function<void()> function, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		// counted before it is visible, so the count never drops below the jobs a thief can find
+		queuedCount.fetch_add(1, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(backgroundMutex);
+			backgroundJobs.push_back(Job{std::move(function), counter});
+		}
+		wakeWorker();
+	}
+
+	void OegJobSystem::scheduleOnMainThread(std::function<void()> function, JobCounter* counter)
+	{
+		if (counter)
+		{
+			counter->pending.fetch_add(1, std::memory_order_relaxed);
+		}
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		mainThreadJobs.push_back(Job{std::move(function), counter});
+	}
+
+	void OegJobSystem::runMainThreadJobs()
+	{
+		assert(isMainThread() && "Main thread jobs have to run on the main thread");
+
+		// jobs queued by the ones running now wait for the next call
+		std::deque<Job> jobs;
+		{
+			std::lock_guard<std::mutex> lock(mainThreadMutex);
+			jobs.swap(mainThreadJobs);
+		}
+		for (Job& job : jobs)
+		{
+			run(job, currentQueueIndex);
+		}
+	}
+
+	void OegJobSystem::wait(JobCounter& counter)
+	{
+		while (!counter.isDone())
+		{
+			Job job;
+			// a job this thread waits for may be pinned to it
+			if ((isMainThread() && takeMainThreadJob(job)) || takeJob(currentQueueIndex, job))
+			{
+				run(job, currentQueueIndex);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// once the last job has let go of the lock the counter is no longer touched by any other thread
+		std::lock_guard<std::mutex> lock(counter.mutex);
+		if (counter.exception)
+		{
+			std::exception_ptr exception = counter.exception;
+			counter.exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+
+	std::vector<JobWorkerStats> OegJobSystem::sampleStats()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastSampleTime).count();
+		lastSampleTime = now;
+
+		std::vector<JobWorkerStats> stats(queues.size());
+		for (size_t i = 0; i < queues.size(); i++)
+		{
+			WorkerQueue& queue = *queues[i];
+			const uint64_t busy = queue.busyNanoseconds.load(std::memory_order_relaxed);
+			const uint32_t jobs = queue.jobCount.load(std::memory_order_relaxed);
+			const uint32_t steals = queue.stealCount.load(std::memory_order_relaxed);
+
+			stats[i].jobCount = jobs - queue.sampledJobCount;
+			stats[i].stealCount = steals - queue.sampledStealCount;
+			stats[i].utilization = elapsed > 0
+				? std::min(1.0f, static_cast<float>(busy - queue.sampledBusyNanoseconds) / static_cast<float>(elapsed))
+				: 0.0f;
+
+			queue.sampledBusyNanoseconds = busy;
+			queue.sampledJobCount = jobs;
+			queue.sampledStealCount = steals;
+		}
+		return stats;
+	}
+
+	void OegJobSystem::workerLoop(uint32_t queueIndex)
+	{
+		currentQueueIndex = queueIndex;
+		OegTrace::setThreadName("worker " + std::to_string(queueIndex));
+
+		while (true)
+		{
+			Job job;
+			if (takeJob(queueIndex, job) || takeBackgroundJob(job))
+			{
+				run(job, queueIndex);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepCondition.wait(lock, [this]
+			{
+				return stopping || queuedCount.load(std::memory_order_acquire) > 0;
+			});
+			if (stopping && queuedCount.load(std::memory_order_acquire) == 0)
+			{
+				return;
+			}
+		}
+	}
+
+	void OegJobSystem::push(Job job)
+	{
+		WorkerQueue& queue = *queues[currentQueueIndex];
+		queuedCount.fetch_add(1, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+		wakeWorker();
+	}
+
+	bool OegJobSystem::takeJob(uint32_t queueIndex, Job& job)
+	{
+		{
+			WorkerQueue& own = *queues[queueIndex];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.jobs.empty())
+			{
+				job = std::move(own.jobs.back());
+				own.jobs.pop_back();
+				queuedCount.fetch_sub(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+
+		// the oldest job of another deque is the one its owner is least likely to touch soon
+		for (size_t offset = 1; offset < queues.size(); offset++)
+		{
+			WorkerQueue& victim = *queues[(queueIndex + offset) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty())
+			{
+				job = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				queuedCount.fetch_sub(1, std::memory_order_relaxed);
+				queues[queueIndex]->stealCount.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool OegJobSystem::takeBackgroundJob(Job& job)
+	{
+		std::lock_guard<std::mutex> lock(backgroundMutex);
+		if (backgroundJobs.empty())
+		{
+			return false;
+		}
+		job = std::move(backgroundJobs.front());
+		backgroundJobs.pop_front();
+		queuedCount.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool OegJobSystem::takeMainThreadJob(Job& job)
+	{
+		std::lock_guard<std::mutex> lock(mainThreadMutex);
+		if (mainThreadJobs.empty())
+		{
+			return false;
+		}
+		job = std::move(mainThreadJobs.front());
+		mainThreadJobs.pop_front();
+		return true;
+	}
+
+	void OegJobSystem::run(Job& job, uint32_t queueIndex)
+	{
+		const auto startTime = std::chrono::steady_clock::now();
+		jobDepth++;
+		try
+		{
+			OEG_TRACE_ZONE("job");
+			job.function();
+		}
+		catch (...)
+		{
+			if (!job.counter)
+			{
+				logUnhandled(std::current_exception());
+			}
+			else
+			{
+				std::lock_guard<std::mutex> lock(job.counter->mutex);
+				if (!job.counter->exception)
+				{
+					job.counter->exception = std::current_exception();
+				}
+			}
+		}
+		jobDepth--;
+
+		WorkerQueue& queue = *queues[queueIndex];
+		queue.jobCount.fetch_add(1, std::memory_order_relaxed);
+		if (jobDepth == 0)
+		{
+			const auto endTime = std::chrono::steady_clock::now();
+			queue.busyNanoseconds.fetch_add(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count(),
+				std::memory_order_relaxed);
+		}
+
+		finish(job.counter);
+	}
+
+	void OegJobSystem::finish(JobCounter* counter)
+	{
+		if (!counter)
+		{
+			return;
+		}
+
+		std::vector<Job> ready;
+		{
+			std::lock_guard<std::mutex> lock(counter->mutex);
+			if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				ready.swap(counter->continuations);
+			}
+		}
+		for (Job& job : ready)
+		{
+			push(std::move(job));
+		}
+	}
+
+	void OegJobSystem::wakeWorker()
+	{
+		// taking the lock orders this against a worker that has checked the queues but not started waiting
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		sleepCondition.notify_one();
+	}
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace oeg
+{
+	class JobCounter;
+
+	struct Job
+	{
+		std::function<void()> function;
+		// decremented once the job has run, may be null
+		JobCounter* counter{nullptr};
+	};
+
+	/**
+	 * Number of unfinished jobs scheduled against it. Waiting on a counter is how a thread joins its
+	 * jobs, scheduling after a counter is how a job depends on others. The first exception thrown by one
+	 * of its jobs is rethrown by the wait.
+	 */
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class OegJobSystem;
+
+		std::atomic<uint32_t> pending{0};
+		// held for the last decrement, so a waiter that takes it afterwards may destroy the counter
+		std::mutex mutex;
+		// jobs scheduled after this counter, started once it reaches zero
+		std::vector<Job> continuations;
+		std::exception_ptr exception;
+	};
+
+	struct JobWorkerStats
+	{
+		uint32_t jobCount{0};
+		uint32_t stealCount{0};
+		// share of the time since the previous sample spent running jobs
+		float utilization{0.0f};
+	};
+
+	/**
+	 * Engine wide work stealing scheduler. Every worker thread owns a deque, it pushes and pops its own
+	 * jobs at the back and steals from the front of the others when it runs dry, so related work stays
+	 * on one core until another core is idle. Threads that are not workers, the main thread among them,
+	 * share deque 0 and run jobs while they wait on a counter instead of blocking.
+	 *
+	 * Long running work such as pipeline compiles goes to the background queue, which only idle workers
+	 * take, so it never stalls a wait inside a frame. Jobs pinned to the main thread, for GLFW calls,
+	 * run in runMainThreadJobs.
+	 *
+	 * An exception thrown by a job is handed to the wait on its counter, one without a counter is logged.
+	 *
+	 * There is one job system per process, created by the engine before anything that schedules jobs.
+	 */
+	class OegJobSystem
+	{
+	public:
+		// parallelFor splits into this many chunks per thread so stealing can even out uneven ranges
+		static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+		// one worker per core besides the main thread, but at least one so background jobs make progress
+		static uint32_t defaultWorkerCount();
+
+		explicit OegJobSystem(uint32_t workerCount = defaultWorkerCount());
+		// runs the jobs that are still queued, then joins the workers
+		~OegJobSystem();
+
+		OegJobSystem(const OegJobSystem&) = delete;
+		OegJobSystem& operator=(const OegJobSystem&) = delete;
+
+		static OegJobSystem& get();
+
+		void schedule(std::function<void()> function, JobCounter* counter = nullptr);
+		// function runs once dependency reaches zero, counter counts it as pending from now on
+		void scheduleAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr);
+		// for work that may take longer than a frame, never picked up by a waiting thread
+		void scheduleBackground(std::function<void()> function, JobCounter* counter = nullptr);
+		// for calls that are only allowed on the main thread, like most of GLFW
+		void scheduleOnMainThread(std::function<void()> function, JobCounter* counter = nullptr);
+
+		// call once per frame from the main thread
+		void runMainThreadJobs();
+
+		// runs other jobs until counter reaches zero, then rethrows the first exception of its jobs
+		void wait(JobCounter& counter);
+
+		/**
+		 * \brief Calls func(begin, end) over disjoint ranges covering [0, count), in chunks of at least
+		 * grainSize. The calling thread takes a chunk itself and returns when all of them are done
+		 */
+		template <typename Func>
+		void parallelFor(size_t count, size_t grainSize, Func&& func)
+		{
+			const size_t threadCount = getThreadCount();
+			if (count <= grainSize || threadCount == 1)
+			{
+				func(size_t{0}, count);
+				return;
+			}
+
+			const size_t chunkCount = threadCount * CHUNKS_PER_THREAD;
+			const size_t chunkSize = std::max(grainSize, (count + chunkCount - 1) / chunkCount);
+
+			JobCounter counter;
+			size_t begin = 0;
+			while (begin + chunkSize < count)
+			{
+				const size_t end = begin + chunkSize;
+				schedule([&func, begin, end]
+				{
+					func(begin, end);
+				}, &counter);
+				begin = end;
+			}
+
+			// the scheduled chunks reference func and counter, so they have to finish before anything leaves
+			std::exception_ptr exception;
+			try
+			{
+				func(begin, count);
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+			wait(counter);
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+		}
+
+		// workers plus the calling thread
+		size_t getThreadCount() const { return workers.size() + 1; }
+		bool isMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+
+		/**
+		 * \brief Per deque since the previous call, index 0 is the main thread and any other thread that is
+		 * not a worker, 1 and up are the workers
+		 */
+		std::vector<JobWorkerStats> sampleStats();
+
+	private:
+		struct alignas(64) WorkerQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+
+			std::atomic<uint64_t> busyNanoseconds{0};
+			std::atomic<uint32_t> jobCount{0};
+			std::atomic<uint32_t> stealCount{0};
+
+			// only touched by sampleStats
+			uint64_t sampledBusyNanoseconds{0};
+			uint32_t sampledJobCount{0};
+			uint32_t sampledStealCount{0};
+		};
+
+		void workerLoop(uint32_t queueIndex);
+		void push(Job job);
+		// own deque first, then the others in turn
+		bool takeJob(uint32_t queueIndex, Job& job);
+		bool takeBackgroundJob(Job& job);
+		bool takeMainThreadJob(Job& job);
+		void run(Job& job, uint32_t queueIndex);
+		void finish(JobCounter* counter);
+		void wakeWorker();
+
+		// queues[0] is shared by every thread that is not a worker
+		std::vector<std::unique_ptr<WorkerQueue>> queues;
+		std::vector<std::thread> workers;
+		std::thread::id mainThreadId;
+
+		std::mutex backgroundMutex;
+		std::deque<Job> backgroundJobs;
+		std::mutex mainThreadMutex;
+		std::deque<Job> mainThreadJobs;
+
+		// jobs in the deques and the background queue, workers sleep while it is zero
+		std::atomic<uint32_t> queuedCount{0};
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		bool stopping{false};
+
+		std::chrono::steady_clock::time_point lastSampleTime;
+	};
+}
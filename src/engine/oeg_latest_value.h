@@ -0,0 +1,34 @@
+#pragma once
+
+// std
+#include <mutex>
+
+namespace oeg
+{
+	/**
+	 * The newest value one thread has published, for another thread that reads it at the last moment
+	 * instead of waiting for it to arrive in order like OegSnapshotBuffer. Values that are replaced
+	 * before anyone reads them are lost, which is the point.
+	 */
+	template <typename Value>
+	class OegLatestValue
+	{
+	public:
+		void publish(const Value& value)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			latest = value;
+		}
+
+		// default constructed until the first publish
+		Value read() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return latest;
+		}
+
+	private:
+		mutable std::mutex mutex;
+		Value latest{};
+	};
+}
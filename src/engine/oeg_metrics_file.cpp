@@ -0,0 +1,84 @@
+#include "oeg_metrics_file.h"
+#include "oeg_job_system.h"
+
+// std
+#include <charconv>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace oeg
+{
+	OegMetricsFile::OegMetricsFile(std::string filepath)
+		: filepath{std::move(filepath)}
+	{
+	}
+
+	void OegMetricsFile::set(const char* name, double value, const char* help)
+	{
+		for (Metric& metric : metrics)
+		{
+			if (std::string_view(metric.name) == name)
+			{
+				metric.value = value;
+				return;
+			}
+		}
+		metrics.push_back(Metric{name, help, value});
+	}
+
+	void OegMetricsFile::write()
+	{
+		if (writing->exchange(true))
+		{
+			return;
+		}
+
+		// a slow disk would stall the frame that writes
+		OegJobSystem::get().scheduleBackground([filepath = filepath, metrics = metrics, writing = writing]
+		{
+			try
+			{
+				writeFile(filepath, metrics);
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << e.what() << "\n";
+			}
+			writing->store(false);
+		});
+	}
+
+	void OegMetricsFile::writeFile(const std::string& filepath, const std::vector<Metric>& metrics)
+	{
+		const std::string temporaryPath = filepath + ".tmp";
+		{
+			std::ofstream file{temporaryPath};
+			if (!file.is_open())
+			{
+				throw std::runtime_error("failed to write metrics: " + temporaryPath);
+			}
+
+			for (const Metric& metric : metrics)
+			{
+				// shortest text that reads back as the same double, counts come out without a fraction
+				char value[32];
+				const std::to_chars_result result = std::to_chars(value, value + sizeof(value), metric.value);
+				file << "# HELP " << metric.name << " " << metric.help << "\n"
+					<< "# TYPE " << metric.name << " gauge\n"
+					<< metric.name << " " << std::string_view(value, result.ptr - value) << "\n";
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, filepath, error);
+		if (error)
+		{
+			throw std::runtime_error("failed to replace metrics: " + filepath + ": " + error.message());
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * Plain text file of the engine's current numbers for monitoring to scrape, in the Prometheus text
+	 * format so a node exporter's textfile collector can read it as it is. Every metric is a gauge with
+	 * the value it was last set to.
+	 *
+	 * Writes go to a temporary file that is renamed over the old one, a reader never sees half a file.
+	 */
+	class OegMetricsFile
+	{
+	public:
+		explicit OegMetricsFile(std::string filepath);
+
+		OegMetricsFile(const OegMetricsFile&) = delete;
+		OegMetricsFile& operator=(const OegMetricsFile&) = delete;
+
+		// name and help have to be literals, name in snake case
+		void set(const char* name, double value, const char* help);
+
+		// writes every metric set so far on a background job, skipped while the previous write still runs
+		void write();
+
+		const std::string& getFilepath() const { return filepath; }
+
+	private:
+		struct Metric
+		{
+			const char* name;
+			const char* help;
+			double value;
+		};
+
+		static void writeFile(const std::string& filepath, const std::vector<Metric>& metrics);
+
+		std::string filepath;
+		std::vector<Metric> metrics;
+		// shared with the write job, which can outlive the file object
+		std::shared_ptr<std::atomic<bool>> writing{std::make_shared<std::atomic<bool>>(false)};
+	};
+}
@@ -1,5 +1,7 @@
 #include "oeg_model.h"
 #include "oeg_utils.h"
+#include "oeg_job_system.h"
+#include "oeg_trace.h"
 
 // libs
 #define FMT_HEADER_ONLY
@@ -11,6 +13,7 @@
 
 #include <cassert>
 #include <unordered_map>
+#include <vector>
 
 namespace std
 {
@@ -29,8 +32,11 @@ namespace std
 namespace oeg
 {
 	OegModel::OegModel(OegDevice& device, const Builder& builder)
-		: oegDevice(device)
+		: oegDevice(device), boundingBox{builder.boundingBox}, boundingSphere{builder.boundingSphere}
 	{
+		static idType currentID = 0;
+		id = currentID++;
+
 		createVertexBuffer(builder.vertices);
 		createIndexBuffer(builder.indices);
 	}
@@ -45,6 +51,19 @@ namespace oeg
 		return std::make_unique<OegModel>(device, builder);
 	}
 
+	std::vector<std::unique_ptr<OegModel>> OegModel::createShapeModelsFromFile(OegDevice& device, const std::string& filepath)
+	{
+		std::vector<std::unique_ptr<OegModel>> models;
+		for (const Builder& builder : Builder::loadShapes(filepath))
+		{
+			// vertex and index buffers go through a staging copy each
+			OEG_TRACE_ZONE("uploadShape");
+			models.push_back(std::make_unique<OegModel>(device, builder));
+		}
+		fmt::print("Shape Count: {}\n", models.size());
+		return models;
+	}
+
 	void OegModel::createVertexBuffer(const std::vector<Vertex>& vertices)
 	{
 		vertexCount = static_cast<uint32_t>(vertices.size());
@@ -123,27 +142,27 @@ namespace oeg
 		oegDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
 	}
 
-	void OegModel::draw(VkCommandBuffer commandBuffer)
+	void OegModel::draw(OegCommandRecorder& recorder, uint32_t firstInstance)
 	{
 		if (hasIndexBuffer)
 		{
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			recorder.drawIndexed(indexCount, 1, 0, 0, firstInstance);
 		}
 		else
 		{
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			recorder.draw(vertexCount, 1, 0, firstInstance);
 		}
 	}
 
-	void OegModel::bind(VkCommandBuffer commandBuffer)
+	void OegModel::bind(OegCommandRecorder& recorder)
 	{
 		VkBuffer buffers[] = {vertexBuffer->getBuffer()};
 		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		recorder.bindVertexBuffers(0, 1, buffers, offsets);
 
 		if (hasIndexBuffer)
 		{
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			recorder.bindIndexBuffer(indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 		}
 	}
 
@@ -214,6 +233,80 @@ namespace oeg
 				indices.push_back(uniqueVertexMap[vertex]);
 			}
 		}
+
+		computeBounds();
+	}
+
+	std::vector<OegModel::Builder> OegModel::Builder::loadShapes(const std::string& filepath)
+	{
+		OEG_TRACE_ZONE("loadShapes");
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		if (!LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str()))
+		{
+			throw std::runtime_error(warn + err);
+		}
+
+		// models need at least one triangle
+		std::erase_if(shapes, [](const tinyobj::shape_t& shape) { return shape.mesh.indices.size() < 3; });
+
+		// shapes are independent, each job deduplicates the vertices of one
+		std::vector<Builder> builders(shapes.size());
+		OegJobSystem::get().parallelFor(shapes.size(), 1, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Builder& builder = builders[i];
+				std::unordered_map<Vertex, uint32_t> uniqueVertexMap;
+				for (const auto& index : shapes[i].mesh.indices)
+				{
+					Vertex vertex = createVertexFromIndex(attrib, index);
+					if (!uniqueVertexMap.contains(vertex))
+					{
+						uniqueVertexMap[vertex] = static_cast<uint32_t>(builder.vertices.size());
+						builder.vertices.push_back(vertex);
+					}
+					builder.indices.push_back(uniqueVertexMap[vertex]);
+				}
+				builder.computeBounds();
+			}
+		});
+		return builders;
+	}
+
+	/**
+		* Computes the axis aligned box and a bounding sphere around the loaded vertices. The sphere
+		* is centered on the box, which is cheap and tight enough for culling.
+	*/
+	void OegModel::Builder::computeBounds()
+	{
+		if (vertices.empty())
+		{
+			boundingBox = {};
+			boundingSphere = {};
+			return;
+		}
+
+		boundingBox.min = vertices[0].position;
+		boundingBox.max = vertices[0].position;
+		for (const auto& vertex : vertices)
+		{
+			boundingBox.min = glm::min(boundingBox.min, vertex.position);
+			boundingBox.max = glm::max(boundingBox.max, vertex.position);
+		}
+
+		boundingSphere.center = boundingBox.center();
+
+		float maxDistanceSquared = 0.0f;
+		for (const auto& vertex : vertices)
+		{
+			const glm::vec3 offset = vertex.position - boundingSphere.center;
+			maxDistanceSquared = glm::max(maxDistanceSquared, dot(offset, offset));
+		}
+		boundingSphere.radius = glm::sqrt(maxDistanceSquared);
 	}
 
 	Vertex OegModel::Builder::createVertexFromIndex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
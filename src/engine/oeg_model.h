@@ -2,6 +2,7 @@
 
 // myshit
 #include "oeg_buffer.h"
+#include "oeg_command_recorder.h"
 #include "oeg_device.h"
 
 // glm
@@ -30,16 +31,39 @@ namespace oeg
 		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
 	};
 
+	// Model space bounds, used to cull objects before they are drawn
+	struct BoundingSphere
+	{
+		glm::vec3 center{0.0f};
+		float radius{0.0f};
+	};
+
+	struct BoundingBox
+	{
+		glm::vec3 min{0.0f};
+		glm::vec3 max{0.0f};
+
+		glm::vec3 center() const { return (min + max) * 0.5f; }
+		glm::vec3 extent() const { return (max - min) * 0.5f; }
+	};
+
 	class OegModel
 	{
 	public:
+		using idType = uint32_t;
+
 		class Builder
 		{
 		public:
 			std::vector<Vertex> vertices;
 			std::vector<uint32_t> indices;
+			BoundingBox boundingBox{};
+			BoundingSphere boundingSphere{};
 
 			void loadModel(const std::string& filepath);
+			// one builder per shape (OBJ "o" and "g"), for files that describe an assembly of parts
+			static std::vector<Builder> loadShapes(const std::string& filepath);
+			void computeBounds();
 
 		private:
 			static Vertex createVertexFromIndex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index);
@@ -53,19 +77,33 @@ namespace oeg
 		OegModel& operator=(const OegModel&) = delete;
 
 		static std::unique_ptr<OegModel> createModelFromFile(OegDevice& device, const std::string& filepath);
-		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		static std::vector<std::unique_ptr<OegModel>> createShapeModelsFromFile(OegDevice& device, const std::string& filepath);
+		void bind(OegCommandRecorder& recorder);
+		// firstInstance reaches the shader as gl_InstanceIndex
+		void draw(OegCommandRecorder& recorder, uint32_t firstInstance = 0);
+
+		// unique per model, used to group draws of the same model
+		idType getId() const { return id; }
+		bool hasIndices() const { return hasIndexBuffer; }
+		uint32_t getIndexCount() const { return indexCount; }
+		uint32_t getVertexCount() const { return vertexCount; }
+		const BoundingBox& getBoundingBox() const { return boundingBox; }
+		const BoundingSphere& getBoundingSphere() const { return boundingSphere; }
 
 	private:
 		void createVertexBuffer(const std::vector<Vertex>& vertices);
 		void createIndexBuffer(const std::vector<uint32_t>& indices);
 
 		OegDevice& oegDevice;
+		idType id;
 		std::unique_ptr<OegBuffer> vertexBuffer;
 		uint32_t vertexCount;
 
 		bool hasIndexBuffer;
 		std::unique_ptr<OegBuffer> indexBuffer;
 		uint32_t indexCount;
+
+		BoundingBox boundingBox;
+		BoundingSphere boundingSphere;
 	};
 }
@@ -1,6 +1,7 @@
 #include "oeg_pipeline.h"
 #include "oeg_model.h"
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -11,17 +12,43 @@ namespace oeg
 	OegPipeline::OegPipeline(OegDevice& device,
 	                         const std::string& vertFilepath,
 	                         const std::string& fragFilepath,
-	                         const PipelineConfigInfo& configInfo)
-		: oegDevice{device}
+	                         const PipelineConfigInfo& configInfo,
+	                         const SpecializationConstants& specialization)
+		: OegPipeline{
+			device,
+			OegShaderModule::createFromFile(device, vertFilepath),
+			OegShaderModule::createFromFile(device, fragFilepath),
+			configInfo,
+			specialization
+		}
+	{
+	}
+
+	OegPipeline::OegPipeline(OegDevice& device,
+	                         std::shared_ptr<OegShaderModule> vertShader,
+	                         std::shared_ptr<OegShaderModule> fragShader,
+	                         const PipelineConfigInfo& configInfo,
+	                         const SpecializationConstants& specialization)
+		: oegDevice{device}, vertShaderModule{std::move(vertShader)}, fragShaderModule{std::move(fragShader)}
+	{
+		createGraphicsPipeline(configInfo, specialization);
+	}
+
+	OegPipeline::OegPipeline(OegDevice& device,
+	                         OegPipelineLibrary& library,
+	                         std::shared_ptr<OegShaderModule> vertShader,
+	                         std::shared_ptr<OegShaderModule> fragShader,
+	                         const PipelineConfigInfo& configInfo,
+	                         const SpecializationConstants& specialization,
+	                         PipelineLinkMode linkMode)
+		: oegDevice{device}, vertShaderModule{std::move(vertShader)}, fragShaderModule{std::move(fragShader)}
 	{
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+		graphicsPipeline = library.link(*vertShaderModule, *fragShaderModule, configInfo, specialization, linkMode);
 	}
 
-	// CLEAR *shocks*
+	// CLEAR *shocks*, the shader modules go with their last pipeline
 	OegPipeline::~OegPipeline()
 	{
-		vkDestroyShaderModule(oegDevice.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(oegDevice.device(), fragShaderModule, nullptr);
 		vkDestroyPipeline(oegDevice.device(), graphicsPipeline, nullptr);
 	}
 
@@ -45,9 +72,8 @@ namespace oeg
 	}
 
 	void OegPipeline::createGraphicsPipeline(
-		const std::string& vertFilepath,
-		const std::string& fragFilepath,
-		const PipelineConfigInfo& configInfo)
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization)
 	{
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -56,11 +82,8 @@ namespace oeg
 			configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline:: no renderPass provided in configInfo");
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+		const VkSpecializationInfo specializationInfo = specialization.info();
+		const VkSpecializationInfo* pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
 
 		// vertex
 		VkPipelineShaderStageCreateInfo shaderStages[2];
@@ -68,17 +91,17 @@ namespace oeg
 		shaderStages[0].pNext = nullptr;
 		shaderStages[0].flags = 0;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = vertShaderModule->getModule();
 		shaderStages[0].pName = "main";
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 		// frag
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].pNext = nullptr;
 		shaderStages[1].flags = 0;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = fragShaderModule->getModule();
 		shaderStages[1].pName = "main";
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 		const auto bindingDescriptions = Vertex::getBindingDescriptions();
 		const auto attributeDescriptions = Vertex::getAttributeDescriptions();
@@ -112,8 +135,10 @@ namespace oeg
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+		OegPipelineCache& pipelineCache = oegDevice.getPipelineCache();
+		const auto startTime = std::chrono::high_resolution_clock::now();
 		if (vkCreateGraphicsPipelines(oegDevice.device(),
-		                              VK_NULL_HANDLE,
+		                              pipelineCache.getCache(),
 		                              1,
 		                              &pipelineInfo,
 		                              nullptr,
@@ -121,24 +146,12 @@ namespace oeg
 		{
 			throw std::runtime_error("failed to create graphics pipeline WOW AMAZING");
 		}
+		pipelineCache.recordPipelineCreation(std::chrono::high_resolution_clock::now() - startTime);
 	}
 
-	void OegPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
+	void OegPipeline::bind(OegCommandRecorder& recorder)
 	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(oegDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
-		{
-			throw std::runtime_error("Failed to create shader module.");
-		}
-	}
-
-	void OegPipeline::bind(VkCommandBuffer commandBuffer)
-	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 	}
 
 	void OegPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
@@ -212,4 +225,55 @@ namespace oeg
 			static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
 	}
+
+	OegComputePipeline::OegComputePipeline(OegDevice& device,
+	                                       const std::string& compFilepath,
+	                                       VkPipelineLayout pipelineLayout)
+		: oegDevice{device}
+	{
+		createComputePipeline(compFilepath, pipelineLayout);
+	}
+
+	OegComputePipeline::~OegComputePipeline()
+	{
+		vkDestroyPipeline(oegDevice.device(), computePipeline, nullptr);
+	}
+
+	void OegComputePipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline:: no pipelineLayout provided");
+
+		compShaderModule = OegShaderModule::createFromFile(oegDevice, compFilepath);
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = compShaderModule->getModule();
+		shaderStage.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStage;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		OegPipelineCache& pipelineCache = oegDevice.getPipelineCache();
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		if (vkCreateComputePipelines(oegDevice.device(),
+		                             pipelineCache.getCache(),
+		                             1,
+		                             &pipelineInfo,
+		                             nullptr,
+		                             &computePipeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create compute pipeline");
+		}
+		pipelineCache.recordPipelineCreation(std::chrono::high_resolution_clock::now() - startTime);
+	}
+
+	void OegComputePipeline::bind(OegCommandRecorder& recorder)
+	{
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
 }
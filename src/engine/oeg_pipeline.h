@@ -1,8 +1,13 @@
 #pragma once
 
+#include "oeg_command_recorder.h"
 #include "oeg_device.h"
+#include "oeg_pipeline_library.h"
+#include "oeg_shader_module.h"
 
 // std
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -24,6 +29,33 @@ namespace oeg
 		uint32_t subpass = 0;
 	};
 
+	/**
+	 * Values for the shader's specialization constants (layout(constant_id = N) const ...), the same
+	 * set is applied to every stage and ids a stage does not declare are ignored by it.
+	 */
+	struct SpecializationConstants
+	{
+		std::vector<VkSpecializationMapEntry> entries;
+		std::vector<uint8_t> data;
+
+		template <typename T>
+		void set(uint32_t constantId, const T& value)
+		{
+			const auto offset = static_cast<uint32_t>(data.size());
+			entries.push_back({constantId, offset, sizeof(T)});
+			data.resize(data.size() + sizeof(T));
+			std::memcpy(data.data() + offset, &value, sizeof(T));
+		}
+
+		bool empty() const { return entries.empty(); }
+
+		// points into this object, which has to outlive the pipeline creation
+		VkSpecializationInfo info() const
+		{
+			return {static_cast<uint32_t>(entries.size()), entries.data(), data.size(), data.data()};
+		}
+	};
+
 	class OegPipeline
 	{
 	public:
@@ -31,32 +63,65 @@ namespace oeg
 			OegDevice& device,
 			const std::string& vertFilepath,
 			const std::string& fragFilepath,
-			const PipelineConfigInfo& configInfo);
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization = {});
+		// shares already loaded modules, see OegPipelineManager
+		OegPipeline(
+			OegDevice& device,
+			std::shared_ptr<OegShaderModule> vertShader,
+			std::shared_ptr<OegShaderModule> fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization = {});
+		// links the pipeline from cached library parts instead of compiling it in one piece
+		OegPipeline(
+			OegDevice& device,
+			OegPipelineLibrary& library,
+			std::shared_ptr<OegShaderModule> vertShader,
+			std::shared_ptr<OegShaderModule> fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization,
+			PipelineLinkMode linkMode);
 		// destructor
 		~OegPipeline(); // i guess?
 
 		OegPipeline(const OegPipeline&) = delete;
 		OegPipeline& operator=(const OegPipeline&) = delete;
 
-		void bind(VkCommandBuffer commandBuffer);
+		void bind(OegCommandRecorder& recorder);
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
-	private:
 		static std::vector<char> readFile(const std::string& filepath);
 
-		void createGraphicsPipeline(
-			const std::string& vertFilepath,
-			const std::string& fragFilepath,
-			const PipelineConfigInfo& configInfo);
+	private:
+		void createGraphicsPipeline(const PipelineConfigInfo& configInfo, const SpecializationConstants& specialization);
 
-		// takes in shader code in a form of a vector. pointer to a shader module,
-		// used to create the module and initialize the variable
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* VkShaderModule);
 		// an implicit will outlive the class that depends on it (aggregation)
 		OegDevice& oegDevice;
 		VkPipeline graphicsPipeline{};
-		VkShaderModule vertShaderModule{};
-		VkShaderModule fragShaderModule{};
+		std::shared_ptr<OegShaderModule> vertShaderModule;
+		std::shared_ptr<OegShaderModule> fragShaderModule;
+	};
+
+	class OegComputePipeline
+	{
+	public:
+		OegComputePipeline(
+			OegDevice& device,
+			const std::string& compFilepath,
+			VkPipelineLayout pipelineLayout);
+		~OegComputePipeline();
+
+		OegComputePipeline(const OegComputePipeline&) = delete;
+		OegComputePipeline& operator=(const OegComputePipeline&) = delete;
+
+		void bind(OegCommandRecorder& recorder);
+
+	private:
+		void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
+		OegDevice& oegDevice;
+		VkPipeline computePipeline{};
+		std::shared_ptr<OegShaderModule> compShaderModule;
 	};
 }
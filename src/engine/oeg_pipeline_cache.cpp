@@ -0,0 +1,124 @@
+#include "oeg_pipeline_cache.h"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace oeg
+{
+	OegPipelineCache::OegPipelineCache(
+		VkDevice device,
+		const VkPhysicalDeviceProperties& properties,
+		std::string filepath)
+		: device{device}, properties{properties}, filepath{std::move(filepath)}
+	{
+		std::vector<char> data;
+		std::ifstream file{this->filepath, std::ios::ate | std::ios::binary};
+		if (file.is_open())
+		{
+			data.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(data.data(), static_cast<std::streamsize>(data.size()));
+		}
+
+		warm = isCompatible(data);
+		if (!warm && !data.empty())
+		{
+			std::cout << "pipeline cache: " << this->filepath << " was written by another device or driver, ignoring it"
+				<< std::endl;
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = warm ? data.size() : 0;
+		cacheInfo.pInitialData = warm ? data.data() : nullptr;
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &cache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+		loadedSize = cacheInfo.initialDataSize;
+	}
+
+	OegPipelineCache::~OegPipelineCache()
+	{
+		save();
+		vkDestroyPipelineCache(device, cache, nullptr);
+	}
+
+	/**
+		* The driver would reject foreign data itself, but checking the header first lets a cold
+		* start be reported as one instead of silently running with an empty cache.
+	*/
+	bool OegPipelineCache::isCompatible(const std::vector<char>& data) const
+	{
+		if (data.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+		{
+			return false;
+		}
+
+		VkPipelineCacheHeaderVersionOne header{};
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+			header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	void OegPipelineCache::recordPipelineCreation(std::chrono::nanoseconds duration)
+	{
+		pipelineCount.fetch_add(1, std::memory_order_relaxed);
+		creationTimeNs.fetch_add(duration.count(), std::memory_order_relaxed);
+	}
+
+	void OegPipelineCache::logStartupTimings() const
+	{
+		const double creationTimeMs = static_cast<double>(creationTimeNs.load()) / 1.0e6;
+		std::cout << "pipeline cache: " << (warm ? "warm" : "cold") << " start (" << loadedSize << " bytes loaded), "
+			<< pipelineCount.load() << " pipelines created in " << creationTimeMs << " ms" << std::endl;
+	}
+
+	void OegPipelineCache::save() const
+	{
+		size_t size = 0;
+		if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0)
+		{
+			return;
+		}
+
+		std::vector<char> data(size);
+		if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS)
+		{
+			return;
+		}
+
+		const std::string tempFilepath = filepath + ".tmp";
+		{
+			std::ofstream file{tempFilepath, std::ios::binary | std::ios::trunc};
+			if (!file.is_open())
+			{
+				std::cerr << "pipeline cache: failed to open " << tempFilepath << " for writing" << std::endl;
+				return;
+			}
+			file.write(data.data(), static_cast<std::streamsize>(size));
+			if (!file)
+			{
+				std::cerr << "pipeline cache: failed to write " << tempFilepath << std::endl;
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempFilepath, filepath, error);
+		if (error)
+		{
+			std::cerr << "pipeline cache: failed to replace " << filepath << ": " << error.message() << std::endl;
+			std::filesystem::remove(tempFilepath, error);
+		}
+	}
+}
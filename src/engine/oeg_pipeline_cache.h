@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * VkPipelineCache that is loaded from disk on startup and written back on shutdown, so pipelines
+	 * compiled by an earlier run come back from the driver cache instead of being compiled again.
+	 * Cache data from a different vendor, device or driver is discarded.
+	 */
+	class OegPipelineCache
+	{
+	public:
+		OegPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string filepath);
+		// saves the cache before destroying it
+		~OegPipelineCache();
+
+		OegPipelineCache(const OegPipelineCache&) = delete;
+		OegPipelineCache& operator=(const OegPipelineCache&) = delete;
+
+		VkPipelineCache getCache() const { return cache; }
+
+		// true when valid data from an earlier run was loaded
+		bool isWarm() const { return warm; }
+
+		// thread safe, pipelines may be created from worker threads
+		void recordPipelineCreation(std::chrono::nanoseconds duration);
+
+		// prints how long pipeline creation took so far, so cold and warm starts can be compared
+		void logStartupTimings() const;
+
+		// writes to a temporary file and renames it over the old one, a crash never leaves a torn file
+		void save() const;
+
+	private:
+		bool isCompatible(const std::vector<char>& data) const;
+
+		VkDevice device;
+		VkPhysicalDeviceProperties properties;
+		std::string filepath;
+
+		VkPipelineCache cache{VK_NULL_HANDLE};
+		bool warm{false};
+		size_t loadedSize{0};
+
+		std::atomic<uint32_t> pipelineCount{0};
+		std::atomic<int64_t> creationTimeNs{0};
+	};
+}
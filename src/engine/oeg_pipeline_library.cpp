@@ -0,0 +1,378 @@
+#include "oeg_pipeline_library.h"
+
+#include "oeg_model.h"
+#include "oeg_pipeline.h"
+
+// std
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+
+namespace oeg
+{
+	namespace
+	{
+		// field by field, so padding and pNext pointers never end up in a key
+		template <typename T>
+		void append(std::string& key, const T& value)
+		{
+			key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		void appendDynamicState(std::string& key, const PipelineConfigInfo& configInfo)
+		{
+			for (VkDynamicState dynamicState : configInfo.dynamicStateEnables)
+			{
+				append(key, dynamicState);
+			}
+		}
+
+		void appendMultisampleState(std::string& key, const PipelineConfigInfo& configInfo)
+		{
+			const auto& multisample = configInfo.multisampleInfo;
+			append(key, multisample.rasterizationSamples);
+			append(key, multisample.sampleShadingEnable);
+			append(key, multisample.minSampleShading);
+			append(key, multisample.alphaToCoverageEnable);
+			append(key, multisample.alphaToOneEnable);
+		}
+
+		// the render pass is keyed by handle, a recreated but compatible render pass still gets its own parts
+		void appendRenderPass(std::string& key, const PipelineConfigInfo& configInfo)
+		{
+			append(key, configInfo.renderPass);
+			append(key, configInfo.subpass);
+		}
+	}
+
+	std::string vertexInputStateKey(const PipelineConfigInfo& configInfo)
+	{
+		std::string key;
+		for (const auto& binding : Vertex::getBindingDescriptions())
+		{
+			append(key, binding.binding);
+			append(key, binding.stride);
+			append(key, binding.inputRate);
+		}
+		for (const auto& attribute : Vertex::getAttributeDescriptions())
+		{
+			append(key, attribute.location);
+			append(key, attribute.binding);
+			append(key, attribute.format);
+			append(key, attribute.offset);
+		}
+		append(key, configInfo.inputAssemblyInfo.topology);
+		append(key, configInfo.inputAssemblyInfo.primitiveRestartEnable);
+		appendDynamicState(key, configInfo);
+		return key;
+	}
+
+	std::string preRasterizationStateKey(const PipelineConfigInfo& configInfo)
+	{
+		std::string key;
+		append(key, configInfo.viewportInfo.viewportCount);
+		append(key, configInfo.viewportInfo.scissorCount);
+
+		const auto& raster = configInfo.rasterizationInfo;
+		append(key, raster.depthClampEnable);
+		append(key, raster.rasterizerDiscardEnable);
+		append(key, raster.polygonMode);
+		append(key, raster.cullMode);
+		append(key, raster.frontFace);
+		append(key, raster.depthBiasEnable);
+		append(key, raster.depthBiasConstantFactor);
+		append(key, raster.depthBiasClamp);
+		append(key, raster.depthBiasSlopeFactor);
+		append(key, raster.lineWidth);
+
+		appendDynamicState(key, configInfo);
+		append(key, configInfo.pipelineLayout);
+		appendRenderPass(key, configInfo);
+		return key;
+	}
+
+	std::string fragmentShaderStateKey(const PipelineConfigInfo& configInfo)
+	{
+		std::string key;
+		const auto& depth = configInfo.depthStencilInfo;
+		append(key, depth.depthTestEnable);
+		append(key, depth.depthWriteEnable);
+		append(key, depth.depthCompareOp);
+		append(key, depth.depthBoundsTestEnable);
+		append(key, depth.minDepthBounds);
+		append(key, depth.maxDepthBounds);
+		append(key, depth.stencilTestEnable);
+		for (const VkStencilOpState& stencil : {depth.front, depth.back})
+		{
+			append(key, stencil.failOp);
+			append(key, stencil.passOp);
+			append(key, stencil.depthFailOp);
+			append(key, stencil.compareOp);
+			append(key, stencil.compareMask);
+			append(key, stencil.writeMask);
+			append(key, stencil.reference);
+		}
+
+		appendMultisampleState(key, configInfo);
+		appendDynamicState(key, configInfo);
+		append(key, configInfo.pipelineLayout);
+		appendRenderPass(key, configInfo);
+		return key;
+	}
+
+	std::string fragmentOutputStateKey(const PipelineConfigInfo& configInfo)
+	{
+		std::string key;
+		const auto& blend = configInfo.colorBlendAttachment;
+		append(key, blend.blendEnable);
+		append(key, blend.srcColorBlendFactor);
+		append(key, blend.dstColorBlendFactor);
+		append(key, blend.colorBlendOp);
+		append(key, blend.srcAlphaBlendFactor);
+		append(key, blend.dstAlphaBlendFactor);
+		append(key, blend.alphaBlendOp);
+		append(key, blend.colorWriteMask);
+		append(key, configInfo.colorBlendInfo.logicOpEnable);
+		append(key, configInfo.colorBlendInfo.logicOp);
+		append(key, configInfo.colorBlendInfo.attachmentCount);
+		append(key, configInfo.colorBlendInfo.blendConstants);
+
+		appendMultisampleState(key, configInfo);
+		appendDynamicState(key, configInfo);
+		appendRenderPass(key, configInfo);
+		return key;
+	}
+
+	std::string specializationKey(const SpecializationConstants& specialization)
+	{
+		std::string key;
+		for (const auto& entry : specialization.entries)
+		{
+			append(key, entry.constantID);
+			append(key, entry.offset);
+			append(key, entry.size);
+		}
+		key.append(reinterpret_cast<const char*>(specialization.data.data()), specialization.data.size());
+		return key;
+	}
+
+	std::string shaderKey(const OegShaderModule& shader)
+	{
+		const std::vector<char>& code = shader.getCode();
+		std::string key;
+		append(key, code.size());
+		key.append(code.data(), code.size());
+		return key;
+	}
+
+	OegPipelineLibrary::OegPipelineLibrary(OegDevice& device) : oegDevice{device}
+	{
+	}
+
+	OegPipelineLibrary::~OegPipelineLibrary()
+	{
+		// linked pipelines do not reference their parts, so they may outlive the library
+		for (const auto& [key, part] : parts)
+		{
+			vkDestroyPipeline(oegDevice.device(), part, nullptr);
+		}
+	}
+
+	uint32_t OegPipelineLibrary::getPartCount()
+	{
+		std::lock_guard<std::mutex> lock{partsMutex};
+		return static_cast<uint32_t>(parts.size());
+	}
+
+	/**
+		* Part creation holds the lock, so two threads asking for the same part compile it once.
+		* Parts are small compared to a full pipeline, so serializing their creation costs little.
+	*/
+	VkPipeline OegPipelineLibrary::createPart(
+		VkGraphicsPipelineLibraryFlagsEXT part,
+		VkGraphicsPipelineCreateInfo pipelineInfo)
+	{
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.flags = part;
+
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = &libraryInfo;
+		// retained so the optimized link can still optimize across the parts
+		pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+			VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		OegPipelineCache& pipelineCache = oegDevice.getPipelineCache();
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(oegDevice.device(), pipelineCache.getCache(), 1, &pipelineInfo, nullptr, &pipeline) !=
+			VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create graphics pipeline library part!");
+		}
+		pipelineCache.recordPipelineCreation(std::chrono::high_resolution_clock::now() - startTime);
+		return pipeline;
+	}
+
+	VkPipeline OegPipelineLibrary::getVertexInputPart(const PipelineConfigInfo& configInfo)
+	{
+		const std::string key = "vi" + vertexInputStateKey(configInfo);
+		std::lock_guard<std::mutex> lock{partsMutex};
+		if (auto it = parts.find(key); it != parts.end())
+		{
+			return it->second;
+		}
+
+		const auto bindingDescriptions = Vertex::getBindingDescriptions();
+		const auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+
+		VkPipeline part = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, pipelineInfo);
+		parts.emplace(key, part);
+		return part;
+	}
+
+	VkPipeline OegPipelineLibrary::getPreRasterizationPart(
+		const OegShaderModule& vertShader,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization)
+	{
+		std::string key = "pr" + preRasterizationStateKey(configInfo) + specializationKey(specialization);
+		key += shaderKey(vertShader);
+		std::lock_guard<std::mutex> lock{partsMutex};
+		if (auto it = parts.find(key); it != parts.end())
+		{
+			return it->second;
+		}
+
+		const VkSpecializationInfo specializationInfo = specialization.info();
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStage.module = vertShader.getModule();
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.stageCount = 1;
+		pipelineInfo.pStages = &shaderStage;
+		pipelineInfo.pViewportState = &configInfo.viewportInfo;
+		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+		pipelineInfo.layout = configInfo.pipelineLayout;
+		pipelineInfo.renderPass = configInfo.renderPass;
+		pipelineInfo.subpass = configInfo.subpass;
+
+		VkPipeline part = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, pipelineInfo);
+		parts.emplace(key, part);
+		return part;
+	}
+
+	VkPipeline OegPipelineLibrary::getFragmentShaderPart(
+		const OegShaderModule& fragShader,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization)
+	{
+		std::string key = "fs" + fragmentShaderStateKey(configInfo) + specializationKey(specialization);
+		key += shaderKey(fragShader);
+		std::lock_guard<std::mutex> lock{partsMutex};
+		if (auto it = parts.find(key); it != parts.end())
+		{
+			return it->second;
+		}
+
+		const VkSpecializationInfo specializationInfo = specialization.info();
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStage.module = fragShader.getModule();
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.stageCount = 1;
+		pipelineInfo.pStages = &shaderStage;
+		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
+		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+		pipelineInfo.layout = configInfo.pipelineLayout;
+		pipelineInfo.renderPass = configInfo.renderPass;
+		pipelineInfo.subpass = configInfo.subpass;
+
+		VkPipeline part = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, pipelineInfo);
+		parts.emplace(key, part);
+		return part;
+	}
+
+	VkPipeline OegPipelineLibrary::getFragmentOutputPart(const PipelineConfigInfo& configInfo)
+	{
+		const std::string key = "fo" + fragmentOutputStateKey(configInfo);
+		std::lock_guard<std::mutex> lock{partsMutex};
+		if (auto it = parts.find(key); it != parts.end())
+		{
+			return it->second;
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
+		pipelineInfo.renderPass = configInfo.renderPass;
+		pipelineInfo.subpass = configInfo.subpass;
+
+		VkPipeline part = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, pipelineInfo);
+		parts.emplace(key, part);
+		return part;
+	}
+
+	VkPipeline OegPipelineLibrary::link(
+		const OegShaderModule& vertShader,
+		const OegShaderModule& fragShader,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization,
+		PipelineLinkMode mode)
+	{
+		const VkPipeline libraries[] = {
+			getVertexInputPart(configInfo),
+			getPreRasterizationPart(vertShader, configInfo, specialization),
+			getFragmentShaderPart(fragShader, configInfo, specialization),
+			getFragmentOutputPart(configInfo),
+		};
+
+		VkPipelineLibraryCreateInfoKHR linkInfo{};
+		linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+		linkInfo.libraryCount = static_cast<uint32_t>(std::size(libraries));
+		linkInfo.pLibraries = libraries;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = &linkInfo;
+		pipelineInfo.flags = mode == PipelineLinkMode::Optimized ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+		pipelineInfo.layout = configInfo.pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		OegPipelineCache& pipelineCache = oegDevice.getPipelineCache();
+		const auto startTime = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(oegDevice.device(), pipelineCache.getCache(), 1, &pipelineInfo, nullptr, &pipeline) !=
+			VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to link graphics pipeline!");
+		}
+		pipelineCache.recordPipelineCreation(std::chrono::high_resolution_clock::now() - startTime);
+		return pipeline;
+	}
+}
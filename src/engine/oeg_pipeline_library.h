@@ -0,0 +1,78 @@
+#pragma once
+
+#include "oeg_device.h"
+#include "oeg_shader_module.h"
+
+// std
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace oeg
+{
+	struct PipelineConfigInfo;
+	struct SpecializationConstants;
+
+	// canonical byte strings of the state each library part is built from, a full pipeline is keyed by all four
+	std::string vertexInputStateKey(const PipelineConfigInfo& configInfo);
+	std::string preRasterizationStateKey(const PipelineConfigInfo& configInfo);
+	std::string fragmentShaderStateKey(const PipelineConfigInfo& configInfo);
+	std::string fragmentOutputStateKey(const PipelineConfigInfo& configInfo);
+	std::string specializationKey(const SpecializationConstants& specialization);
+	// the whole SPIR-V, a hash alone could hand out a part or pipeline built from other code
+	std::string shaderKey(const OegShaderModule& shader);
+
+	enum class PipelineLinkMode
+	{
+		Fast, // links the parts as they are, takes microseconds
+		Optimized, // lets the driver optimize across the parts, as slow as a monolithic pipeline
+	};
+
+	/**
+	 * Builds graphics pipelines out of the four VK_EXT_graphics_pipeline_library parts: vertex input,
+	 * pre-rasterization, fragment shader and fragment output. Parts are cached by the state they are
+	 * built from, so a new variant usually only compiles the part that changed and links the rest.
+	 *
+	 * Only created when OegDevice::supportsGraphicsPipelineLibrary(). Thread safe, linking happens on
+	 * worker threads.
+	 */
+	class OegPipelineLibrary
+	{
+	public:
+		explicit OegPipelineLibrary(OegDevice& device);
+		~OegPipelineLibrary();
+
+		OegPipelineLibrary(const OegPipelineLibrary&) = delete;
+		OegPipelineLibrary& operator=(const OegPipelineLibrary&) = delete;
+
+		// the returned pipeline is owned by the caller, the parts stay cached
+		VkPipeline link(
+			const OegShaderModule& vertShader,
+			const OegShaderModule& fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization,
+			PipelineLinkMode mode);
+
+		uint32_t getPartCount();
+
+	private:
+		VkPipeline getVertexInputPart(const PipelineConfigInfo& configInfo);
+		VkPipeline getPreRasterizationPart(
+			const OegShaderModule& vertShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization);
+		VkPipeline getFragmentShaderPart(
+			const OegShaderModule& fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization);
+		VkPipeline getFragmentOutputPart(const PipelineConfigInfo& configInfo);
+
+		// creates a part with the library flags set, pipelineInfo carries only the state of that part
+		VkPipeline createPart(VkGraphicsPipelineLibraryFlagsEXT part, VkGraphicsPipelineCreateInfo pipelineInfo);
+
+		OegDevice& oegDevice;
+
+		std::mutex partsMutex;
+		std::unordered_map<std::string, VkPipeline> parts;
+	};
+}
@@ -0,0 +1,282 @@
+#include "oeg_pipeline_manager.h"
+
+// std
+#include <cassert>
+#include <iostream>
+
+namespace oeg
+{
+	namespace
+	{
+		// PipelineConfigInfo points into itself, a copy has to be pointed at its own members again
+		void fixConfigPointers(PipelineConfigInfo& configInfo)
+		{
+			configInfo.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+			configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+			configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+		}
+	}
+
+	OegPipelineManager::OegPipelineManager(OegDevice& device) : oegDevice{device}
+	{
+		if (oegDevice.supportsGraphicsPipelineLibrary())
+		{
+			pipelineLibrary = std::make_unique<OegPipelineLibrary>(oegDevice);
+		}
+	}
+
+	OegPipelineManager::~OegPipelineManager()
+	{
+		waitIdle();
+	}
+
+	void OegPipelineManager::waitIdle()
+	{
+		for (auto& entry : entries)
+		{
+			OegJobSystem::get().wait(entry->compilation);
+		}
+	}
+
+	std::string OegPipelineManager::makePipelineKey(
+		const OegShaderModule& vertShader,
+		const OegShaderModule& fragShader,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization) const
+	{
+		std::string key = shaderKey(vertShader);
+		key += shaderKey(fragShader);
+		key += vertexInputStateKey(configInfo);
+		key += preRasterizationStateKey(configInfo);
+		key += fragmentShaderStateKey(configInfo);
+		key += fragmentOutputStateKey(configInfo);
+		key += specializationKey(specialization);
+		return key;
+	}
+
+	std::shared_ptr<OegShaderModule> OegPipelineManager::acquireShaderModule(const std::string& filepath)
+	{
+		const std::vector<char> code = OegPipeline::readFile(filepath);
+		std::weak_ptr<OegShaderModule>& cached = shaderModules[OegShaderModule::hashCode(code)];
+
+		auto shaderModule = cached.lock();
+		if (shaderModule && shaderModule->getCode() == code)
+		{
+			sharedShaderModules++;
+			return shaderModule;
+		}
+
+		// a hash collision keeps the cached module, the other code gets a module of its own
+		const bool collision = shaderModule != nullptr;
+		shaderModule = std::make_shared<OegShaderModule>(oegDevice, code);
+		if (!collision)
+		{
+			cached = shaderModule;
+		}
+		return shaderModule;
+	}
+
+	std::unique_ptr<OegPipeline> OegPipelineManager::buildPipeline(
+		std::shared_ptr<OegShaderModule> vertShader,
+		std::shared_ptr<OegShaderModule> fragShader,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization)
+	{
+		if (pipelineLibrary)
+		{
+			return std::make_unique<OegPipeline>(
+				oegDevice,
+				*pipelineLibrary,
+				std::move(vertShader),
+				std::move(fragShader),
+				configInfo,
+				specialization,
+				PipelineLinkMode::Fast);
+		}
+		return std::make_unique<OegPipeline>(
+			oegDevice, std::move(vertShader), std::move(fragShader), configInfo, specialization);
+	}
+
+	void OegPipelineManager::compile(
+		Entry& entry,
+		bool buildUsable,
+		const std::string& name,
+		std::shared_ptr<OegShaderModule> vertShader,
+		std::shared_ptr<OegShaderModule> fragShader,
+		PipelineConfigInfo configInfo,
+		SpecializationConstants specialization)
+	{
+		fixConfigPointers(configInfo);
+		if (buildUsable)
+		{
+			try
+			{
+				entry.pipeline = buildPipeline(vertShader, fragShader, configInfo, specialization);
+				entry.ready.store(true, std::memory_order_release);
+			}
+			catch (const std::exception& e)
+			{
+				// the fallback stays bound for good
+				std::cerr << "pipeline variant of " << name << " failed to compile: " << e.what() << std::endl;
+				entry.failed.store(true, std::memory_order_release);
+				return;
+			}
+		}
+
+		if (!pipelineLibrary)
+		{
+			return;
+		}
+		try
+		{
+			entry.optimizedPipeline = std::make_unique<OegPipeline>(
+				oegDevice,
+				*pipelineLibrary,
+				std::move(vertShader),
+				std::move(fragShader),
+				configInfo,
+				specialization,
+				PipelineLinkMode::Optimized);
+			entry.optimized.store(true, std::memory_order_release);
+		}
+		catch (const std::exception& e)
+		{
+			// the fast-linked pipeline keeps being used
+			std::cerr << "optimized link of " << name << " failed: " << e.what() << std::endl;
+		}
+	}
+
+	PipelineHandle OegPipelineManager::createPipeline(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization)
+	{
+		auto vertShader = acquireShaderModule(vertFilepath);
+		auto fragShader = acquireShaderModule(fragFilepath);
+
+		std::string key = makePipelineKey(*vertShader, *fragShader, configInfo, specialization);
+		if (auto it = pipelinesByKey.find(key); it != pipelinesByKey.end())
+		{
+			// a background compile of the same state may still be running, this call promises a usable pipeline
+			Entry& existing = *entries[it->second];
+			if (!existing.ready)
+			{
+				OegJobSystem::get().wait(existing.compilation);
+			}
+			if (!existing.failed)
+			{
+				deduplicatedRequests++;
+				return it->second;
+			}
+		}
+
+		auto entry = std::make_unique<Entry>();
+		entry->pipeline = buildPipeline(vertShader, fragShader, configInfo, specialization);
+		entry->ready = true;
+
+		if (pipelineLibrary)
+		{
+			Entry* target = entry.get();
+			OegJobSystem::get().scheduleBackground(
+				[this, target, vertFilepath, vertShader, fragShader, configInfo, specialization]()
+				{
+					compile(*target, false, vertFilepath, vertShader, fragShader, configInfo, specialization);
+				},
+				&entry->compilation);
+		}
+
+		entries.push_back(std::move(entry));
+		const auto handle = static_cast<PipelineHandle>(entries.size() - 1);
+		pipelinesByKey[std::move(key)] = handle;
+		return handle;
+	}
+
+	PipelineHandle OegPipelineManager::requestPipeline(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo,
+		const SpecializationConstants& specialization,
+		PipelineHandle fallback)
+	{
+		assert(fallback < entries.size() && "A background pipeline needs an existing fallback");
+
+		auto vertShader = acquireShaderModule(vertFilepath);
+		auto fragShader = acquireShaderModule(fragFilepath);
+
+		std::string key = makePipelineKey(*vertShader, *fragShader, configInfo, specialization);
+		if (auto it = pipelinesByKey.find(key); it != pipelinesByKey.end())
+		{
+			deduplicatedRequests++;
+			return it->second;
+		}
+
+		auto entry = std::make_unique<Entry>();
+		entry->fallback = fallback;
+
+		Entry* target = entry.get();
+		OegJobSystem::get().scheduleBackground(
+			[this, target, vertFilepath, vertShader, fragShader, configInfo, specialization]()
+			{
+				compile(*target, true, vertFilepath, vertShader, fragShader, configInfo, specialization);
+			},
+			&entry->compilation);
+
+		entries.push_back(std::move(entry));
+		const auto handle = static_cast<PipelineHandle>(entries.size() - 1);
+		pipelinesByKey[std::move(key)] = handle;
+		return handle;
+	}
+
+	bool OegPipelineManager::isReady(PipelineHandle handle) const
+	{
+		assert(handle < entries.size() && "Invalid pipeline handle");
+		return entries[handle]->ready.load(std::memory_order_acquire);
+	}
+
+	uint32_t OegPipelineManager::getPendingCount() const
+	{
+		uint32_t pending = 0;
+		for (const auto& entry : entries)
+		{
+			if (!entry->ready.load(std::memory_order_acquire) && !entry->failed.load(std::memory_order_acquire))
+			{
+				pending++;
+			}
+		}
+		return pending;
+	}
+
+	void OegPipelineManager::bind(PipelineHandle handle, OegCommandRecorder& recorder)
+	{
+		// walk down the fallback chain until something is compiled
+		while (!isReady(handle))
+		{
+			handle = entries[handle]->fallback;
+			assert(handle != INVALID_PIPELINE && "No compiled pipeline in the fallback chain");
+		}
+		Entry& entry = *entries[handle];
+		if (entry.optimized.load(std::memory_order_acquire))
+		{
+			entry.optimizedPipeline->bind(recorder);
+		}
+		else
+		{
+			entry.pipeline->bind(recorder);
+		}
+	}
+
+	PipelineManagerStats OegPipelineManager::getStats() const
+	{
+		PipelineManagerStats stats{};
+		stats.pipelineCount = static_cast<uint32_t>(entries.size());
+		stats.deduplicatedRequests = deduplicatedRequests;
+		stats.sharedShaderModules = sharedShaderModules;
+		stats.libraryPartCount = pipelineLibrary ? pipelineLibrary->getPartCount() : 0;
+		for (const auto& [hash, shaderModule] : shaderModules)
+		{
+			stats.shaderModuleCount += shaderModule.expired() ? 0 : 1;
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "oeg_command_recorder.h"
+#include "oeg_device.h"
+#include "oeg_job_system.h"
+#include "oeg_pipeline.h"
+#include "oeg_pipeline_library.h"
+#include "oeg_shader_module.h"
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace oeg
+{
+	using PipelineHandle = uint32_t;
+
+	struct PipelineManagerStats
+	{
+		uint32_t pipelineCount{0};
+		uint32_t deduplicatedRequests{0}; // requests answered with an existing pipeline
+		uint32_t shaderModuleCount{0};
+		uint32_t sharedShaderModules{0}; // module loads answered with an existing module
+		uint32_t libraryPartCount{0}; // 0 without VK_EXT_graphics_pipeline_library
+	};
+
+	/**
+	 * Owns graphics pipelines and hands out handles to them. Variants can be compiled on a worker
+	 * thread; until a variant is ready, binding its handle binds its fallback instead, so asking
+	 * for a new shader permutation never stalls a frame.
+	 *
+	 * Requests are keyed by the full pipeline state, so render systems asking for the same state
+	 * get the same handle, and shader modules with identical SPIR-V are shared between pipelines.
+	 *
+	 * With VK_EXT_graphics_pipeline_library a pipeline is fast-linked from cached library parts and
+	 * usable right away, the link-time optimized version replaces it once a background job has built it.
+	 * Without the extension pipelines are compiled in one piece.
+	 *
+	 * Handles are requested and bound from the render thread, only the compilation runs elsewhere.
+	 */
+	class OegPipelineManager
+	{
+	public:
+		static constexpr PipelineHandle INVALID_PIPELINE = UINT32_MAX;
+
+		explicit OegPipelineManager(OegDevice& device);
+		// waits for compilations that are still running
+		~OegPipelineManager();
+
+		OegPipelineManager(const OegPipelineManager&) = delete;
+		OegPipelineManager& operator=(const OegPipelineManager&) = delete;
+
+		// compiles on the calling thread, meant for the generic pipelines others fall back to
+		PipelineHandle createPipeline(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization = {});
+
+		// compiles on a worker thread, fallback is bound in its place until it is ready
+		PipelineHandle requestPipeline(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization,
+			PipelineHandle fallback);
+
+		bool isReady(PipelineHandle handle) const;
+		uint32_t getPendingCount() const;
+
+		// blocks until no compilation is running, call before destroying layouts or render passes they use
+		void waitIdle();
+
+		void bind(PipelineHandle handle, OegCommandRecorder& recorder);
+
+		PipelineManagerStats getStats() const;
+
+	private:
+		struct Entry
+		{
+			// fast-linked or monolithic, published by ready
+			std::unique_ptr<OegPipeline> pipeline;
+			// link-time optimized, published by optimized and bound in place of pipeline
+			std::unique_ptr<OegPipeline> optimizedPipeline;
+			std::atomic<bool> ready{false};
+			std::atomic<bool> optimized{false};
+			std::atomic<bool> failed{false};
+			PipelineHandle fallback{INVALID_PIPELINE};
+			// background job building the pipeline, done once it has finished or failed
+			JobCounter compilation;
+		};
+
+		std::shared_ptr<OegShaderModule> acquireShaderModule(const std::string& filepath);
+		std::string makePipelineKey(
+			const OegShaderModule& vertShader,
+			const OegShaderModule& fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization) const;
+
+		// fast-linked when the pipeline library is available, monolithic otherwise
+		std::unique_ptr<OegPipeline> buildPipeline(
+			std::shared_ptr<OegShaderModule> vertShader,
+			std::shared_ptr<OegShaderModule> fragShader,
+			const PipelineConfigInfo& configInfo,
+			const SpecializationConstants& specialization);
+		// worker side of a request, configInfo is a copy owned by the worker
+		void compile(
+			Entry& entry,
+			bool buildUsable,
+			const std::string& name,
+			std::shared_ptr<OegShaderModule> vertShader,
+			std::shared_ptr<OegShaderModule> fragShader,
+			PipelineConfigInfo configInfo,
+			SpecializationConstants specialization);
+
+		OegDevice& oegDevice;
+		std::unique_ptr<OegPipelineLibrary> pipelineLibrary;
+		std::vector<std::unique_ptr<Entry>> entries;
+
+		std::unordered_map<std::string, PipelineHandle> pipelinesByKey;
+		// weak so a module goes away with the last pipeline that uses it
+		std::unordered_map<size_t, std::weak_ptr<OegShaderModule>> shaderModules;
+		uint32_t deduplicatedRequests{0};
+		uint32_t sharedShaderModules{0};
+	};
+}
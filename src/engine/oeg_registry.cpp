@@ -0,0 +1,103 @@
+#include "oeg_registry.h"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace oeg
+{
+	Entity OegRegistry::create()
+	{
+		uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(sparse.size());
+			sparse.push_back(NO_DENSE_INDEX);
+			generations.push_back(0);
+		}
+
+		const Entity entity{index, generations[index]};
+		sparse[index] = static_cast<uint32_t>(entities.size());
+		entities.push_back(entity);
+		transforms.emplace_back();
+		models.emplace_back();
+		colors.emplace_back(0.0f);
+		parents.emplace_back();
+		worldTransforms.emplace_back();
+
+		layoutVersion++;
+		return entity;
+	}
+
+	/**
+		* The last entity takes the destroyed one's dense index, so the arrays never have holes and
+		* only one entity changes position.
+	*/
+	void OegRegistry::destroy(Entity entity)
+	{
+		// a stale handle would remove whichever live entity took its dense index
+		if (!isAlive(entity))
+		{
+			return;
+		}
+
+		const uint32_t removed = sparse[entity.index];
+		const uint32_t last = static_cast<uint32_t>(entities.size() - 1);
+		if (removed != last)
+		{
+			entities[removed] = entities[last];
+			transforms[removed] = std::move(transforms[last]);
+			models[removed] = std::move(models[last]);
+			colors[removed] = colors[last];
+			parents[removed] = parents[last];
+			worldTransforms[removed] = worldTransforms[last];
+			sparse[entities[removed].index] = removed;
+		}
+		entities.pop_back();
+		transforms.pop_back();
+		models.pop_back();
+		colors.pop_back();
+		parents.pop_back();
+		worldTransforms.pop_back();
+
+		sparse[entity.index] = NO_DENSE_INDEX;
+		generations[entity.index]++;
+		freeIndices.push_back(entity.index);
+
+		layoutVersion++;
+	}
+
+	bool OegRegistry::isAlive(Entity entity) const
+	{
+		return entity.index < sparse.size() &&
+			generations[entity.index] == entity.generation &&
+			sparse[entity.index] != NO_DENSE_INDEX;
+	}
+
+	void OegRegistry::setParent(Entity child, Entity parent)
+	{
+		assert(isAlive(child) && (parent.isNull() || isAlive(parent)));
+		// a cycle would never end the scene graph's walks up the parent chains
+		for (Entity ancestor = parent; !ancestor.isNull() && isAlive(ancestor); ancestor = getParent(ancestor))
+		{
+			if (ancestor == child)
+			{
+				throw std::runtime_error("parenting an entity to its own descendant");
+			}
+		}
+
+		parents[denseIndex(child)] = parent;
+		hierarchyVersion++;
+	}
+
+	uint32_t OegRegistry::denseIndex(Entity entity) const
+	{
+		assert(isAlive(entity) && "Accessing components of an entity that is not alive");
+		return sparse[entity.index];
+	}
+}
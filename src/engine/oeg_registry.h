@@ -0,0 +1,115 @@
+#pragma once
+
+#include "oeg_game_object.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * \brief Handle to an entity in an OegRegistry. The generation changes every time the index is
+	 * reused, so a handle to a destroyed entity never resolves to whatever took its place.
+	 */
+	struct Entity
+	{
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		uint32_t index{INVALID_INDEX};
+		uint32_t generation{0};
+
+		bool isNull() const { return index == INVALID_INDEX; }
+		bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Entity& other) const { return !(*this == other); }
+	};
+
+	/**
+	 * Owns every entity and its components. Each component lives in its own dense array and index i
+	 * of every array belongs to the same entity, so systems stream through exactly the components
+	 * they need with no gaps. Handles reach their dense index through a sparse array, and destroying
+	 * an entity moves the last one into the hole so the arrays stay dense.
+	 *
+	 * Dense indices are only stable while no entity is created or destroyed, getLayoutVersion tells
+	 * whether anything that cached them has to rebuild. The same goes for getHierarchyVersion and
+	 * parent links.
+	 */
+	class OegRegistry
+	{
+	public:
+		// smallest range handed to a job, fewer entities stay on the calling thread
+		static constexpr size_t PARALLEL_THRESHOLD = 4096;
+
+		OegRegistry() = default;
+
+		OegRegistry(const OegRegistry&) = delete;
+		OegRegistry& operator=(const OegRegistry&) = delete;
+
+		// O(1), reuses the most recently freed index
+		Entity create();
+		// O(1), the handle and every copy of it become invalid. Destroying a dead handle does nothing
+		void destroy(Entity entity);
+		bool isAlive(Entity entity) const;
+
+		// a null parent makes the entity a root again. Destroying a parent leaves its children as roots.
+		// Throws when parent is child itself or one of its descendants
+		void setParent(Entity child, Entity parent);
+		Entity getParent(Entity entity) const { return parents[denseIndex(entity)]; }
+
+		size_t size() const { return entities.size(); }
+		bool empty() const { return entities.empty(); }
+		uint64_t getLayoutVersion() const { return layoutVersion; }
+		uint64_t getHierarchyVersion() const { return hierarchyVersion; }
+
+		uint32_t denseIndex(Entity entity) const;
+		TransformComponent& transform(Entity entity) { return transforms[denseIndex(entity)]; }
+		std::shared_ptr<OegModel>& model(Entity entity) { return models[denseIndex(entity)]; }
+		glm::vec3& color(Entity entity) { return colors[denseIndex(entity)]; }
+		// written by OegSceneGraph::propagate, what the renderers draw with
+		const WorldTransform& worldTransform(Entity entity) const { return worldTransforms[denseIndex(entity)]; }
+
+		// component views, indexed by dense index
+		const std::vector<Entity>& getEntities() const { return entities; }
+		std::vector<TransformComponent>& getTransforms() { return transforms; }
+		const std::vector<TransformComponent>& getTransforms() const { return transforms; }
+		std::vector<std::shared_ptr<OegModel>>& getModels() { return models; }
+		const std::vector<std::shared_ptr<OegModel>>& getModels() const { return models; }
+		std::vector<glm::vec3>& getColors() { return colors; }
+		const std::vector<glm::vec3>& getColors() const { return colors; }
+		const std::vector<Entity>& getParents() const { return parents; }
+		std::vector<WorldTransform>& getWorldTransforms() { return worldTransforms; }
+		const std::vector<WorldTransform>& getWorldTransforms() const { return worldTransforms; }
+
+		/**
+		 * \brief Calls func(begin, end) over disjoint dense index ranges covering every entity, as jobs once
+		 * there are enough of them. func must only touch components in its own range
+		 */
+		template <typename Func>
+		void parallelFor(Func&& func) const
+		{
+			OegJobSystem::get().parallelFor(entities.size(), PARALLEL_THRESHOLD, std::forward<Func>(func));
+		}
+
+	private:
+		static constexpr uint32_t NO_DENSE_INDEX = ~0u;
+
+		// indexed by Entity::index
+		std::vector<uint32_t> sparse;
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> freeIndices;
+
+		// indexed by dense index
+		std::vector<Entity> entities;
+		std::vector<TransformComponent> transforms;
+		std::vector<std::shared_ptr<OegModel>> models;
+		std::vector<glm::vec3> colors;
+		std::vector<Entity> parents;
+		std::vector<WorldTransform> worldTransforms;
+
+		uint64_t layoutVersion{0};
+		uint64_t hierarchyVersion{0};
+	};
+}
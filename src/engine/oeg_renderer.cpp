@@ -1,4 +1,5 @@
 #include "oeg_renderer.h"
+#include "oeg_trace.h"
 
 // std
 #include <stdexcept>
@@ -8,7 +9,7 @@
 namespace oeg
 {
 	OegRenderer::OegRenderer(OegWindow& window, OegDevice& device)
-		: oegWindow{window}, oegDevice{device}
+		: oegWindow{window}, oegDevice{device}, gpuProfiler{device, OegSwapChain::MAX_FRAMES_IN_FLIGHT}
 	{
 		recreateSwapChain();
 		createCommandBuffer();
@@ -21,11 +22,12 @@ namespace oeg
 
 	void OegRenderer::recreateSwapChain()
 	{
-		auto extent = oegWindow.getExtent();
-		while (extent.width == 0 || extent.height == 0)
+		// minimized, GLFW events are only pumped on the main thread so this thread cannot wait for a new
+		// size here. The old swapchain stays until a later frame finds the window restored
+		const VkExtent2D extent = oegWindow.getExtent();
+		if (extent.width == 0 || extent.height == 0)
 		{
-			extent = oegWindow.getExtent();
-			glfwWaitEvents();
+			return;
 		}
 
 		vkDeviceWaitIdle(oegDevice.device());
@@ -75,8 +77,17 @@ namespace oeg
 		commandBuffers.clear();
 	}
 
-	VkCommandBuffer OegRenderer::beginFrame()
+	std::vector<GpuFrameProfile> OegRenderer::finishGpuProfiles()
 	{
+		assert(!isFrameStarted && "Can't finish GPU profiles while a frame is being recorded");
+		vkDeviceWaitIdle(oegDevice.device());
+		// currentFrameIndex is the next one to be recorded, so the oldest one in flight
+		return gpuProfiler.readPendingProfiles(static_cast<uint32_t>(currentFrameIndex));
+	}
+
+	VkCommandBuffer OegRenderer::beginFrame(uint64_t frameId)
+	{
+		OEG_TRACE_ZONE("beginFrame");
 		assert(!isFrameStarted && "Cant call beginFrame while already in progress!");
 
 		auto result = oegSwapChain->acquireNextImage(&currentImageIndex);
@@ -104,19 +115,26 @@ namespace oeg
 		{
 			throw std::runtime_error("Failed to record command buffer! :(");
 		}
+		commandRecorder.begin(commandBuffer);
+
+		// the fence of this frame index was waited for while acquiring, its last frame's queries are done
+		gpuProfiler.beginFrame(commandBuffer, static_cast<uint32_t>(currentFrameIndex), frameId);
 		return commandBuffer;
 	}
 
-	void OegRenderer::endFrame()
+	void OegRenderer::endFrame(const std::function<void()>& beforeSubmit)
 	{
+		OEG_TRACE_ZONE("endFrame");
 		assert(isFrameStarted && "Can't call endFrame while frame is in progress...");
 		auto commandBuffer = getCurrentCommandBuffer();
+		gpuProfiler.endFrame(commandBuffer);
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to record command buffer!!!");
 		}
+		lastRecorderStats = commandRecorder.getStats();
 
-		auto result = oegSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		auto result = oegSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex, beforeSubmit);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || oegWindow.wasWindowResized())
 		{
 			oegWindow.resetWindowResiedFlag();
@@ -131,7 +149,7 @@ namespace oeg
 		currentFrameIndex = (currentFrameIndex + 1) % OegSwapChain::MAX_FRAMES_IN_FLIGHT;
 	}
 
-	void OegRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void OegRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, bool loadContents)
 	{
 		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is in progress...");
 		assert(
@@ -140,7 +158,7 @@ namespace oeg
 
 		VkRenderPassBeginInfo renderPassInfo{};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = oegSwapChain->getRenderPass();
+		renderPassInfo.renderPass = loadContents ? oegSwapChain->getLoadRenderPass() : oegSwapChain->getRenderPass();
 		renderPassInfo.framebuffer = oegSwapChain->getFrameBuffer(currentImageIndex);
 
 		// shader loading and storing
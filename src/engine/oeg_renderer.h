@@ -1,11 +1,14 @@
 #pragma once
 
 // my shit
+#include "oeg_command_recorder.h"
 #include "oeg_device.h"
+#include "oeg_gpu_profiler.h"
 #include "oeg_window.h"
 #include "oeg_swap_chain.h"
 
 // std
+#include <functional>
 #include <memory>
 #include <vector>
 #include <cassert>
@@ -25,6 +28,9 @@ namespace oeg
 
 		VkRenderPass getSwapChainRenderPass() const { return oegSwapChain->getRenderPass(); }
 		float getAspectRatio() const { return oegSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapChainExtent() const { return oegSwapChain->getSwapChainExtent(); }
+		VkFormat getDepthFormat() const { return oegSwapChain->getSwapChainDepthFormat(); }
+		const std::vector<VkImageView>& getDepthImageViews() const { return oegSwapChain->getDepthImageViews(); }
 		bool isFrameInProgress() const { return isFrameStarted; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const
@@ -39,11 +45,41 @@ namespace oeg
 			return currentFrameIndex;
 		}
 
-		VkCommandBuffer beginFrame();
+		uint32_t getCurrentImageIndex() const
+		{
+			assert(isFrameStarted && "Cannot get image index when frame not in progress");
+			return currentImageIndex;
+		}
+
+		VkImage getCurrentDepthImage() const { return oegSwapChain->getDepthImage(getCurrentImageIndex()); }
 
-		void endFrame();
+		OegCommandRecorder& getCommandRecorder()
+		{
+			assert(isFrameStarted && "Cannot get command recorder when frame not in progress");
+			return commandRecorder;
+		}
 
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// recorder counts of the last submitted frame
+		const CommandRecorderStats& getLastRecorderStats() const { return lastRecorderStats; }
+		// scopes are opened on the current command buffer between beginFrame and endFrame
+		OegGpuProfiler& getGpuProfiler() { return gpuProfiler; }
+		// of the newest frame the GPU has finished, MAX_FRAMES_IN_FLIGHT frames behind the one being recorded.
+		// Not valid when the device has no timestamps on its graphics queue
+		const GpuFrameProfile& getLastGpuProfile() const { return gpuProfiler.getLastProfile(); }
+		// waits for the device, then returns the GPU profiles of the frames still in flight, oldest first
+		std::vector<GpuFrameProfile> finishGpuProfiles();
+
+		// frameId is handed back with the frame's GPU profile, see getLastGpuProfile
+		VkCommandBuffer beginFrame(uint64_t frameId = 0);
+
+		/**
+		 * \brief Ends recording and submits. beforeSubmit runs right before the submit, after every wait,
+		 * so host visible data the recorded commands read can still be changed there
+		 */
+		void endFrame(const std::function<void()>& beforeSubmit = nullptr);
+
+		// loadContents continues on the attachments of an earlier pass in this frame instead of clearing them
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer, bool loadContents = false);
 
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
@@ -59,6 +95,10 @@ namespace oeg
 		std::unique_ptr<OegSwapChain> oegSwapChain;
 		// updating the swapchain with a new width and height with unique_ptr
 		std::vector<VkCommandBuffer> commandBuffers;
+		OegCommandRecorder commandRecorder;
+		CommandRecorderStats lastRecorderStats{};
+
+		OegGpuProfiler gpuProfiler;
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex{0}; // ........ just had to initialize it....
@@ -0,0 +1,192 @@
+#include "oeg_scene_graph.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <chrono>
+
+namespace oeg
+{
+	/**
+		* Finds every entity's depth by walking up to the nearest ancestor whose depth is known, then
+		* counting sorts the entities by depth. Parents that were destroyed count as missing, their
+		* children become roots.
+	*/
+	void OegSceneGraph::rebuild(const OegRegistry& registry)
+	{
+		constexpr uint32_t UNKNOWN_DEPTH = ~0u;
+		const size_t count = registry.size();
+		const std::vector<Entity>& parents = registry.getParents();
+
+		std::vector<uint32_t> parentDense(count, NO_PARENT);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (!parents[i].isNull() && registry.isAlive(parents[i]))
+			{
+				parentDense[i] = registry.denseIndex(parents[i]);
+			}
+		}
+
+		std::vector<uint32_t> depths(count, UNKNOWN_DEPTH);
+		std::vector<uint32_t> chain;
+		uint32_t levelCount = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t depth = 0;
+			uint32_t current = i;
+			chain.clear();
+			while (true)
+			{
+				if (depths[current] != UNKNOWN_DEPTH)
+				{
+					depth = depths[current] + 1;
+					break;
+				}
+				chain.push_back(current);
+				if (parentDense[current] == NO_PARENT)
+				{
+					break;
+				}
+				current = parentDense[current];
+			}
+
+			// the chain runs from i up to the topmost entity without a depth
+			for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+			{
+				depths[*it] = depth++;
+			}
+			levelCount = std::max(levelCount, depths[i] + 1);
+		}
+
+		levelOffsets.assign(levelCount + 1, 0);
+		for (uint32_t depth : depths)
+		{
+			levelOffsets[depth + 1]++;
+		}
+		for (uint32_t level = 0; level < levelCount; level++)
+		{
+			levelOffsets[level + 1] += levelOffsets[level];
+		}
+
+		order.resize(count);
+		nodeOfDense.resize(count);
+		std::vector<uint32_t> cursors(levelOffsets.begin(), levelOffsets.end() - 1);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t node = cursors[depths[i]]++;
+			order[node] = i;
+			nodeOfDense[i] = node;
+		}
+
+		parentNodes.resize(count);
+		for (size_t node = 0; node < count; node++)
+		{
+			const uint32_t parent = parentDense[order[node]];
+			parentNodes[node] = parent == NO_PARENT ? NO_PARENT : nodeOfDense[parent];
+		}
+
+		builtLayoutVersion = registry.getLayoutVersion();
+		builtHierarchyVersion = registry.getHierarchyVersion();
+	}
+
+	void OegSceneGraph::propagateRange(OegRegistry& registry, size_t begin, size_t end)
+	{
+		std::vector<TransformComponent>& transforms = registry.getTransforms();
+		std::vector<WorldTransform>& worldTransforms = registry.getWorldTransforms();
+
+		for (size_t node = begin; node < end; node++)
+		{
+			const uint32_t parent = parentNodes[node];
+			if (parent != NO_PARENT && changed[parent])
+			{
+				changed[node] = 1;
+			}
+			if (!changed[node])
+			{
+				continue;
+			}
+
+			TransformComponent& local = transforms[order[node]];
+			WorldTransform& world = worldTransforms[order[node]];
+			if (parent == NO_PARENT)
+			{
+				world.modelMatrix = local.mat4();
+				world.normalMatrix = local.normalMatrix();
+				world.packed = local.packed();
+			}
+			else
+			{
+				// the parent's level is complete, it was processed before this one started
+				const WorldTransform& parentWorld = worldTransforms[order[parent]];
+				world.modelMatrix = parentWorld.modelMatrix * local.mat4();
+				world.normalMatrix = parentWorld.normalMatrix * local.normalMatrix();
+				world.packed = composeTransforms(parentWorld.packed, local.packed());
+			}
+		}
+	}
+
+	void OegSceneGraph::propagate(OegRegistry& registry, const std::vector<DirtyRange>& localDirty)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		const size_t count = registry.size();
+		if (registry.getLayoutVersion() != builtLayoutVersion || registry.getHierarchyVersion() != builtHierarchyVersion)
+		{
+			// depths moved around, recompute everything once
+			rebuild(registry);
+			changed.assign(count, 1);
+		}
+		else
+		{
+			changed.assign(count, 0);
+			for (const DirtyRange& range : localDirty)
+			{
+				for (uint32_t i = range.first; i < range.first + range.count; i++)
+				{
+					changed[nodeOfDense[i]] = 1;
+				}
+			}
+		}
+
+		OegJobSystem& jobSystem = OegJobSystem::get();
+		const size_t levelCount = levelOffsets.empty() ? 0 : levelOffsets.size() - 1;
+		for (size_t level = 0; level < levelCount; level++)
+		{
+			const size_t levelBegin = levelOffsets[level];
+			jobSystem.parallelFor(
+				levelOffsets[level + 1] - levelBegin,
+				PARALLEL_THRESHOLD,
+				[this, &registry, levelBegin](size_t begin, size_t end)
+				{
+					propagateRange(registry, levelBegin + begin, levelBegin + end);
+				});
+		}
+
+		// back to dense order, so uploads see the same kind of ranges as local changes produce
+		dirtyRanges.clear();
+		uint32_t updatedCount = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (!changed[nodeOfDense[i]])
+			{
+				continue;
+			}
+			updatedCount++;
+			if (!dirtyRanges.empty() && dirtyRanges.back().first + dirtyRanges.back().count == i)
+			{
+				dirtyRanges.back().count++;
+			}
+			else
+			{
+				dirtyRanges.push_back(DirtyRange{i, 1});
+			}
+		}
+
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.nodeCount = static_cast<uint32_t>(count);
+		stats.levelCount = static_cast<uint32_t>(levelCount);
+		stats.updatedCount = updatedCount;
+		stats.propagateTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		propagateCount++;
+	}
+}
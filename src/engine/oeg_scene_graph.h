@@ -0,0 +1,69 @@
+#pragma once
+
+#include "oeg_registry.h"
+#include "oeg_transform_updater.h"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	struct SceneGraphStats
+	{
+		uint32_t nodeCount{0};
+		uint32_t levelCount{0};
+		uint32_t updatedCount{0};
+		float propagateTimeMs{0.0f};
+	};
+
+	/**
+	 * Turns the registry's local transforms and parent links into world transforms. The hierarchy is
+	 * kept as flat arrays sorted by depth, so every parent comes before its children and each level is
+	 * one contiguous run of nodes. Levels are processed in order and the nodes of a level in parallel,
+	 * since they only read the level above.
+	 *
+	 * Only subtrees under a changed local transform are recomputed. The flat arrays are rebuilt when
+	 * entities are created or destroyed or a parent link changes.
+	 */
+	class OegSceneGraph
+	{
+	public:
+		// smallest run of a level's nodes handed to a job, smaller levels stay on the calling thread
+		static constexpr size_t PARALLEL_THRESHOLD = 4096;
+
+		// localDirty lists the entities whose local transform changed, see OegTransformUpdater::getDirtyRanges
+		void propagate(OegRegistry& registry, const std::vector<DirtyRange>& localDirty);
+
+		// entities whose world transform changed in the last propagate, sorted by dense index
+		const std::vector<DirtyRange>& getDirtyRanges() const { return dirtyRanges; }
+		// counts propagate calls, so a cache following the dirty ranges can tell it missed one
+		uint64_t getPropagateCount() const { return propagateCount; }
+		const SceneGraphStats& getStats() const { return stats; }
+
+	private:
+		static constexpr uint32_t NO_PARENT = ~0u;
+
+		void rebuild(const OegRegistry& registry);
+		// nodes [begin, end) of one level
+		void propagateRange(OegRegistry& registry, size_t begin, size_t end);
+
+		// dense index of every node, parents before children
+		std::vector<uint32_t> order;
+		// node of every node's parent, NO_PARENT for roots
+		std::vector<uint32_t> parentNodes;
+		// the nodes of level l are [levelOffsets[l], levelOffsets[l + 1])
+		std::vector<uint32_t> levelOffsets;
+		// node of every dense index
+		std::vector<uint32_t> nodeOfDense;
+		// per node, set when its world transform has to be recomputed this propagate
+		std::vector<uint8_t> changed;
+
+		std::vector<DirtyRange> dirtyRanges;
+		uint64_t builtLayoutVersion{~0ull};
+		uint64_t builtHierarchyVersion{~0ull};
+		uint64_t propagateCount{0};
+
+		SceneGraphStats stats{};
+	};
+}
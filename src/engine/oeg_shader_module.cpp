@@ -0,0 +1,38 @@
+#include "oeg_shader_module.h"
+#include "oeg_pipeline.h"
+
+// std
+#include <stdexcept>
+#include <string_view>
+
+namespace oeg
+{
+	OegShaderModule::OegShaderModule(OegDevice& device, const std::vector<char>& code)
+		: oegDevice{device}, code{code}
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		if (vkCreateShaderModule(oegDevice.device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module.");
+		}
+	}
+
+	OegShaderModule::~OegShaderModule()
+	{
+		vkDestroyShaderModule(oegDevice.device(), shaderModule, nullptr);
+	}
+
+	std::shared_ptr<OegShaderModule> OegShaderModule::createFromFile(OegDevice& device, const std::string& filepath)
+	{
+		return std::make_shared<OegShaderModule>(device, OegPipeline::readFile(filepath));
+	}
+
+	size_t OegShaderModule::hashCode(const std::vector<char>& code)
+	{
+		return std::hash<std::string_view>{}(std::string_view{code.data(), code.size()});
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "oeg_device.h"
+
+// std
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace oeg
+{
+	/**
+	 * Owns a VkShaderModule. Pipelines hold it through a shared_ptr, so pipelines built from the
+	 * same SPIR-V share one module and it is destroyed together with the last of them.
+	 *
+	 * The SPIR-V is kept, caches compare it instead of trusting its hash.
+	 */
+	class OegShaderModule
+	{
+	public:
+		OegShaderModule(OegDevice& device, const std::vector<char>& code);
+		~OegShaderModule();
+
+		OegShaderModule(const OegShaderModule&) = delete;
+		OegShaderModule& operator=(const OegShaderModule&) = delete;
+
+		static std::shared_ptr<OegShaderModule> createFromFile(OegDevice& device, const std::string& filepath);
+
+		// hash of the SPIR-V words, identical code hashes the same no matter where it was loaded from
+		static size_t hashCode(const std::vector<char>& code);
+
+		VkShaderModule getModule() const { return shaderModule; }
+		const std::vector<char>& getCode() const { return code; }
+
+	private:
+		OegDevice& oegDevice;
+		VkShaderModule shaderModule{};
+		std::vector<char> code;
+	};
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// std
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace oeg
+{
+	/**
+	 * Hands snapshots from a producing thread to a consuming thread through two slots, so the producer
+	 * fills frame N + 1 while the consumer works on frame N. Every published snapshot is consumed, in
+	 * order, which lets snapshots carry changes relative to the previous one. The producer waits while
+	 * both slots are taken, the consumer while it has caught up.
+	 *
+	 * A slot belongs to one thread at a time, so snapshots need no locking of their own and keep their
+	 * allocations from one use to the next.
+	 */
+	template <typename Snapshot>
+	class OegSnapshotBuffer
+	{
+	public:
+		static constexpr uint64_t SLOT_COUNT = 2;
+
+		OegSnapshotBuffer() = default;
+
+		OegSnapshotBuffer(const OegSnapshotBuffer&) = delete;
+		OegSnapshotBuffer& operator=(const OegSnapshotBuffer&) = delete;
+
+		// producer side, the slot to fill next or nullptr once closed
+		Snapshot* beginWrite()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return closed || published - released < SLOT_COUNT; });
+			return closed ? nullptr : &slots[published % SLOT_COUNT];
+		}
+
+		void publish()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				published++;
+			}
+			condition.notify_all();
+		}
+
+		// consumer side, the oldest unconsumed snapshot or nullptr once closed
+		Snapshot* acquire()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return closed || released < published; });
+			return closed ? nullptr : &slots[released % SLOT_COUNT];
+		}
+
+		void release()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				released++;
+			}
+			condition.notify_all();
+		}
+
+		// wakes both sides, every later call returns nullptr
+		void close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				closed = true;
+			}
+			condition.notify_all();
+		}
+
+	private:
+		std::array<Snapshot, SLOT_COUNT> slots{};
+		std::mutex mutex;
+		std::condition_variable condition;
+		uint64_t published{0};
+		uint64_t released{0};
+		bool closed{false};
+	};
+}
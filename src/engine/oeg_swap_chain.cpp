@@ -1,4 +1,5 @@
 #include "oeg_swap_chain.h"
+#include "oeg_trace.h"
 
 // std
 #include <array>
@@ -28,9 +29,17 @@ namespace oeg
 
 	void OegSwapChain::init()
 	{
-		createSwapChain();
+		if (device.isHeadless())
+		{
+			createOffscreenImages();
+		}
+		else
+		{
+			createSwapChain();
+		}
 		createImageViews();
 		createRenderPass();
+		createLoadRenderPass();
 		createDepthResources();
 		createFramebuffers();
 		createSyncObjects();
@@ -50,8 +59,14 @@ namespace oeg
 			swapChain = nullptr;
 		}
 
+		for (size_t i = 0; i < offscreenImageAllocations.size(); i++)
+		{
+			vmaDestroyImage(device.getAllocator(), swapChainImages[i], offscreenImageAllocations[i]);
+		}
+
 		for (int i = 0; i < depthImages.size(); i++)
 		{
+			vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
 			vmaDestroyImage(device.getAllocator(), depthImages[i], depthImageAllocations[i]);
 		}
 
@@ -61,6 +76,7 @@ namespace oeg
 		}
 
 		vkDestroyRenderPass(device.device(), renderPass, nullptr);
+		vkDestroyRenderPass(device.device(), loadRenderPass, nullptr);
 
 		// cleanup synchronization objects
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -73,6 +89,7 @@ namespace oeg
 
 	VkResult OegSwapChain::acquireNextImage(uint32_t* imageIndex)
 	{
+		OEG_TRACE_ZONE("acquireNextImage");
 		vkWaitForFences(
 			device.device(),
 			1,
@@ -80,6 +97,13 @@ namespace oeg
 			VK_TRUE,
 			std::numeric_limits<uint64_t>::max());
 
+		// one offscreen image per frame in flight, the fence above already guards it
+		if (device.isHeadless())
+		{
+			*imageIndex = static_cast<uint32_t>(currentFrame);
+			return VK_SUCCESS;
+		}
+
 		VkResult result = vkAcquireNextImageKHR(
 			device.device(),
 			swapChain,
@@ -92,7 +116,7 @@ namespace oeg
 	}
 
 	VkResult OegSwapChain::submitCommandBuffers(
-		const VkCommandBuffer* buffers, uint32_t* imageIndex)
+		const VkCommandBuffer* buffers, uint32_t* imageIndex, const std::function<void()>& beforeSubmit)
 	{
 		if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
 		{
@@ -100,12 +124,20 @@ namespace oeg
 		}
 		imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
+		if (beforeSubmit)
+		{
+			beforeSubmit();
+		}
+
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+		// nothing was acquired and nothing is presented headless, so there are no semaphores to wait on or signal
+		const bool presenting = !device.isHeadless();
+
 		VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
 		VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.waitSemaphoreCount = presenting ? 1 : 0;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 
@@ -113,14 +145,23 @@ namespace oeg
 		submitInfo.pCommandBuffers = buffers;
 
 		VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = presenting ? 1 : 0;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
 		vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-			VK_SUCCESS)
 		{
-			throw std::runtime_error("failed to submit draw command buffer!");
+			OEG_TRACE_ZONE("vkQueueSubmit");
+			if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+				VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to submit draw command buffer!");
+			}
+		}
+
+		if (!presenting)
+		{
+			currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+			return VK_SUCCESS;
 		}
 
 		VkPresentInfoKHR presentInfo = {};
@@ -135,7 +176,11 @@ namespace oeg
 
 		presentInfo.pImageIndices = imageIndex;
 
-		auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		VkResult result;
+		{
+			OEG_TRACE_ZONE("present");
+			result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+		}
 
 		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -210,6 +255,45 @@ namespace oeg
 		swapChainExtent = extent;
 	}
 
+	void OegSwapChain::createOffscreenImages()
+	{
+		swapChainImageFormat = OFFSCREEN_FORMAT;
+		swapChainExtent = windowExtent;
+		colorFinalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		swapChainImages.resize(MAX_FRAMES_IN_FLIGHT);
+		offscreenImageAllocations.resize(MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < swapChainImages.size(); i++)
+		{
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent.width = swapChainExtent.width;
+			imageInfo.extent.height = swapChainExtent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = swapChainImageFormat;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// copied out by whoever wants to look at the frame
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VmaAllocationCreateInfo allocCreateInfo = {};
+			allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+			VmaAllocationInfo allocationInfo{};
+			if (vmaCreateImage(device.getAllocator(), &imageInfo, &allocCreateInfo, &swapChainImages[i],
+			                   &offscreenImageAllocations[i], &allocationInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create offscreen color image!");
+			}
+			OEG_TRACE_INSTANT("allocateImage", allocationInfo.size);
+		}
+	}
+
 	void OegSwapChain::createImageViews()
 	{
 		swapChainImageViews.resize(swapChainImages.size());
@@ -240,7 +324,8 @@ namespace oeg
 		depthAttachment.format = findDepthFormat();
 		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// stored so the depth pyramid can be built from it and a second pass can load it
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -258,7 +343,7 @@ namespace oeg
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		colorAttachment.finalLayout = colorFinalLayout;
 
 		VkAttachmentReference colorAttachmentRef = {};
 		colorAttachmentRef.attachment = 0;
@@ -297,6 +382,76 @@ namespace oeg
 		}
 	}
 
+	/**
+		* Render pass compatible with renderPass that loads the color and depth attachments left by a
+		* previous pass in the same frame, used to continue drawing after the depth pyramid is built.
+	*/
+	void OegSwapChain::createLoadRenderPass()
+	{
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = findDepthFormat();
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription colorAttachment = {};
+		colorAttachment.format = getSwapChainImageFormat();
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.initialLayout = colorFinalLayout; // left there by renderPass
+		colorAttachment.finalLayout = colorFinalLayout;
+
+		VkAttachmentReference colorAttachmentRef = {};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// wait for the attachment writes of the earlier pass before loading them
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.srcStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstSubpass = 0;
+		dependency.dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+
+		if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &loadRenderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create load render pass!");
+		}
+	}
+
 	void OegSwapChain::createFramebuffers()
 	{
 		swapChainFramebuffers.resize(imageCount());
@@ -328,6 +483,7 @@ namespace oeg
 	void OegSwapChain::createDepthResources()
 	{
 		VkFormat depthFormat = findDepthFormat();
+		swapChainDepthFormat = depthFormat;
 		VkExtent2D swapChainExtent = getSwapChainExtent();
 
 		depthImages.resize(imageCount());
@@ -348,18 +504,21 @@ namespace oeg
 			imageInfo.format = depthFormat;
 			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+			// sampled by the depth pyramid build
+			imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 			VmaAllocationCreateInfo allocCreateInfo = {};
 			allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
+			VmaAllocationInfo allocationInfo{};
 			if (vmaCreateImage(device.getAllocator(), &imageInfo, &allocCreateInfo, &depthImages[i],
-			                   &depthImageAllocations[i], nullptr) != VK_SUCCESS)
+			                   &depthImageAllocations[i], &allocationInfo) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to create depth image!");
 			}
+			OEG_TRACE_INSTANT("allocateImage", allocationInfo.size);
 
 			// Creating the image view
 			VkImageViewCreateInfo viewInfo = {};
@@ -467,6 +626,6 @@ namespace oeg
 		return device.findSupportedFormat(
 			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
 			VK_IMAGE_TILING_OPTIMAL,
-			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 	}
 } // namespace lve
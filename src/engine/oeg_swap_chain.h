@@ -6,16 +6,23 @@
 #include <vulkan/vulkan.h>
 
 // Standard library headers
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace oeg
 {
+	/**
+	 * Presentable color images with a depth image each, and the render passes and framebuffers drawing
+	 * into them. On a headless device the color images are plain offscreen images, one per frame in
+	 * flight, that are left in TRANSFER_SRC_OPTIMAL for readback instead of being presented.
+	 */
 	class OegSwapChain
 	{
 	public:
 		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		static constexpr VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
 
 		OegSwapChain(OegDevice& deviceRef, VkExtent2D windowExtent);
 		OegSwapChain(OegDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<OegSwapChain> previous);
@@ -26,7 +33,12 @@ namespace oeg
 
 		VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
 		VkRenderPass getRenderPass() { return renderPass; }
+		// same attachments as getRenderPass(), but keeps their contents instead of clearing them
+		VkRenderPass getLoadRenderPass() { return loadRenderPass; }
 		VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+		VkImage getDepthImage(int index) { return depthImages[index]; }
+		const std::vector<VkImageView>& getDepthImageViews() { return depthImageViews; }
+		VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
 		size_t imageCount() { return swapChainImages.size(); }
 		VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
 		VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -41,7 +53,9 @@ namespace oeg
 		VkFormat findDepthFormat();
 
 		VkResult acquireNextImage(uint32_t* imageIndex);
-		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		// beforeSubmit runs once the image is no longer in use, the last moment to write data the frame reads
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+		                              const std::function<void()>& beforeSubmit = nullptr);
 
 		bool compareSwapFormats(const OegSwapChain& swapChain) const
 		{
@@ -52,9 +66,11 @@ namespace oeg
 	private:
 		void init();
 		void createSwapChain();
+		void createOffscreenImages();
 		void createImageViews();
 		void createDepthResources();
 		void createRenderPass();
+		void createLoadRenderPass();
 		void createFramebuffers();
 		void createSyncObjects();
 
@@ -71,17 +87,22 @@ namespace oeg
 
 		std::vector<VkFramebuffer> swapChainFramebuffers;
 		VkRenderPass renderPass;
+		VkRenderPass loadRenderPass;
 
 		std::vector<VkImage> depthImages;
 		std::vector<VmaAllocation> depthImageAllocations; // VMA allocated memory
 		std::vector<VkImageView> depthImageViews;
 		std::vector<VkImage> swapChainImages;
 		std::vector<VkImageView> swapChainImageViews;
+		// only headless, the swapchain owns its images otherwise
+		std::vector<VmaAllocation> offscreenImageAllocations;
+		// layout the color attachment is left in at the end of a render pass
+		VkImageLayout colorFinalLayout{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
 
 		OegDevice& device;
 		VkExtent2D windowExtent;
 
-		VkSwapchainKHR swapChain;
+		VkSwapchainKHR swapChain{VK_NULL_HANDLE};
 		std::shared_ptr<OegSwapChain> oldSwapChain;
 
 		std::vector<VkSemaphore> imageAvailableSemaphores;
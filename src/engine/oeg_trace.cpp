@@ -0,0 +1,171 @@
+#include "oeg_trace.h"
+#include "oeg_utils.h"
+
+// std
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+namespace oeg
+{
+	namespace
+	{
+		struct TrackEntry
+		{
+			// tracks are never destroyed, events of finished threads stay in the trace
+			std::unique_ptr<OegTraceTrack> track;
+			std::string name;
+		};
+
+		const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+		std::mutex tracksMutex;
+		std::vector<TrackEntry> tracks;
+
+		thread_local OegTraceTrack* currentThreadTrack = nullptr;
+		thread_local std::string currentThreadName;
+
+		OegTraceTrack& addTrack(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(tracksMutex);
+			const uint32_t id = static_cast<uint32_t>(tracks.size());
+			tracks.push_back(TrackEntry{std::make_unique<OegTraceTrack>(id), name});
+			return *tracks.back().track;
+		}
+	}
+
+	OegTraceTrack::OegTraceTrack(uint32_t id)
+		: id{id}, slots{std::make_unique<Slot[]>(CAPACITY)}
+	{
+	}
+
+	std::vector<TraceEvent> OegTraceTrack::copyEvents(uint64_t sinceNs) const
+	{
+		const uint64_t end = head.load(std::memory_order_acquire);
+		const uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+
+		std::vector<TraceEvent> copied;
+		copied.reserve(end - begin);
+		for (uint64_t index = begin; index < end; index++)
+		{
+			const Slot& slot = slots[index % CAPACITY];
+			const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const TraceEvent event{
+				slot.name.load(std::memory_order_relaxed),
+				slot.startNs.load(std::memory_order_relaxed),
+				slot.durationNs.load(std::memory_order_relaxed),
+				slot.kind.load(std::memory_order_relaxed),
+				slot.value.load(std::memory_order_relaxed)
+			};
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			// the recording thread has moved on to a newer event in this slot, or is writing it right now
+			if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+			{
+				continue;
+			}
+			if (event.startNs + event.durationNs >= sinceNs)
+			{
+				copied.push_back(event);
+			}
+		}
+		return copied;
+	}
+
+	uint64_t OegTrace::now()
+	{
+		return static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch).count());
+	}
+
+	OegTraceTrack& OegTrace::threadTrack()
+	{
+		if (!currentThreadTrack)
+		{
+			currentThreadTrack = &addTrack(currentThreadName);
+		}
+		return *currentThreadTrack;
+	}
+
+	void OegTrace::setThreadName(const std::string& name)
+	{
+		currentThreadName = name;
+		if (currentThreadTrack)
+		{
+			std::lock_guard<std::mutex> lock(tracksMutex);
+			tracks[currentThreadTrack->getId()].name = name;
+		}
+	}
+
+	OegTraceTrack& OegTrace::createTrack(const std::string& name)
+	{
+		return addTrack(name);
+	}
+
+	void OegTrace::writeChromeTrace(const std::string& filepath, float seconds)
+	{
+		const uint64_t endNs = now();
+		const uint64_t windowNs = static_cast<uint64_t>(static_cast<double>(seconds) * 1000000000.0);
+		writeChromeTraceSince(filepath, endNs > windowNs ? endNs - windowNs : 0);
+	}
+
+	void OegTrace::writeChromeTraceSince(const std::string& filepath, uint64_t sinceNs,
+	                                     const std::vector<std::pair<std::string, std::string>>& metadata)
+	{
+		// the tracks themselves are never destroyed, only the list has to be read under the lock
+		std::vector<std::pair<const OegTraceTrack*, std::string>> snapshot;
+		{
+			std::lock_guard<std::mutex> lock(tracksMutex);
+			for (const TrackEntry& entry : tracks)
+			{
+				snapshot.emplace_back(entry.track.get(), entry.name);
+			}
+		}
+
+		std::ofstream file{filepath};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to write trace: " + filepath);
+		}
+
+		// microseconds, one tid per track
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\": \"ms\", \"otherData\": {";
+		for (size_t i = 0; i < metadata.size(); i++)
+		{
+			file << (i == 0 ? "" : ", ") << "\"" << escapeJson(metadata[i].first) << "\": \""
+				<< escapeJson(metadata[i].second) << "\"";
+		}
+		file << "}, \"traceEvents\": [\n";
+		bool first = true;
+		for (const auto& [track, name] : snapshot)
+		{
+			const std::string threadName = name.empty() ? "thread " + std::to_string(track->getId()) : name;
+			file << (first ? "" : ",\n")
+				<< "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track->getId()
+				<< ", \"args\": {\"name\": \"" << escapeJson(threadName) << "\"}}";
+			first = false;
+
+			for (const TraceEvent& event : track->copyEvents(sinceNs))
+			{
+				file << ",\n{\"name\": \"" << escapeJson(event.name) << "\", \"pid\": 1, \"tid\": " << track->getId()
+					<< ", \"ts\": " << static_cast<double>(event.startNs) / 1000.0;
+				switch (event.kind)
+				{
+				case TraceEventKind::Zone:
+					file << ", \"ph\": \"X\", \"dur\": " << static_cast<double>(event.durationNs) / 1000.0 << "}";
+					break;
+				case TraceEventKind::Instant:
+					file << ", \"ph\": \"i\", \"s\": \"t\", \"args\": {\"value\": " << event.value << "}}";
+					break;
+				case TraceEventKind::Counter:
+					file << ", \"ph\": \"C\", \"args\": {\"value\": " << event.value << "}}";
+					break;
+				}
+			}
+		}
+		file << "\n]}\n";
+	}
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace oeg
+{
+	enum class TraceEventKind : uint8_t
+	{
+		// a timed scope
+		Zone,
+		// a point in time with a value, like the size of an allocation
+		Instant,
+		// the new value of a running total, like the bytes uploaded in a frame
+		Counter
+	};
+
+	struct TraceEvent
+	{
+		// a literal, events only keep the pointer
+		const char* name{nullptr};
+		// nanoseconds of OegTrace::now
+		uint64_t startNs{0};
+		uint64_t durationNs{0};
+		TraceEventKind kind{TraceEventKind::Zone};
+		uint64_t value{0};
+	};
+
+	/**
+	 * Ring of the newest events of one timeline. Exactly one thread records into a track, without
+	 * locks; any thread can copy the events out while it does. Every slot carries a sequence number
+	 * that is odd while the slot is written and names the event it holds otherwise, so events the
+	 * recording thread overwrites or is writing during a copy are left out of it.
+	 */
+	class OegTraceTrack
+	{
+	public:
+		static constexpr uint64_t CAPACITY = 1 << 15;
+
+		explicit OegTraceTrack(uint32_t id);
+
+		OegTraceTrack(const OegTraceTrack&) = delete;
+		OegTraceTrack& operator=(const OegTraceTrack&) = delete;
+
+		void record(const TraceEvent& event)
+		{
+			const uint64_t index = head.load(std::memory_order_relaxed);
+			Slot& slot = slots[index % CAPACITY];
+			slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.name.store(event.name, std::memory_order_relaxed);
+			slot.startNs.store(event.startNs, std::memory_order_relaxed);
+			slot.durationNs.store(event.durationNs, std::memory_order_relaxed);
+			slot.kind.store(event.kind, std::memory_order_relaxed);
+			slot.value.store(event.value, std::memory_order_relaxed);
+			slot.sequence.store(2 * index + 2, std::memory_order_release);
+			head.store(index + 1, std::memory_order_release);
+		}
+
+		// events that ended at or after sinceNs, in the order they ended
+		std::vector<TraceEvent> copyEvents(uint64_t sinceNs) const;
+
+		uint32_t getId() const { return id; }
+
+	private:
+		// fields are atomic so copies can read them while the recording thread writes
+		struct Slot
+		{
+			// 2 * index + 2 once event index is complete
+			std::atomic<uint64_t> sequence{0};
+			std::atomic<const char*> name{nullptr};
+			std::atomic<uint64_t> startNs{0};
+			std::atomic<uint64_t> durationNs{0};
+			std::atomic<TraceEventKind> kind{TraceEventKind::Zone};
+			std::atomic<uint64_t> value{0};
+		};
+
+		uint32_t id;
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<uint64_t> head{0};
+	};
+
+	/**
+	 * Process wide CPU trace. Every thread that records gets its own track on its first zone, other
+	 * timelines like the GPU's get one from createTrack. Recording is off until setEnabled, a zone then
+	 * costs a relaxed load and a branch.
+	 */
+	class OegTrace
+	{
+	public:
+		static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+		static void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+		// monotonic nanoseconds, shared by every track
+		static uint64_t now();
+
+		// the calling thread's track, created on first use
+		static OegTraceTrack& threadTrack();
+		// names the calling thread's track in the trace, may be called before the track exists
+		static void setThreadName(const std::string& name);
+		// for a timeline that is not a thread, recorded by one thread at a time
+		static OegTraceTrack& createTrack(const std::string& name);
+
+		// the events of every track that ended in the last seconds, for chrome://tracing or Perfetto
+		static void writeChromeTrace(const std::string& filepath, float seconds);
+		// the events that ended at or after sinceNs, metadata goes to the trace's otherData
+		static void writeChromeTraceSince(const std::string& filepath, uint64_t sinceNs,
+		                                  const std::vector<std::pair<std::string, std::string>>& metadata = {});
+
+		// an instant or counter event on the calling thread's track, use OEG_TRACE_INSTANT and OEG_TRACE_COUNTER
+		static void recordValue(const char* name, TraceEventKind kind, uint64_t value)
+		{
+			if (isEnabled())
+			{
+				threadTrack().record(TraceEvent{name, now(), 0, kind, value});
+			}
+		}
+
+	private:
+		static inline std::atomic<bool> enabled{false};
+	};
+
+	// times the enclosing scope on the calling thread's track, use OEG_TRACE_ZONE
+	class OegTraceZone
+	{
+	public:
+		explicit OegTraceZone(const char* name)
+			: name{name}, recording{OegTrace::isEnabled()}
+		{
+			if (recording)
+			{
+				startNs = OegTrace::now();
+			}
+		}
+
+		~OegTraceZone()
+		{
+			if (recording)
+			{
+				OegTrace::threadTrack().record(TraceEvent{name, startNs, OegTrace::now() - startNs});
+			}
+		}
+
+		OegTraceZone(const OegTraceZone&) = delete;
+		OegTraceZone& operator=(const OegTraceZone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t startNs{0};
+		bool recording;
+	};
+}
+
+#define OEG_TRACE_CONCAT_INNER(a, b) a##b
+#define OEG_TRACE_CONCAT(a, b) OEG_TRACE_CONCAT_INNER(a, b)
+// name has to be a literal
+#define OEG_TRACE_ZONE(name) ::oeg::OegTraceZone OEG_TRACE_CONCAT(oegTraceZone, __LINE__){name}
+#define OEG_TRACE_INSTANT(name, value) ::oeg::OegTrace::recordValue(name, ::oeg::TraceEventKind::Instant, value)
+#define OEG_TRACE_COUNTER(name, value) ::oeg::OegTrace::recordValue(name, ::oeg::TraceEventKind::Counter, value)
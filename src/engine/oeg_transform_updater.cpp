@@ -0,0 +1,210 @@
+#include "oeg_transform_updater.h"
+#include "oeg_job_system.h"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+// SIMD, AVX2 when the compiler targets it (/arch:AVX2, -mavx2), otherwise SSE2 which every x64 cpu has.
+// Plain AVX is not enough, the quadrant selection needs 256 bit integer ops
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OEG_TRANSFORM_AVX2
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OEG_TRANSFORM_SSE
+#endif
+
+namespace oeg
+{
+	namespace
+	{
+		// pi / 2 split in three so j * part stays exact in float for every j we reduce with (cephes)
+		constexpr float PI_2_PART1 = 1.5703125f;
+		constexpr float PI_2_PART2 = 4.837512969970703125e-4f;
+		constexpr float PI_2_PART3 = 7.54978995489188216e-8f;
+		constexpr float TWO_OVER_PI = 0.636619772367581343f;
+
+		// minimax polynomials on [-pi/4, pi/4]
+		constexpr float SIN_C0 = -1.6666654611e-1f;
+		constexpr float SIN_C1 = 8.3321608736e-3f;
+		constexpr float SIN_C2 = -1.9515295891e-4f;
+		constexpr float COS_C0 = 4.166664568298827e-2f;
+		constexpr float COS_C1 = -1.388731625493765e-3f;
+		constexpr float COS_C2 = 2.443315711809948e-5f;
+	}
+
+	/**
+		* Each angle is reduced to r in [-pi/4, pi/4] and a quadrant q, both polynomials are evaluated
+		* for r, then q picks which one is the sine and which signs to flip. No branches, so every lane
+		* of a batch takes the same path.
+	*/
+	void OegTransformUpdater::sinCos(const float* angles, float* sines, float* cosines, size_t count)
+	{
+		assert(count % BATCH_WIDTH == 0);
+
+#if defined(OEG_TRANSFORM_AVX2)
+		for (size_t i = 0; i < count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(angles + i);
+			const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+			const __m256 j = _mm256_cvtepi32_ps(quadrant);
+
+			__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(PI_2_PART1)));
+			r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PI_2_PART2)));
+			r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PI_2_PART3)));
+			const __m256 r2 = _mm256_mul_ps(r, r);
+
+			__m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(SIN_C2)), _mm256_set1_ps(SIN_C1));
+			sinPoly = _mm256_add_ps(_mm256_mul_ps(r2, sinPoly), _mm256_set1_ps(SIN_C0));
+			sinPoly = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r2, r), sinPoly));
+
+			__m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(COS_C2)), _mm256_set1_ps(COS_C1));
+			cosPoly = _mm256_add_ps(_mm256_mul_ps(r2, cosPoly), _mm256_set1_ps(COS_C0));
+			cosPoly = _mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly);
+			cosPoly = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), cosPoly);
+
+			// odd quadrants swap sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+			const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+				_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+			const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+				_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+			const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+				_mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+
+			const __m256 sine = _mm256_blendv_ps(sinPoly, cosPoly, swap);
+			const __m256 cosine = _mm256_blendv_ps(cosPoly, sinPoly, swap);
+			_mm256_storeu_ps(sines + i, _mm256_xor_ps(sine, sinSign));
+			_mm256_storeu_ps(cosines + i, _mm256_xor_ps(cosine, cosSign));
+		}
+#elif defined(OEG_TRANSFORM_SSE)
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(angles + i);
+			const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+			const __m128 j = _mm_cvtepi32_ps(quadrant);
+
+			__m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(PI_2_PART1)));
+			r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PI_2_PART2)));
+			r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PI_2_PART3)));
+			const __m128 r2 = _mm_mul_ps(r, r);
+
+			__m128 sinPoly = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(SIN_C2)), _mm_set1_ps(SIN_C1));
+			sinPoly = _mm_add_ps(_mm_mul_ps(r2, sinPoly), _mm_set1_ps(SIN_C0));
+			sinPoly = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r2, r), sinPoly));
+
+			__m128 cosPoly = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(COS_C2)), _mm_set1_ps(COS_C1));
+			cosPoly = _mm_add_ps(_mm_mul_ps(r2, cosPoly), _mm_set1_ps(COS_C0));
+			cosPoly = _mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly);
+			cosPoly = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), cosPoly);
+
+			// odd quadrants swap sine and cosine, quadrants 2 and 3 negate the sine, 1 and 2 the cosine
+			const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(
+				_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+			const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(
+				_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+			const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+				_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+
+			// no blendv before SSE4.1
+			const __m128 sine = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+			const __m128 cosine = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+			_mm_storeu_ps(sines + i, _mm_xor_ps(sine, sinSign));
+			_mm_storeu_ps(cosines + i, _mm_xor_ps(cosine, cosSign));
+		}
+#else
+		for (size_t i = 0; i < count; i++)
+		{
+			sines[i] = std::sin(angles[i]);
+			cosines[i] = std::cos(angles[i]);
+		}
+#endif
+	}
+
+	/**
+		* Works on dirty slots [begin, end), so workers only touch their own part of the angle arrays
+		* and their own transforms. Slots past the dirty count are padding and only run through sinCos.
+	*/
+	void OegTransformUpdater::rebuildRange(std::vector<TransformComponent>& transforms, size_t begin, size_t end)
+	{
+		assert(begin % BATCH_WIDTH == 0 && end % BATCH_WIDTH == 0);
+
+		const size_t dirtyCount = dirtyIndices.size();
+		const size_t paddedCount = angles.size() / 3;
+		float* anglesX = angles.data();
+		float* anglesY = anglesX + paddedCount;
+		float* anglesZ = anglesY + paddedCount;
+
+		const size_t gatherEnd = std::min(end, dirtyCount);
+		for (size_t i = begin; i < gatherEnd; i++)
+		{
+			const glm::vec3& rotation = transforms[dirtyIndices[i]].getRotation();
+			anglesX[i] = rotation.x;
+			anglesY[i] = rotation.y;
+			anglesZ[i] = rotation.z;
+		}
+
+		for (size_t axis = 0; axis < 3; axis++)
+		{
+			const size_t offset = axis * paddedCount + begin;
+			sinCos(angles.data() + offset, sines.data() + offset, cosines.data() + offset, end - begin);
+		}
+
+		for (size_t i = begin; i < gatherEnd; i++)
+		{
+			transforms[dirtyIndices[i]].rebuild(
+				sines[i], cosines[i],
+				sines[paddedCount + i], cosines[paddedCount + i],
+				sines[2 * paddedCount + i], cosines[2 * paddedCount + i]);
+		}
+	}
+
+	void OegTransformUpdater::update(std::vector<TransformComponent>& transforms)
+	{
+		const auto startTime = std::chrono::high_resolution_clock::now();
+
+		// consecutive dirty objects merge into one range, so a scene that moves everything uploads once
+		dirtyIndices.clear();
+		dirtyRanges.clear();
+		for (uint32_t i = 0; i < transforms.size(); i++)
+		{
+			if (!transforms[i].isDirty())
+			{
+				continue;
+			}
+			dirtyIndices.push_back(i);
+			if (!dirtyRanges.empty() && dirtyRanges.back().first + dirtyRanges.back().count == i)
+			{
+				dirtyRanges.back().count++;
+			}
+			else
+			{
+				dirtyRanges.push_back(DirtyRange{i, 1});
+			}
+		}
+
+		const size_t dirtyCount = dirtyIndices.size();
+		const size_t paddedCount = (dirtyCount + BATCH_WIDTH - 1) / BATCH_WIDTH * BATCH_WIDTH;
+		// padding lanes keep angle 0 so they never produce NaNs
+		angles.assign(3 * paddedCount, 0.0f);
+		sines.resize(3 * paddedCount);
+		cosines.resize(3 * paddedCount);
+
+		// whole batches per job
+		OegJobSystem::get().parallelFor(
+			paddedCount / BATCH_WIDTH,
+			PARALLEL_THRESHOLD / BATCH_WIDTH,
+			[this, &transforms](size_t beginBatch, size_t endBatch)
+			{
+				rebuildRange(transforms, beginBatch * BATCH_WIDTH, endBatch * BATCH_WIDTH);
+			});
+
+		const auto endTime = std::chrono::high_resolution_clock::now();
+		stats.objectCount = static_cast<uint32_t>(transforms.size());
+		stats.dirtyCount = static_cast<uint32_t>(dirtyCount);
+		stats.rangeCount = static_cast<uint32_t>(dirtyRanges.size());
+		stats.rebuildTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "oeg_game_object.h"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace oeg
+{
+	// [first, first + count) in the registry's dense component arrays
+	struct DirtyRange
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	struct TransformStats
+	{
+		uint32_t objectCount{0};
+		uint32_t dirtyCount{0};
+		uint32_t rangeCount{0};
+		float rebuildTimeMs{0.0f};
+	};
+
+	/**
+	 * Rebuilds the cached matrices of every transform that changed since the last update. The
+	 * rotation angles of the dirty transforms are gathered into one array so their sines and
+	 * cosines are computed 8 (AVX2) or 4 (SSE) at a time, and large dirty sets are split across
+	 * worker threads. What changed is reported as a list of index ranges, so GPU copies of the
+	 * transforms only need to re-upload those.
+	 */
+	class OegTransformUpdater
+	{
+	public:
+		// smallest run of dirty transforms handed to a job, fewer stay on the calling thread
+		static constexpr size_t PARALLEL_THRESHOLD = 4096;
+		static constexpr size_t BATCH_WIDTH = 8;
+
+		// transforms is the registry's dense transform view, ranges index into it
+		void update(std::vector<TransformComponent>& transforms);
+
+		// sorted and non overlapping, valid until the next update
+		const std::vector<DirtyRange>& getDirtyRanges() const { return dirtyRanges; }
+		const TransformStats& getStats() const { return stats; }
+
+		/**
+		 * \brief sines[i] = sin(angles[i]), cosines[i] = cos(angles[i]), count must be a multiple of BATCH_WIDTH.
+		 * Accurate to a few ulp for the angle range transforms use (|angle| < 10^4)
+		 */
+		static void sinCos(const float* angles, float* sines, float* cosines, size_t count);
+
+	private:
+		// gathers, computes and writes back dirty transforms [begin, end), multiples of BATCH_WIDTH
+		void rebuildRange(std::vector<TransformComponent>& transforms, size_t begin, size_t end);
+
+		std::vector<uint32_t> dirtyIndices;
+		std::vector<DirtyRange> dirtyRanges;
+
+		// rotation x of every dirty transform, then all y, then all z, each padded to BATCH_WIDTH
+		std::vector<float> angles;
+		std::vector<float> sines;
+		std::vector<float> cosines;
+
+		TransformStats stats{};
+	};
+}
@@ -4,21 +4,30 @@
 namespace oeg
 {
 	// Constructor
-	OegWindow::OegWindow(int w, int h, std::string winName)
-		: width{w}, height{h}, windowName{std::move(winName)}
+	OegWindow::OegWindow(int w, int h, std::string winName, bool headless)
+		: width{w}, height{h}, windowName{std::move(winName)}, headless{headless}
 	{
-		initWindow();
+		if (!headless)
+		{
+			initWindow();
+		}
 	}
 
 	// Destructor
 	OegWindow::~OegWindow()
 	{
 		ImGui_ImplVulkan_Shutdown();
-		ImGui_ImplGlfw_Shutdown();
+		if (!headless)
+		{
+			ImGui_ImplGlfw_Shutdown();
+		}
 		ImGui::DestroyContext();
 
-		glfwDestroyWindow(window);
-		glfwTerminate();
+		if (!headless)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
 	}
 
 	// Initialize GLFW window
@@ -36,7 +45,7 @@ namespace oeg
 	// Initialize ImGui for Vulkan
 	void OegWindow::initImGui(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device,
 	                          uint32_t queueFamily, VkQueue queue, VkRenderPass renderPass,
-	                          uint32_t minImageCount) const
+	                          uint32_t minImageCount, VkPipelineCache pipelineCache) const
 	{
 		// Initialize ImGui context
 		IMGUI_CHECKVERSION();
@@ -45,8 +54,11 @@ namespace oeg
 		ImGui::StyleColorsDark();
 		io.Fonts->AddFontDefault();
 
-		// Setup Platform bindings
-		ImGui_ImplGlfw_InitForVulkan(window, true);
+		// Setup Platform bindings, without a window the display size and frame time are set every frame
+		if (!headless)
+		{
+			ImGui_ImplGlfw_InitForVulkan(window, true);
+		}
 
 		// Descriptor Pool for ImGui
 		const VkDescriptorPoolSize poolSizes[] = {
@@ -83,7 +95,7 @@ namespace oeg
 		init_info.Device = device;
 		init_info.QueueFamily = queueFamily;
 		init_info.Queue = queue;
-		init_info.PipelineCache = VK_NULL_HANDLE;
+		init_info.PipelineCache = pipelineCache;
 		init_info.DescriptorPool = imguiPool;
 		init_info.MinImageCount = minImageCount;
 		init_info.ImageCount = minImageCount; // Adjust with your swap chain image count
@@ -106,9 +118,9 @@ namespace oeg
 	void OegWindow::framebufferResizedCallback(GLFWwindow* window, int width, int height)
 	{
 		const auto oegWindow = static_cast<OegWindow*>(glfwGetWindowUserPointer(window));
-		oegWindow->framebufferResized = true;
 		oegWindow->width = width;
 		oegWindow->height = height;
+		oegWindow->framebufferResized = true;
 	}
 
 	// Load custom fonts for ImGui
@@ -6,14 +6,21 @@
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
+
+// std
+#include <atomic>
 #include <string>
 
 namespace oeg
 {
+	/**
+	 * GLFW window the swapchain presents to. A headless window creates no GLFW window at all, it only
+	 * carries the size of the offscreen target, see OegSwapChain
+	 */
 	class OegWindow
 	{
 	public:
-		OegWindow(int w, int h, std::string winName);
+		OegWindow(int w, int h, std::string winName, bool headless = false);
 		~OegWindow();
 
 		OegWindow(const OegWindow&) = delete;
@@ -21,11 +28,15 @@ namespace oeg
 
 		void initImGui(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamily,
 		               VkQueue queue, VkRenderPass
-		               renderPass, uint32_t minImageCount) const;
+		               renderPass, uint32_t minImageCount, VkPipelineCache pipelineCache) const;
 
-		bool shouldClose() { return glfwWindowShouldClose(window); }
-		VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}; }
-		bool wasWindowResized() { return framebufferResized; }
+		bool isHeadless() const { return headless; }
+		// a headless window is only closed by whoever runs the frame loop
+		bool shouldClose() { return !headless && glfwWindowShouldClose(window); }
+		// size and resize flag are written by GLFW on the main thread and read by the render thread
+		VkExtent2D getExtent() const { return {static_cast<uint32_t>(width.load()), static_cast<uint32_t>(height.load())}; }
+		bool isMinimized() const { return width.load() == 0 || height.load() == 0; }
+		bool wasWindowResized() const { return framebufferResized.load(); }
 		void resetWindowResiedFlag() { framebufferResized = false; }
 		GLFWwindow* getGLFWWindow() const { return window; }
 
@@ -42,12 +53,13 @@ namespace oeg
 		void initWindow();
 
 
-		int width;
-		int height;
-		bool framebufferResized = false;
+		std::atomic<int> width;
+		std::atomic<int> height;
+		std::atomic<bool> framebufferResized{false};
 
 		std::string windowName;
-		GLFWwindow* window;
+		bool headless;
+		GLFWwindow* window{nullptr};
 		mutable ImFontAtlas* imguiFontAtlas;
 	};
 }
@@ -1,3 +1,8 @@
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\simple_shader.vert -o shaders\simple_shader.vert.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\simple_shader.frag -o shaders\simple_shader.frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\packed_transform_shader.vert -o shaders\packed_transform_shader.vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\gpu_driven_shader.vert -o shaders\gpu_driven_shader.vert.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\gpu_driven_shader.frag -o shaders\gpu_driven_shader.frag.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\gpu_cull.comp -o shaders\gpu_cull.comp.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shaders\depth_reduce.comp -o shaders\depth_reduce.comp.spv
 pause
\ No newline at end of file
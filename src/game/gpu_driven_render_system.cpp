@@ -0,0 +1,688 @@
+#include "gpu_driven_render_system.h"
+
+#include "../engine/oeg_swap_chain.h"
+#include "../engine/oeg_trace.h"
+
+// 3rd party
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace oeg
+{
+	// std430 layout, must match ObjectData in gpu_cull.comp and gpu_driven_shader.vert
+	struct GpuObjectData
+	{
+		glm::mat4 modelMatrix{1.f};
+		glm::mat4 normalMatrix{1.f};
+		glm::vec4 boundingSphere{0.f};
+		glm::uvec4 drawInfo{0u}; // x = batch index, y = slot within the batch
+	};
+
+	struct GpuBatchData
+	{
+		uint32_t firstCommand;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+	};
+
+	// std140 layout, must match CullData in gpu_cull.comp
+	struct GpuCullData
+	{
+		glm::vec4 frustumPlanes[6];
+		glm::mat4 view{1.f};
+		glm::vec4 projection{0.f}; // P00, P11, P22, P32
+		glm::vec4 pyramid{0.f}; // width, height, mip count, near plane
+		uint32_t objectCount;
+		uint32_t objectCapacity;
+		uint32_t compact;
+		uint32_t occlusionEnabled;
+	};
+
+	// must match StatsBuffer in gpu_cull.comp
+	struct GpuCullStats
+	{
+		uint32_t frustumCulledCount;
+		uint32_t occludedCount;
+		uint32_t earlyDrawCount;
+		uint32_t lateDrawCount;
+	};
+
+	struct CullPushConstantData
+	{
+		uint32_t phase;
+	};
+
+	static constexpr uint32_t NO_SLOT = ~0u;
+
+	GpuDrivenRenderSystem::GpuDrivenRenderSystem(
+		OegDevice& device,
+		VkRenderPass renderPass,
+		VkDescriptorSetLayout globalSetLayout,
+		OegPipelineManager& pipelineManager)
+		: oegDevice{device}, pipelineManager{pipelineManager}, useDrawCount{device.supportsDrawIndirectCount()}
+	{
+		assert(isSupported(device) && "GPU driven rendering needs multiDrawIndirect and drawIndirectFirstInstance");
+		createDescriptorSetLayout();
+		createPipelineLayouts(globalSetLayout);
+		createPipelines(renderPass);
+		createDescriptorPool();
+		createFrameBuffers(1);
+
+		depthPyramid = std::make_unique<OegDepthPyramid>(oegDevice, "shaders/depth_reduce.comp.spv");
+		statsWritten.assign(OegSwapChain::MAX_FRAMES_IN_FLIGHT, false);
+		pendingRanges.resize(OegSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		cullDataBuffer = std::make_unique<OegBuffer>(
+			oegDevice,
+			sizeof(GpuCullData),
+			OegSwapChain::MAX_FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			oegDevice.getAllocator(),
+			oegDevice.properties.limits.minUniformBufferOffsetAlignment);
+		cullDataBuffer->map();
+
+		for (int i = 0; i < OegSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			statsBuffers.push_back(std::make_unique<OegBuffer>(
+				oegDevice,
+				sizeof(GpuCullStats),
+				1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				oegDevice.getAllocator(),
+				1));
+			statsBuffers.back()->map();
+		}
+		// descriptor sets are written once the depth pyramid exists, see updateDepthPyramid
+	}
+
+	GpuDrivenRenderSystem::~GpuDrivenRenderSystem()
+	{
+		pipelineManager.waitIdle();
+		vkDestroyDescriptorPool(oegDevice.device(), descriptorPool, nullptr);
+		vkDestroyPipelineLayout(oegDevice.device(), pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(oegDevice.device(), cullPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(oegDevice.device(), descriptorSetLayout, nullptr);
+	}
+
+	bool GpuDrivenRenderSystem::isSupported(OegDevice& device)
+	{
+		return device.supportsMultiDrawIndirect() && device.supportsDrawIndirectFirstInstance();
+	}
+
+	void GpuDrivenRenderSystem::createDescriptorSetLayout()
+	{
+		// 0 objects, 1 batches, 2 draw commands, 3 draw counts, 4 visibility, 5 stats, 6 cull data, 7 depth pyramid
+		std::array<VkDescriptorSetLayoutBinding, 8> bindings{};
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		// objects are also read by the vertex shader
+		bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		if (vkCreateDescriptorSetLayout(oegDevice.device(), &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+	}
+
+	void GpuDrivenRenderSystem::createPipelineLayouts(VkDescriptorSetLayout globalSetLayout)
+	{
+		// the camera comes from the GlobalUbo rather than a push constant, so it can still change after recording
+		const std::array<VkDescriptorSetLayout, 2> setLayouts{descriptorSetLayout, globalSetLayout};
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		if (vkCreatePipelineLayout(oegDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		VkPushConstantRange cullPushConstantRange{
+			// in order: stageFlags, offset, size
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(CullPushConstantData)
+		};
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+		if (vkCreatePipelineLayout(oegDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create cull pipeline layout!");
+		}
+	}
+
+	void GpuDrivenRenderSystem::createPipelines(VkRenderPass renderPass)
+	{
+		PipelineConfigInfo pipelineConfig{};
+		OegPipeline::defaultPipelineConfigInfo(pipelineConfig);
+		pipelineConfig.renderPass = renderPass;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipeline = pipelineManager.createPipeline(
+			"shaders/gpu_driven_shader.vert.spv",
+			"shaders/gpu_driven_shader.frag.spv",
+			pipelineConfig);
+
+		cullPipeline = std::make_unique<OegComputePipeline>(
+			oegDevice,
+			"shaders/gpu_cull.comp.spv",
+			cullPipelineLayout);
+	}
+
+	void GpuDrivenRenderSystem::createDescriptorPool()
+	{
+		std::array<VkDescriptorPoolSize, 3> poolSizes{{
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * OegSwapChain::MAX_FRAMES_IN_FLIGHT},
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, OegSwapChain::MAX_FRAMES_IN_FLIGHT},
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, OegSwapChain::MAX_FRAMES_IN_FLIGHT},
+		}};
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = OegSwapChain::MAX_FRAMES_IN_FLIGHT;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (vkCreateDescriptorPool(oegDevice.device(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor pool!");
+		}
+
+		std::vector<VkDescriptorSetLayout> layouts(OegSwapChain::MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+		allocInfo.pSetLayouts = layouts.data();
+
+		descriptorSets.resize(layouts.size());
+		if (vkAllocateDescriptorSets(oegDevice.device(), &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor sets!");
+		}
+	}
+
+	/**
+		* (Re)creates the storage buffers for up to objectCapacity objects. Batches and visibility are
+		* shared by all frames. Objects are rewritten by the CPU while earlier frames may still read
+		* them, and draw commands and counts are written by the GPU, so each frame in flight gets its
+		* own of those, the command and count buffers with room for both the early and the late phase.
+	*/
+	void GpuDrivenRenderSystem::createFrameBuffers(uint32_t capacity)
+	{
+		objectCapacity = capacity;
+
+		// there are never more batches than objects
+		batchBuffer = std::make_unique<OegBuffer>(
+			oegDevice,
+			sizeof(GpuBatchData),
+			objectCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			oegDevice.getAllocator(),
+			1);
+		batchBuffer->map();
+
+		visibilityBuffer = std::make_unique<OegBuffer>(
+			oegDevice,
+			sizeof(uint32_t),
+			objectCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			oegDevice.getAllocator(),
+			1);
+		visibilityBuffer->map();
+
+		objectBuffers.clear();
+		drawCommandBuffers.clear();
+		drawCountBuffers.clear();
+		for (int i = 0; i < OegSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			objectBuffers.push_back(std::make_unique<OegBuffer>(
+				oegDevice,
+				sizeof(GpuObjectData),
+				objectCapacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				oegDevice.getAllocator(),
+				1));
+			objectBuffers.back()->map();
+			drawCommandBuffers.push_back(std::make_unique<OegBuffer>(
+				oegDevice,
+				sizeof(VkDrawIndexedIndirectCommand),
+				objectCapacity * 2,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				oegDevice.getAllocator(),
+				1));
+			drawCountBuffers.push_back(std::make_unique<OegBuffer>(
+				oegDevice,
+				sizeof(uint32_t),
+				objectCapacity * 2,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				oegDevice.getAllocator(),
+				1));
+		}
+	}
+
+	void GpuDrivenRenderSystem::writeDescriptorSets()
+	{
+		// binding 7 can only be written once the pyramid exists
+		if (depthPyramid->getMipCount() == 0)
+		{
+			return;
+		}
+
+		const VkDescriptorImageInfo pyramidInfo = depthPyramid->descriptorInfo();
+		for (size_t i = 0; i < descriptorSets.size(); i++)
+		{
+			std::array<VkDescriptorBufferInfo, 7> bufferInfos{
+				objectBuffers[i]->descriptorInfo(),
+				batchBuffer->descriptorInfo(),
+				drawCommandBuffers[i]->descriptorInfo(),
+				drawCountBuffers[i]->descriptorInfo(),
+				visibilityBuffer->descriptorInfo(),
+				statsBuffers[i]->descriptorInfo(),
+				cullDataBuffer->descriptorInfoForIndex(static_cast<int>(i)),
+			};
+
+			std::array<VkWriteDescriptorSet, 8> writes{};
+			for (uint32_t binding = 0; binding < writes.size(); binding++)
+			{
+				writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				writes[binding].dstSet = descriptorSets[i];
+				writes[binding].dstBinding = binding;
+				writes[binding].descriptorCount = 1;
+				writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				if (binding < bufferInfos.size())
+				{
+					writes[binding].pBufferInfo = &bufferInfos[binding];
+				}
+			}
+			writes[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			writes[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[7].pImageInfo = &pyramidInfo;
+			vkUpdateDescriptorSets(oegDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+	}
+
+	void GpuDrivenRenderSystem::updateDepthPyramid(
+		VkExtent2D depthExtent,
+		VkFormat depthFormat,
+		const std::vector<VkImageView>& depthViews)
+	{
+		if (depthPyramid->update(depthExtent, depthFormat, depthViews))
+		{
+			writeDescriptorSets();
+		}
+	}
+
+	void SceneChanges::capture(
+		const OegRegistry& registry,
+		const std::vector<DirtyRange>& worldDirty,
+		bool changedLayout)
+	{
+		const std::vector<WorldTransform>& worldTransforms = registry.getWorldTransforms();
+		layoutChanged = changedLayout;
+		models.clear();
+		dirtyRanges.clear();
+		transforms.clear();
+
+		if (layoutChanged)
+		{
+			models = registry.getModels();
+			transforms = worldTransforms;
+			return;
+		}
+
+		dirtyRanges = worldDirty;
+		for (const DirtyRange& range : worldDirty)
+		{
+			transforms.insert(
+				transforms.end(),
+				worldTransforms.begin() + range.first,
+				worldTransforms.begin() + range.first + range.count);
+		}
+	}
+
+	void GpuDrivenRenderSystem::applySceneChanges(const SceneChanges& changes)
+	{
+		// dense indices moved, the slot mapping and batches are stale
+		if (changes.layoutChanged)
+		{
+			models = changes.models;
+			worldTransforms = changes.transforms;
+			uploadGameObjects();
+			return;
+		}
+
+		size_t transformIndex = 0;
+		for (const DirtyRange& range : changes.dirtyRanges)
+		{
+			std::copy_n(
+				changes.transforms.begin() + transformIndex,
+				range.count,
+				worldTransforms.begin() + range.first);
+			transformIndex += range.count;
+		}
+
+		for (auto& ranges : pendingRanges)
+		{
+			ranges.insert(ranges.end(), changes.dirtyRanges.begin(), changes.dirtyRanges.end());
+		}
+	}
+
+	void GpuDrivenRenderSystem::uploadGameObjects()
+	{
+		// the buffers may still be read by frames in flight
+		vkDeviceWaitIdle(oegDevice.device());
+
+		batches.clear();
+		objectSlots.assign(models.size(), NO_SLOT);
+
+		std::unordered_map<OegModel*, uint32_t> batchIndices;
+		std::vector<GpuObjectData> objectData;
+		objectData.reserve(models.size());
+
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			const std::shared_ptr<OegModel>& model = models[i];
+			if (model == nullptr)
+			{
+				continue;
+			}
+			objectSlots[i] = static_cast<uint32_t>(objectData.size());
+			assert(model->hasIndices() && "GPU driven rendering only draws indexed models");
+
+			auto [it, inserted] = batchIndices.try_emplace(model.get(), static_cast<uint32_t>(batches.size()));
+			if (inserted)
+			{
+				batches.push_back({model, 0, 0});
+			}
+			Batch& batch = batches[it->second];
+
+			const BoundingSphere& sphere = model->getBoundingSphere();
+			GpuObjectData data{};
+			data.modelMatrix = worldTransforms[i].modelMatrix;
+			data.normalMatrix = glm::mat4{worldTransforms[i].normalMatrix};
+			data.boundingSphere = glm::vec4{sphere.center, sphere.radius};
+			data.drawInfo = glm::uvec4{it->second, batch.objectCount++, 0u, 0u};
+			objectData.push_back(data);
+		}
+
+		objectCount = static_cast<uint32_t>(objectData.size());
+		if (objectCount > objectCapacity)
+		{
+			createFrameBuffers(std::max(objectCount, objectCapacity * 2));
+			writeDescriptorSets();
+		}
+
+		// every batch owns a contiguous range of draw commands, one per object
+		std::vector<GpuBatchData> batchData;
+		batchData.reserve(batches.size());
+		uint32_t firstCommand = 0;
+		for (auto& batch : batches)
+		{
+			batch.firstCommand = firstCommand;
+			firstCommand += batch.objectCount;
+			batchData.push_back({batch.firstCommand, batch.model->getIndexCount(), 0, 0});
+		}
+
+		if (objectCount > 0)
+		{
+			for (auto& objectBuffer : objectBuffers)
+			{
+				objectBuffer->writeToBuffer(objectData.data(), objectData.size() * sizeof(GpuObjectData));
+				objectBuffer->flush();
+			}
+			batchBuffer->writeToBuffer(batchData.data(), batchData.size() * sizeof(GpuBatchData));
+			batchBuffer->flush();
+
+			// slots are reassigned, so nothing counts as drawn last frame
+			std::memset(visibilityBuffer->getMappedMemory(), 0, objectCount * sizeof(uint32_t));
+			OegBuffer::countUpload(objectCount * sizeof(uint32_t));
+			visibilityBuffer->flush();
+		}
+
+		// every frame's buffer now holds the current transforms
+		for (auto& ranges : pendingRanges)
+		{
+			ranges.clear();
+		}
+	}
+
+	/**
+		* Dense indices map to slots in increasing order, so a dirty range of entities stays one
+		* contiguous run of slots and is written and flushed in one go. Only the matrices are written,
+		* bounds and draw info do not change when an object moves.
+	*/
+	void GpuDrivenRenderSystem::updateTransforms(FrameInfo& frameInfo)
+	{
+		// this frame's fence has been waited on, its object buffer is no longer read
+		std::vector<DirtyRange>& ranges = pendingRanges[frameInfo.frameIndex];
+		OegBuffer& objectBuffer = *objectBuffers[frameInfo.frameIndex];
+		auto* objects = static_cast<GpuObjectData*>(objectBuffer.getMappedMemory());
+		for (const DirtyRange& range : ranges)
+		{
+			uint32_t firstSlot = NO_SLOT;
+			uint32_t lastSlot = 0;
+			for (uint32_t i = range.first; i < range.first + range.count && i < objectSlots.size(); i++)
+			{
+				const uint32_t slot = objectSlots[i];
+				if (slot == NO_SLOT)
+				{
+					continue;
+				}
+				objects[slot].modelMatrix = worldTransforms[i].modelMatrix;
+				objects[slot].normalMatrix = glm::mat4{worldTransforms[i].normalMatrix};
+				firstSlot = std::min(firstSlot, slot);
+				lastSlot = slot;
+			}
+
+			if (firstSlot != NO_SLOT)
+			{
+				const VkDeviceSize rangeSize = static_cast<VkDeviceSize>(lastSlot - firstSlot + 1) * sizeof(GpuObjectData);
+				objectBuffer.flush(rangeSize, static_cast<VkDeviceSize>(firstSlot) * sizeof(GpuObjectData));
+				OegBuffer::countUpload(rangeSize);
+			}
+		}
+		ranges.clear();
+	}
+
+	void GpuDrivenRenderSystem::writeCullData(FrameInfo& frameInfo)
+	{
+		const OegCamera& camera = frameInfo.camera;
+		const glm::mat4& projection = camera.getProjection();
+		const VkExtent2D pyramidExtent = depthPyramid->getExtent();
+
+		GpuCullData data{};
+		const auto planes = camera.getFrustumPlanes();
+		std::copy(planes.begin(), planes.end(), data.frustumPlanes);
+		data.view = camera.getView();
+		data.projection = glm::vec4{projection[0][0], projection[1][1], projection[2][2], projection[3][2]};
+		data.pyramid = glm::vec4{
+			static_cast<float>(pyramidExtent.width),
+			static_cast<float>(pyramidExtent.height),
+			static_cast<float>(depthPyramid->getMipCount()),
+			-projection[3][2] / projection[2][2]
+		};
+		data.objectCount = objectCount;
+		data.objectCapacity = objectCapacity;
+		data.compact = useDrawCount ? 1 : 0;
+		data.occlusionEnabled = enableOcclusionCulling ? 1 : 0;
+
+		cullDataBuffer->writeToIndex(&data, frameInfo.frameIndex);
+		cullDataBuffer->flushIndex(frameInfo.frameIndex);
+	}
+
+	void GpuDrivenRenderSystem::readOcclusionStats(int frameIndex)
+	{
+		// the fence of this frame index has been waited on, so the last results are complete
+		if (statsWritten[frameIndex])
+		{
+			GpuCullStats stats{};
+			statsBuffers[frameIndex]->invalidate();
+			std::memcpy(&stats, statsBuffers[frameIndex]->getMappedMemory(), sizeof(GpuCullStats));
+			occlusionStats.frustumCulledCount = stats.frustumCulledCount;
+			occlusionStats.occludedCount = stats.occludedCount;
+			occlusionStats.earlyDrawCount = stats.earlyDrawCount;
+			occlusionStats.lateDrawCount = stats.lateDrawCount;
+		}
+		statsWritten[frameIndex] = true;
+	}
+
+	void GpuDrivenRenderSystem::cullGameObjects(FrameInfo& frameInfo, CullPhase phase)
+	{
+		if (objectCount == 0)
+		{
+			return;
+		}
+		assert(depthPyramid->getMipCount() > 0 && "updateDepthPyramid must be called before culling");
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		if (phase == CullPhase::Early)
+		{
+			readOcclusionStats(frameInfo.frameIndex);
+			writeCullData(frameInfo);
+
+			vkCmdFillBuffer(commandBuffer, statsBuffers[frameInfo.frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+			if (useDrawCount)
+			{
+				vkCmdFillBuffer(commandBuffer, drawCountBuffers[frameInfo.frameIndex]->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+			}
+		}
+
+		// covers the fills above and the visibility written by the late phase of the previous frame
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			1, &cullBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		OegCommandRecorder& recorder = frameInfo.recorder;
+		cullPipeline->bind(recorder);
+		recorder.bindDescriptorSets(
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			cullPipelineLayout,
+			0,
+			1,
+			&descriptorSets[frameInfo.frameIndex]);
+
+		CullPushConstantData push{};
+		push.phase = static_cast<uint32_t>(phase);
+		recorder.pushConstants(
+			cullPipelineLayout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(CullPushConstantData),
+			&push);
+
+		recorder.dispatch((objectCount + 63) / 64, 1, 1);
+
+		// draw commands and counts feed the indirect draws, stats are read back next time this frame index comes up
+		VkMemoryBarrier indirectBarrier{};
+		indirectBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		indirectBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		indirectBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0,
+			1, &indirectBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
+	void GpuDrivenRenderSystem::buildDepthPyramid(FrameInfo& frameInfo, VkImage depthImage, uint32_t imageIndex)
+	{
+		depthPyramid->build(frameInfo.recorder, imageIndex, depthImage);
+	}
+
+	void GpuDrivenRenderSystem::renderGameObjects(FrameInfo& frameInfo, CullPhase phase)
+	{
+		OEG_TRACE_ZONE("renderGameObjects");
+		if (objectCount == 0)
+		{
+			return;
+		}
+
+		OegCommandRecorder& recorder = frameInfo.recorder;
+		VkBuffer drawCommandBuffer = drawCommandBuffers[frameInfo.frameIndex]->getBuffer();
+		VkBuffer drawCountBuffer = drawCountBuffers[frameInfo.frameIndex]->getBuffer();
+
+		pipelineManager.bind(pipeline, recorder);
+		const std::array<VkDescriptorSet, 2> sets{descriptorSets[frameInfo.frameIndex], frameInfo.globalDescriptorSet};
+		recorder.bindDescriptorSets(
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0,
+			static_cast<uint32_t>(sets.size()),
+			sets.data());
+
+		// each phase writes its own half of the command and count buffers
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const uint32_t phaseOffset = static_cast<uint32_t>(phase) * objectCapacity;
+		for (uint32_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+		{
+			const Batch& batch = batches[batchIndex];
+			batch.model->bind(recorder);
+
+			const VkDeviceSize commandOffset = static_cast<VkDeviceSize>(phaseOffset + batch.firstCommand) * stride;
+			if (useDrawCount)
+			{
+				recorder.drawIndexedIndirectCount(
+					drawCommandBuffer,
+					commandOffset,
+					drawCountBuffer,
+					(phaseOffset + batchIndex) * sizeof(uint32_t),
+					batch.objectCount,
+					stride);
+			}
+			else
+			{
+				// culled objects are written with instanceCount = 0
+				recorder.drawIndexedIndirect(
+					drawCommandBuffer,
+					commandOffset,
+					batch.objectCount,
+					stride);
+			}
+		}
+	}
+}
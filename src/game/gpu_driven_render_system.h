@@ -0,0 +1,152 @@
+#pragma once
+
+#include "../engine/oeg_buffer.h"
+#include "../engine/oeg_depth_pyramid.h"
+#include "../engine/oeg_device.h"
+#include "../engine/oeg_game_object.h"
+#include "../engine/oeg_registry.h"
+#include "../engine/oeg_pipeline.h"
+#include "../engine/oeg_pipeline_manager.h"
+#include "../engine/oeg_frame_info.h"
+#include "../engine/oeg_transform_updater.h"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace oeg
+{
+	enum class CullPhase : uint32_t
+	{
+		Early = 0, // objects visible last frame, drawn first to seed the depth buffer
+		Late = 1, // everything else, tested against the depth pyramid built from the early pass
+	};
+
+	struct OcclusionStats
+	{
+		uint32_t frustumCulledCount{0};
+		uint32_t occludedCount{0};
+		uint32_t earlyDrawCount{0};
+		uint32_t lateDrawCount{0};
+	};
+
+	/**
+	 * What changed in the scene since the previous snapshot. The render thread applies every snapshot's
+	 * changes in order, so it can keep its own copy of the world transforms without reading the registry.
+	 */
+	struct SceneChanges
+	{
+		// entities were created or destroyed, models and transforms hold every entity
+		bool layoutChanged{false};
+		std::vector<std::shared_ptr<OegModel>> models;
+		std::vector<DirtyRange> dirtyRanges;
+		// world transforms of the dirty ranges back to back, or of every entity after a layout change
+		std::vector<WorldTransform> transforms;
+
+		// on the simulation thread, worldDirty as in OegSceneGraph::getDirtyRanges
+		void capture(const OegRegistry& registry, const std::vector<DirtyRange>& worldDirty, bool changedLayout);
+	};
+
+	/**
+	 * Keeps per-object transforms and bounds in storage buffers and lets a compute pass frustum
+	 * cull them into VkDrawIndexedIndirectCommands. The CPU only records one indirect draw per
+	 * model, so its frame cost does not grow with the number of objects.
+	 *
+	 * With occlusion culling a frame is drawn in two phases: last frame's visible set is drawn
+	 * first, a depth pyramid is built from its depth, and the remaining objects are tested
+	 * against that pyramid before the newly visible ones are drawn.
+	 */
+	class GpuDrivenRenderSystem
+	{
+	public:
+		// globalSetLayout is bound at set 1 of the draw pipeline, the camera is read from the GlobalUbo
+		GpuDrivenRenderSystem(OegDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout,
+		                      OegPipelineManager& pipelineManager);
+		~GpuDrivenRenderSystem();
+
+		GpuDrivenRenderSystem(const GpuDrivenRenderSystem&) = delete;
+		GpuDrivenRenderSystem& operator=(const GpuDrivenRenderSystem&) = delete;
+
+		static bool isSupported(OegDevice& device);
+
+		// call for every snapshot, also when no frame is recorded for it. Uploads everything again when
+		// entities were created or destroyed, otherwise remembers the moved objects for every frame
+		void applySceneChanges(const SceneChanges& changes);
+
+		// re-uploads the matrices of objects moved since this frame's object buffer was last written
+		void updateTransforms(FrameInfo& frameInfo);
+
+		// call every frame before culling, recreates the pyramid after the swapchain was recreated
+		void updateDepthPyramid(VkExtent2D depthExtent, VkFormat depthFormat, const std::vector<VkImageView>& depthViews);
+
+		// records the culling dispatch, must be called outside of a render pass
+		void cullGameObjects(FrameInfo& frameInfo, CullPhase phase);
+		void renderGameObjects(FrameInfo& frameInfo, CullPhase phase);
+
+		// between the early and late phase, outside of a render pass
+		void buildDepthPyramid(FrameInfo& frameInfo, VkImage depthImage, uint32_t imageIndex);
+
+		const OcclusionStats& getOcclusionStats() const { return occlusionStats; }
+
+		bool enableOcclusionCulling{true};
+
+	private:
+		struct Batch
+		{
+			std::shared_ptr<OegModel> model;
+			uint32_t firstCommand;
+			uint32_t objectCount;
+		};
+
+		// uploads transforms and bounds of every entity
+		void uploadGameObjects();
+
+		void createDescriptorSetLayout();
+		void createPipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+		void createPipelines(VkRenderPass renderPass);
+		void createDescriptorPool();
+		void createFrameBuffers(uint32_t objectCapacity);
+		void writeDescriptorSets();
+		void writeCullData(FrameInfo& frameInfo);
+		void readOcclusionStats(int frameIndex);
+
+		OegDevice& oegDevice;
+		OegPipelineManager& pipelineManager;
+		bool useDrawCount;
+
+		PipelineHandle pipeline{OegPipelineManager::INVALID_PIPELINE};
+		std::unique_ptr<OegComputePipeline> cullPipeline;
+		VkPipelineLayout pipelineLayout{};
+		VkPipelineLayout cullPipelineLayout{};
+
+		VkDescriptorSetLayout descriptorSetLayout{};
+		VkDescriptorPool descriptorPool{};
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		std::unique_ptr<OegDepthPyramid> depthPyramid;
+
+		// per frame, so moving objects never writes a buffer the GPU may still be reading
+		std::vector<std::unique_ptr<OegBuffer>> objectBuffers;
+		std::unique_ptr<OegBuffer> batchBuffer;
+		std::unique_ptr<OegBuffer> visibilityBuffer;
+		std::unique_ptr<OegBuffer> cullDataBuffer;
+		std::vector<std::unique_ptr<OegBuffer>> drawCommandBuffers;
+		std::vector<std::unique_ptr<OegBuffer>> drawCountBuffers;
+		std::vector<std::unique_ptr<OegBuffer>> statsBuffers;
+		std::vector<bool> statsWritten;
+
+		// the render thread's copy of the scene, kept up to date by applySceneChanges
+		std::vector<std::shared_ptr<OegModel>> models;
+		std::vector<WorldTransform> worldTransforms;
+
+		std::vector<Batch> batches;
+		// object buffer slot of every entity by dense index, NO_SLOT for entities without a model
+		std::vector<uint32_t> objectSlots;
+		// dirty dense index ranges not yet written to each frame's object buffer
+		std::vector<std::vector<DirtyRange>> pendingRanges;
+		uint32_t objectCount{0};
+		uint32_t objectCapacity{0};
+
+		OcclusionStats occlusionStats{};
+	};
+}
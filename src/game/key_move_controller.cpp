@@ -3,7 +3,7 @@
 namespace oeg
 {
 	void KeyboardMovementController::moveInPlaneXZ(GLFWwindow* window,
-	                                               float dt, OegGameObject& gameObject) const
+	                                               float dt, TransformComponent& transform) const
 	{
 		glm::vec3 rotate{0}; // if no keys are pressed, no rotation
 
@@ -12,15 +12,20 @@ namespace oeg
 		if (glfwGetKey(window, keys.lookUp) == GLFW_PRESS) rotate.x += 1.f;
 		if (glfwGetKey(window, keys.lookDown) == GLFW_PRESS) rotate.x -= 1.f;
 
+		glm::vec3 rotation = transform.getRotation();
 		if (dot(rotate, rotate) > std::numeric_limits<float>::epsilon())
 		{
-			gameObject.transform.rotation += lookSpeed * dt * normalize(rotate);
+			rotation += lookSpeed * dt * normalize(rotate);
 		}
 
-		gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
-		gameObject.transform.rotation.y = glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+		rotation.x = glm::clamp(rotation.x, -1.5f, 1.5f);
+		rotation.y = glm::mod(rotation.y, glm::two_pi<float>());
+		if (rotation != transform.getRotation())
+		{
+			transform.setRotation(rotation);
+		}
 
-		float yaw = gameObject.transform.rotation.y;
+		float yaw = rotation.y;
 		const glm::vec3 forwardDir{sin(yaw), 0.f, cos(yaw)};
 		const glm::vec3 rightDir{forwardDir.z, 0.f, -forwardDir.x};
 		const glm::vec3 upDir{0.f, -1.f, 0.f};
@@ -42,7 +47,8 @@ namespace oeg
 
 		if (dot(movement, movement) > std::numeric_limits<float>::epsilon())
 		{
-			gameObject.transform.translation += moveSpeed * dt * normalize(movement);
+			transform.setTranslation(
+				transform.getTranslation() + moveSpeed * dt * normalize(movement));
 		}
 	}
 }
@@ -23,7 +23,7 @@ namespace oeg
 			int lookDown = GLFW_KEY_DOWN;
 		};
 
-		void moveInPlaneXZ(GLFWwindow* window, float dt, OegGameObject& gameObject) const;
+		void moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform) const;
 
 		KeyMappings keys{};
 		float moveSpeed{3.f};
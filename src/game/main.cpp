@@ -3,10 +3,60 @@
 #include <iostream>
 #include <cstdlib>
 #include <stdexcept>
+#include <string>
 
-int main()
+int main(int argc, char* argv[])
 {
-	oeg::OegEngine app{};
+	// --headless renders offscreen without a window, --frames N stops after N frames, --scene picks the
+	// scene, --record-path saves the keyboard flight for oeg_bench to play back and --trace writes the last
+	// seconds of CPU zones and GPU scopes as a Chrome trace on exit. --flight-recorder writes a trace of the
+	// frames before every frame that takes longer than --spike-factor times the median. --metrics keeps a
+	// Prometheus text file of the newest frame's draw counts and pipeline statistics up to date
+	oeg::EngineOptions options{};
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string argument = argv[i];
+		if (argument == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (argument == "--frames" && i + 1 < argc)
+		{
+			options.frameCount = std::stoull(argv[++i]);
+		}
+		else if (argument == "--scene" && i + 1 < argc)
+		{
+			options.scene = argv[++i];
+		}
+		else if (argument == "--record-path" && i + 1 < argc)
+		{
+			options.recordCameraPathFile = argv[++i];
+		}
+		else if (argument == "--trace" && i + 1 < argc)
+		{
+			options.traceFile = argv[++i];
+		}
+		else if (argument == "--flight-recorder" && i + 1 < argc)
+		{
+			options.flightRecorderPrefix = argv[++i];
+		}
+		else if (argument == "--spike-factor" && i + 1 < argc)
+		{
+			options.spikeFactor = std::stof(argv[++i]);
+		}
+		else if (argument == "--metrics" && i + 1 < argc)
+		{
+			options.metricsFile = argv[++i];
+		}
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--headless] [--frames N] [--scene NAME] [--record-path FILE]"
+				<< " [--trace FILE] [--flight-recorder PREFIX] [--spike-factor F] [--metrics FILE]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	oeg::OegEngine app{options};
 
 	try
 	{
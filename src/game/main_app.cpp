@@ -8,24 +8,84 @@
 #include "glm/glm.hpp"
 
 // std
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 namespace oeg
 {
-	struct alignas(16) GlobalUbo
+	namespace
 	{
-		glm::mat4 projectionView{1.0f};
-		glm::vec3 lightDirection = normalize(glm::vec3(1.0f, -3.0f, -1.0f));
-	};
+		float millisecondsSince(std::chrono::high_resolution_clock::time_point startTime)
+		{
+			return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+
+		// GPU scopes of renderFrame and the frame stat each one is recorded in
+		constexpr const char* GPU_SCOPE_UPLOADS = "uploads";
+		constexpr const char* GPU_SCOPE_CULL = "cull";
+		constexpr const char* GPU_SCOPE_SCENE = "scene";
+		constexpr const char* GPU_SCOPE_LATE_CULL = "late cull";
+		constexpr const char* GPU_SCOPE_HI_Z_BUILD = "hi-z build";
+		constexpr const char* GPU_SCOPE_IMGUI = "imgui";
+		constexpr std::array<std::pair<const char*, FrameStat>, 6> GPU_SCOPE_STATS{{
+			{GPU_SCOPE_UPLOADS, FrameStat::GpuUploads},
+			{GPU_SCOPE_CULL, FrameStat::GpuCull},
+			{GPU_SCOPE_SCENE, FrameStat::GpuScene},
+			{GPU_SCOPE_LATE_CULL, FrameStat::GpuLateCull},
+			{GPU_SCOPE_HI_Z_BUILD, FrameStat::GpuHiZBuild},
+			{GPU_SCOPE_IMGUI, FrameStat::GpuImGui}
+		}};
+	}
 
-	OegEngine::OegEngine()
+	OegEngine::OegEngine(const EngineOptions& options)
+		: options{options}, oegWindow{WIDTH, HEIGHT, "Vulkan App", options.headless}
 	{
+		if (options.recordFrameStats)
+		{
+			if (options.frameCount == 0)
+			{
+				throw std::runtime_error("recording frame stats needs a frame count");
+			}
+			recordedFrameStats = std::make_unique<OegFrameStats>(
+				std::vector<std::string>{
+					"frameMs", "simulateMs", "transformsMs", "bvhMs", "bvhBuildMs", "bvhRefitMs", "bvhQueryMs",
+					"prepareMs", "snapshotWaitMs", "recordMs", "renderWaitMs", "gpuMs", "gpuUploadsMs", "gpuCullMs",
+					"gpuSceneMs", "gpuLateCullMs", "gpuHiZBuildMs", "gpuImGuiMs", "drawCalls", "instances", "triangles",
+					"binds", "pushConstants", "inputAssemblyPrimitives", "vertexShaderInvocations", "clippingInvocations", "clippingPrimitives",
+					"fragmentShaderInvocations"
+				},
+				options.frameCount,
+				options.warmupFrames);
+		}
+		if (!options.flightRecorderPrefix.empty())
+		{
+			flightRecorder = std::make_unique<OegFlightRecorder>(options.flightRecorderPrefix, options.spikeFactor);
+		}
+		if (!options.metricsFile.empty())
+		{
+			metricsFile = std::make_unique<OegMetricsFile>(options.metricsFile);
+		}
+
 		loadGameObjects();
 		initImGui();
 		setupRenderSystem();
+		oegDevice.getPipelineCache().logStartupTimings();
 	}
 
-	OegEngine::~OegEngine() = default;
+	OegEngine::~OegEngine()
+	{
+		// only still running when the main thread left run with an exception
+		if (renderThread.joinable())
+		{
+			snapshots.close();
+			renderThread.join();
+		}
+	}
 
 	void OegEngine::initImGui()
 	{
@@ -36,14 +96,20 @@ namespace oeg
 			oegDevice.findPhysicalQueueFamilies().graphicsFamily,
 			oegDevice.graphicsQueue(),
 			oegRenderer.getSwapChainRenderPass(),
-			OegSwapChain::MAX_FRAMES_IN_FLIGHT
+			OegSwapChain::MAX_FRAMES_IN_FLIGHT,
+			oegDevice.getPipelineCache().getCache()
 		);
 	}
 
 	void OegEngine::run()
 	{
+		OegTrace::setThreadName("main");
+		if (!options.traceFile.empty())
+		{
+			OegTrace::setEnabled(true);
+		}
+
 		auto currentTime = std::chrono::high_resolution_clock::now();
-		auto viewerObject = OegGameObject::createGameObject();
 
 		float fov = 70.0f; // Initial FOV value
 
@@ -52,102 +118,774 @@ namespace oeg
 
 		int frameCount = 0;
 		float totalFrameTime = 0.0f;
+		float displayedFps = 0.0f;
+		float displayedWorstFrameTimeMs = 0.0f;
 
 		constexpr int maxFrameSamples = 100;
 		std::vector<float> frameTimes(maxFrameSamples, 0.0f);
+		int frameSampleIndex = 0;
 
-		while (!oegWindow.shouldClose())
-		{
-			KeyboardMovementController cameraController;
-			glfwPollEvents();
-
-			ImGui_ImplVulkan_NewFrame();
-			ImGui_ImplGlfw_NewFrame();
-			ImGui::NewFrame();
+		renderThread = std::thread(&OegEngine::renderLoop, this);
+		const auto runStartTime = std::chrono::high_resolution_clock::now();
 
+		while (!oegWindow.shouldClose() && (options.frameCount == 0 || frameNumber < options.frameCount))
+		{
+			OEG_TRACE_ZONE("mainFrame");
+			// frameTime below runs from the previous frame's start, stats of this frame have to end with it
+			const auto frameStartTime = std::chrono::high_resolution_clock::now();
+			if (!options.headless)
+			{
+				glfwPollEvents();
+				// nothing is drawn while minimized, sleep until the window comes back instead of spinning
+				while (oegWindow.isMinimized() && !oegWindow.shouldClose())
+				{
+					glfwWaitEvents();
+				}
+			}
+			inputTime = std::chrono::steady_clock::now();
+			jobSystem.runMainThreadJobs();
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float>(newTime - currentTime).count();
 			currentTime = newTime;
 
+			{
+				OEG_TRACE_ZONE("ImGui::NewFrame");
+				ImGui_ImplVulkan_NewFrame();
+				if (options.headless)
+				{
+					// what the GLFW backend would fill in
+					const VkExtent2D extent = oegWindow.getExtent();
+					ImGuiIO& io = ImGui::GetIO();
+					io.DisplaySize = ImVec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+					io.DeltaTime = std::max(frameTime, 1e-6f);
+				}
+				else
+				{
+					ImGui_ImplGlfw_NewFrame();
+				}
+				ImGui::NewFrame();
+			}
+
 			timeSinceLastUpdate += frameTime;
 
 			totalFrameTime += frameTime;
 			frameCount++;
 
 			// Store the frame time in the circular buffer
-			frameTimes[frameCount % maxFrameSamples] = frameTime;
+			frameTimes[frameSampleIndex] = frameTime;
+			frameSampleIndex = (frameSampleIndex + 1) % maxFrameSamples;
 
+			// averaged over the interval, a number that changes every frame cannot be read
+			if (timeSinceLastUpdate >= updateInterval)
+			{
+				displayedFps = static_cast<float>(frameCount) / totalFrameTime;
+				displayedWorstFrameTimeMs = *std::max_element(frameTimes.begin(), frameTimes.end()) * 1000.0f;
+				timeSinceLastUpdate = 0.0f; // Reset the timer
+				frameCount = 0;
+				totalFrameTime = 0.0f;
+			}
 
 			float frameTimeMs = frameTime * 1000.0f;
 			ImGui::Text("Frame Time: %.2f ms", frameTimeMs);
+			ImGui::Text("FPS: %.2f, worst of the last %d frames %.2f ms",
+			            displayedFps, maxFrameSamples, displayedWorstFrameTimeMs);
+
+			const RenderThreadStats renderThreadStats = getRenderThreadStats();
+			const CommandRecorderStats& recorderStats = renderThreadStats.recorderStats;
+			// instances and triangles of the direct draws, the indirect ones show up in the pipeline statistics
+			ImGui::Text("Draws: %u (%u instances, %llu triangles), dispatches: %u",
+			            recorderStats.drawCalls, recorderStats.instanceCount,
+			            static_cast<unsigned long long>(recorderStats.triangleCount), recorderStats.dispatchCalls);
+			ImGui::Text("Binds: %u, push constants: %u (%u redundant dropped)",
+			            recorderStats.bindCalls, recorderStats.pushConstantCalls, recorderStats.eliminatedCalls);
+			const GpuPipelineStatistics& pipelineStatistics = renderThreadStats.gpuProfile.pipelineStatistics;
+			if (pipelineStatistics.valid)
+			{
+				ImGui::Text("Scene GPU: %llu primitives, %llu clipped to %llu",
+				            static_cast<unsigned long long>(pipelineStatistics.inputAssemblyPrimitives),
+				            static_cast<unsigned long long>(pipelineStatistics.clippingInvocations),
+				            static_cast<unsigned long long>(pipelineStatistics.clippingPrimitives));
+				ImGui::Text("Invocations: %llu vertex, %llu fragment",
+				            static_cast<unsigned long long>(pipelineStatistics.vertexShaderInvocations),
+				            static_cast<unsigned long long>(pipelineStatistics.fragmentShaderInvocations));
+			}
+			ImGui::Text("Render thread: %.2f ms, idle %.2f ms; main thread blocked %.2f ms",
+			            renderThreadStats.renderTimeMs, renderThreadStats.snapshotWaitMs, snapshotWaitMs);
+			ImGui::Checkbox("Late-latched camera", &renderSettings.lateLatchCamera);
+			ImGui::Text("Input to submit: %.2f ms (snapshot camera %.2f ms)",
+			            renderThreadStats.inputToSubmitMs, renderThreadStats.snapshotInputToSubmitMs);
+			ImGui::Text("Uploads: %.1f KB", static_cast<float>(renderThreadStats.uploadBytes) / 1024.0f);
+			if (metricsFile)
+			{
+				writeMetrics(renderThreadStats, frameTimeMs);
+			}
 
-			float fps = frameCount / totalFrameTime;
-			ImGui::Text("FPS: %.2f", fps);
+			const GpuFrameProfile& gpuProfile = renderThreadStats.gpuProfile;
+			if (gpuProfile.valid && ImGui::CollapsingHeader("GPU scopes", ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(gpuProfile.frameId),
+				            gpuProfile.frameMilliseconds);
+				for (const GpuScopeTime& scope : gpuProfile.scopes)
+				{
+					ImGui::Text("%*s%s: %.3f ms", static_cast<int>(2 * (scope.depth + 1)), "", scope.name,
+					            scope.milliseconds);
+				}
+			}
+
+			bool tracing = OegTrace::isEnabled();
+			if (ImGui::Checkbox("Record trace", &tracing))
+			{
+				OegTrace::setEnabled(tracing);
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Write trace"))
+			{
+				const std::string traceFile = "trace_" + std::to_string(frameNumber) + ".json";
+				OegTrace::writeChromeTrace(traceFile, TRACE_DUMP_SECONDS);
+				std::cout << "Wrote the last " << TRACE_DUMP_SECONDS << " s of trace to " << traceFile << "\n";
+			}
+			if (flightRecorder)
+			{
+				ImGui::Text("Flight recorder: spikes over %.2f ms, %u written%s%s", flightRecorder->getThresholdMs(),
+				            flightRecorder->getDumpCount(), flightRecorder->getDumpCount() > 0 ? ", last " : "",
+				            flightRecorder->getLastDumpFile().c_str());
+			}
+
+			const std::vector<JobWorkerStats> jobStats = jobSystem.sampleStats();
+			for (size_t i = 0; i < jobStats.size(); i++)
+			{
+				ImGui::Text("%s %zu: %3.0f%% busy, %u jobs, %u stolen", i == 0 ? "Main" : "Worker", i,
+				            jobStats[i].utilization * 100.0f, jobStats[i].jobCount, jobStats[i].stealCount);
+			}
+
+			const FixedTimestepStats& simulationStats = simulationClock.getStats();
+			ImGui::Text("Simulation: %u steps of %.1f ms, alpha %.2f (%u frames clamped, %.0f ms dropped)",
+			            simulationStats.stepCount, simulationClock.getStep() * 1000.0f, simulationClock.getAlpha(),
+			            simulationStats.clampedFrameCount, simulationStats.droppedTimeMs);
+
+			const TransformStats& transformStats = transformUpdater.getStats();
+			ImGui::Text("Dirty transforms: %u / %u (%u ranges, %.3f ms)",
+			            transformStats.dirtyCount, transformStats.objectCount, transformStats.rangeCount,
+			            transformStats.rebuildTimeMs);
+			const SceneGraphStats& sceneGraphStats = sceneGraph.getStats();
+			ImGui::Text("Scene graph: %u / %u updated, %u levels (%.3f ms)",
+			            sceneGraphStats.updatedCount, sceneGraphStats.nodeCount, sceneGraphStats.levelCount,
+			            sceneGraphStats.propagateTimeMs);
+			const BvhStats bvhStats = sceneBvh.getStats();
+			ImGui::Text("BVH: %u nodes, SAH %.1f / %.1f, %u rebuilds (build %.3f ms, refit %u nodes %.3f ms)",
+			            bvhStats.nodeCount, bvhStats.sahCost, bvhStats.buildSahCost, bvhStats.rebuildCount,
+			            bvhStats.buildTimeMs, bvhStats.refitNodeCount, bvhStats.refitTimeMs);
+			// of the last frame, queries of this one run after the update further down
+			ImGui::Text("BVH queries: %u (%.3f ms)", bvhStats.queryCount, bvhStats.queryTimeMs);
+			if (registry.isAlive(pickedEntity))
+			{
+				ImGui::Text("Picked entity %u", pickedEntity.index);
+			}
 
 			// FOV slider
 			ImGui::SliderFloat("FOV", &fov, 30.0f, 120.0f);
 			ImGui::SliderFloat("Camera Speed", &cameraController.moveSpeed, 3.0f, 6.0f);
 
-			timeSinceLastUpdate = 0.0f; // Reset the timer
-			frameCount = 0;
-			totalFrameTime = 0.0f;
+			if (gpuDrivenRenderSystem)
+			{
+				ImGui::Checkbox("GPU-driven culling", &renderSettings.gpuDrivenRendering);
+			}
 
-			cameraController.moveInPlaneXZ(oegWindow.getGLFWWindow(), frameTime, viewerObject);
-			camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
-			camera.setPerspectiveProjection(glm::radians(fov), oegRenderer.getAspectRatio(), 0.1f, 10.0f);
+			if (renderSettings.gpuDrivenRendering)
+			{
+				const OcclusionStats& occlusionStats = renderThreadStats.occlusionStats;
+				ImGui::Checkbox("Occlusion culling", &renderSettings.occlusionCulling);
+				ImGui::Text("Frustum culled: %u, occluded: %u", occlusionStats.frustumCulledCount,
+				            occlusionStats.occludedCount);
+				ImGui::Text("Drawn: %u early, %u late", occlusionStats.earlyDrawCount, occlusionStats.lateDrawCount);
+			}
 
-			renderFrame(frameTime);
+			if (!renderSettings.gpuDrivenRendering)
+			{
+				const CullingStats& cullingStats = simpleRenderSystem->getCullingStats();
+				ImGui::Checkbox("Frustum culling", &simpleRenderSystem->enableFrustumCulling);
+				ImGui::SameLine();
+				ImGui::Checkbox("BVH culling", &simpleRenderSystem->enableBvhCulling);
+				ImGui::Text("Culled: %u / %u (%.3f ms)",
+				            cullingStats.culledCount, cullingStats.testedCount, cullingStats.cullTimeMs);
+
+				// the render thread requests the pipeline once the setting reaches it in a snapshot
+				int lightingMode = static_cast<int>(renderSettings.lightingMode);
+				if (ImGui::Combo("Lighting", &lightingMode, "Diffuse\0Normals\0Unlit\0"))
+				{
+					renderSettings.lightingMode = static_cast<LightingMode>(lightingMode);
+				}
+				if (!renderThreadStats.lightingModeReady)
+				{
+					ImGui::SameLine();
+					ImGui::Text("(compiling)");
+				}
+				bool packedTransforms = renderSettings.transformMode == TransformMode::Packed;
+				if (ImGui::Checkbox("Packed transforms", &packedTransforms))
+				{
+					renderSettings.transformMode = packedTransforms ? TransformMode::Packed : TransformMode::Matrix;
+				}
+
+				const DrawListStats& drawListStats = simpleRenderSystem->getDrawListStats();
+				ImGui::Text("Model binds: %u sorted, %u unsorted (sort %.3f ms)",
+				            drawListStats.modelBinds, drawListStats.unsortedModelBinds, drawListStats.sortTimeMs);
+			}
+
+			const auto simulateStartTime = std::chrono::high_resolution_clock::now();
+			const uint32_t stepCount = simulationClock.advance(frameTime);
+			for (uint32_t i = 0; i < stepCount; i++)
+			{
+				simulate(simulationClock.getStep());
+			}
+			recordFrameStat(frameNumber, FrameStat::Simulate, millisecondsSince(simulateStartTime));
+
+			if (!options.cameraPath.empty())
+			{
+				// one step of the path per frame rather than per elapsed time, so every run renders the same views
+				const CameraKeyframe pose = options.cameraPath.sample(
+					static_cast<float>(frameNumber) * simulationClock.getStep());
+				camera.setViewYXZ(pose.translation, pose.rotation);
+			}
+			else
+			{
+				// the frame shows the time carried over past the last step, somewhere between the last two states
+				const float alpha = simulationClock.getAlpha();
+				camera.setViewYXZ(interpolateTranslation(previousViewerTransform, viewerTransform, alpha),
+				                  interpolateRotation(previousViewerTransform, viewerTransform, alpha));
+			}
+			// the swapchain belongs to the render thread, the window has the same size
+			const VkExtent2D extent = oegWindow.getExtent();
+			const float aspectRatio = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+			camera.setPerspectiveProjection(glm::radians(fov), aspectRatio, 0.1f, 10.0f);
+			// the render thread may still be recording an older snapshot, it picks this up right before submit
+			latestCamera.publish(LatchedCamera{camera.getProjection() * camera.getView(), inputTime});
+
+			if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !ImGui::GetIO().WantCaptureMouse)
+			{
+				pickEntity(ImGui::GetMousePos().x, ImGui::GetMousePos().y);
+			}
+
+			if (!submitSnapshot(frameTime))
+			{
+				break;
+			}
+			// submitSnapshot moved frameNumber on to the next frame
+			const float frameMs = millisecondsSince(frameStartTime);
+			recordFrameStat(frameNumber - 1, FrameStat::Frame, frameMs);
+			if (flightRecorder)
+			{
+				flightRecorder->endFrame(frameNumber - 1, frameMs);
+			}
 		}
 
+		snapshots.close();
+		renderThread.join();
 		vkDeviceWaitIdle(oegDevice.device());
+
+		if (renderThreadException)
+		{
+			std::rethrow_exception(renderThreadException);
+		}
+
+		if (!options.recordCameraPathFile.empty())
+		{
+			recordedCameraPath.saveToFile(options.recordCameraPathFile);
+		}
+		if (!options.traceFile.empty())
+		{
+			OegTrace::writeChromeTrace(options.traceFile, TRACE_DUMP_SECONDS);
+		}
+
+		if (options.headless)
+		{
+			const auto runEndTime = std::chrono::high_resolution_clock::now();
+			const float seconds = std::chrono::duration<float>(runEndTime - runStartTime).count();
+			std::cout << "Headless: " << frameNumber << " frames in " << seconds << " s, "
+				<< (frameNumber > 0 ? seconds * 1000.0f / static_cast<float>(frameNumber) : 0.0f) << " ms per frame"
+				<< std::endl;
+		}
 	}
 
+	void OegEngine::simulate(float dt)
+	{
+		OEG_TRACE_ZONE("simulate");
+		previousViewerTransform = viewerTransform;
+		// there is no keyboard without a window
+		if (!options.headless)
+		{
+			cameraController.moveInPlaneXZ(oegWindow.getGLFWWindow(), dt, viewerTransform);
+		}
+
+		if (!options.recordCameraPathFile.empty())
+		{
+			recordedCameraPath.addKeyframe(
+				CameraKeyframe{simulationTime, viewerTransform.getTranslation(), viewerTransform.getRotation()});
+		}
+		simulationTime += dt;
+	}
 
-	void OegEngine::renderFrame(float frameTime)
+	bool OegEngine::submitSnapshot(float frameTime)
 	{
-		if (auto commandBuffer = oegRenderer.beginFrame())
+		OEG_TRACE_ZONE("submitSnapshot");
+		// only moved objects get their matrices rebuilt and only their subtrees are propagated, this
+		// overlaps with the render thread recording the previous snapshot
+		const auto transformStartTime = std::chrono::high_resolution_clock::now();
+		transformUpdater.update(registry.getTransforms());
+		sceneGraph.propagate(registry, transformUpdater.getDirtyRanges());
+		recordFrameStat(frameNumber, FrameStat::Transforms, millisecondsSince(transformStartTime));
+
+		const auto bvhStartTime = std::chrono::high_resolution_clock::now();
+		const uint32_t rebuildCount = sceneBvh.getStats().rebuildCount;
+		sceneBvh.update(registry, sceneGraph.getDirtyRanges());
+		recordFrameStat(frameNumber, FrameStat::Bvh, millisecondsSince(bvhStartTime));
+		const BvhStats bvhStats = sceneBvh.getStats();
+		if (bvhStats.rebuildCount != rebuildCount)
 		{
+			recordFrameStat(frameNumber, FrameStat::BvhBuild, bvhStats.buildTimeMs);
+		}
+		recordFrameStat(frameNumber, FrameStat::BvhRefit, bvhStats.refitTimeMs);
+		{
+			OEG_TRACE_ZONE("ImGui::Render");
 			ImGui::Render();
+		}
+
+		const auto waitStartTime = std::chrono::high_resolution_clock::now();
+		RenderSnapshot* snapshot = snapshots.beginWrite();
+		snapshotWaitMs = millisecondsSince(waitStartTime);
+		recordFrameStat(frameNumber, FrameStat::SnapshotWait, snapshotWaitMs);
+		if (!snapshot)
+		{
+			return false;
+		}
+
+		snapshot->frameNumber = frameNumber++;
+		snapshot->frameTime = frameTime;
+		snapshot->camera = camera;
+		snapshot->inputTime = inputTime;
+		snapshot->ubo.projectionView = camera.getProjection() * camera.getView();
+		snapshot->settings = renderSettings;
+
+		const auto prepareStartTime = std::chrono::high_resolution_clock::now();
+		if (!renderSettings.gpuDrivenRendering)
+		{
+			simpleRenderSystem->prepare(
+				camera, registry, sceneGraph, sceneBvh, renderSettings.transformMode, snapshot->simpleDraws);
+		}
+		// the GPU-driven system keeps its buffers current while it is not drawing, so it sees every change
+		if (gpuDrivenRenderSystem)
+		{
+			const bool layoutChanged = registry.getLayoutVersion() != snapshotLayoutVersion;
+			snapshot->sceneChanges.capture(registry, sceneGraph.getDirtyRanges(), layoutChanged);
+			snapshotLayoutVersion = registry.getLayoutVersion();
+		}
+		snapshot->imguiDrawData.copyFrom(*ImGui::GetDrawData());
+		recordFrameStat(snapshot->frameNumber, FrameStat::Prepare, millisecondsSince(prepareStartTime));
+		recordFrameStat(snapshot->frameNumber, FrameStat::BvhQuery, sceneBvh.getStats().queryTimeMs);
+
+		snapshots.publish();
+		return true;
+	}
+
+	void OegEngine::renderLoop()
+	{
+		OegTrace::setThreadName("render");
+		try
+		{
+			while (true)
+			{
+				const auto waitStartTime = std::chrono::high_resolution_clock::now();
+				RenderSnapshot* snapshot = snapshots.acquire();
+				if (!snapshot)
+				{
+					break;
+				}
+
+				RenderThreadStats frameStats{};
+				const uint64_t snapshotFrameNumber = snapshot->frameNumber;
+				const auto renderStartTime = std::chrono::high_resolution_clock::now();
+				renderFrame(*snapshot, frameStats);
+				snapshots.release();
+				const auto renderEndTime = std::chrono::high_resolution_clock::now();
+
+				const GpuFrameProfile& gpuProfile = oegRenderer.getLastGpuProfile();
+				if (gpuProfile.valid || gpuProfile.pipelineStatistics.valid)
+				{
+					recordGpuProfile(gpuProfile);
+					frameStats.gpuProfile = gpuProfile;
+				}
+
+				frameStats.recorderStats = oegRenderer.getLastRecorderStats();
+				recordRecorderStats(snapshotFrameNumber, frameStats.recorderStats);
+				if (gpuDrivenRenderSystem)
+				{
+					frameStats.occlusionStats = gpuDrivenRenderSystem->getOcclusionStats();
+				}
+				frameStats.lightingModeReady = simpleRenderSystem->isLightingModeReady();
+				frameStats.renderTimeMs =
+					std::chrono::duration<float, std::milli>(renderEndTime - renderStartTime).count();
+				frameStats.snapshotWaitMs =
+					std::chrono::duration<float, std::milli>(renderStartTime - waitStartTime).count();
+				recordFrameStat(snapshotFrameNumber, FrameStat::Record, frameStats.renderTimeMs);
+				recordFrameStat(snapshotFrameNumber, FrameStat::RenderWait, frameStats.snapshotWaitMs);
+
+				std::lock_guard<std::mutex> lock(renderStatsMutex);
+				renderStats = frameStats;
+			}
+
+			// the last frames are still on the GPU, their times would be missing otherwise
+			for (const GpuFrameProfile& gpuProfile : oegRenderer.finishGpuProfiles())
+			{
+				recordGpuProfile(gpuProfile);
+			}
+		}
+		catch (...)
+		{
+			// handed to the main thread, which stops at its next snapshot and rethrows
+			renderThreadException = std::current_exception();
+			snapshots.close();
+		}
+	}
+
+	RenderThreadStats OegEngine::getRenderThreadStats()
+	{
+		std::lock_guard<std::mutex> lock(renderStatsMutex);
+		return renderStats;
+	}
+
+	void OegEngine::writeMetrics(const RenderThreadStats& renderThreadStats, float frameTimeMs)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (std::chrono::duration<float>(now - lastMetricsWriteTime).count() < METRICS_INTERVAL_SECONDS)
+		{
+			return;
+		}
+		lastMetricsWriteTime = now;
+
+		// a scrape sees single frames, trends come from scraping often enough
+		const CommandRecorderStats& recorderStats = renderThreadStats.recorderStats;
+		metricsFile->set("oeg_frame_number", static_cast<double>(frameNumber), "Frames the main thread has started");
+		metricsFile->set("oeg_frame_milliseconds", frameTimeMs, "CPU time of the newest main thread frame");
+		metricsFile->set("oeg_render_thread_milliseconds", renderThreadStats.renderTimeMs,
+		                 "Time the render thread spent on its newest frame");
+		metricsFile->set("oeg_draw_calls", recorderStats.drawCalls, "Draw calls of the newest frame");
+		metricsFile->set("oeg_instances", recorderStats.instanceCount,
+		                 "Instances drawn by the direct draw calls of the newest frame");
+		metricsFile->set("oeg_triangles", static_cast<double>(recorderStats.triangleCount),
+		                 "Triangles submitted by the direct draw calls of the newest frame");
+		metricsFile->set("oeg_binds", recorderStats.bindCalls,
+		                 "Pipeline, descriptor and buffer binds of the newest frame");
+		metricsFile->set("oeg_push_constants", recorderStats.pushConstantCalls,
+		                 "Push constant updates of the newest frame");
+		metricsFile->set("oeg_redundant_calls_dropped", recorderStats.eliminatedCalls,
+		                 "Binds and push constants the recorder dropped in the newest frame");
+		metricsFile->set("oeg_dispatches", recorderStats.dispatchCalls, "Compute dispatches of the newest frame");
+		metricsFile->set("oeg_upload_bytes", static_cast<double>(renderThreadStats.uploadBytes),
+		                 "Bytes written to mapped buffers in the newest frame");
+
+		const GpuFrameProfile& gpuProfile = renderThreadStats.gpuProfile;
+		if (gpuProfile.valid)
+		{
+			metricsFile->set("oeg_gpu_frame_milliseconds", gpuProfile.frameMilliseconds,
+			                 "GPU time of the newest finished frame");
+		}
+		const GpuPipelineStatistics& statistics = gpuProfile.pipelineStatistics;
+		if (statistics.valid)
+		{
+			metricsFile->set("oeg_input_assembly_primitives", static_cast<double>(statistics.inputAssemblyPrimitives),
+			                 "Primitives assembled by the scene passes of the newest finished frame");
+			metricsFile->set("oeg_vertex_shader_invocations", static_cast<double>(statistics.vertexShaderInvocations),
+			                 "Vertex shader invocations of the scene passes of the newest finished frame");
+			metricsFile->set("oeg_clipping_invocations", static_cast<double>(statistics.clippingInvocations),
+			                 "Primitives that reached clipping in the scene passes of the newest finished frame");
+			metricsFile->set("oeg_clipping_primitives", static_cast<double>(statistics.clippingPrimitives),
+			                 "Primitives clipping passed on in the scene passes of the newest finished frame");
+			metricsFile->set("oeg_fragment_shader_invocations",
+			                 static_cast<double>(statistics.fragmentShaderInvocations),
+			                 "Fragment shader invocations of the scene passes of the newest finished frame");
+		}
+		metricsFile->write();
+	}
+
+
+	void OegEngine::renderFrame(RenderSnapshot& snapshot, RenderThreadStats& frameStats)
+	{
+		OEG_TRACE_ZONE("renderFrame");
+		const RenderSettings& settings = snapshot.settings;
+		if (simpleRenderSystem->getLightingMode() != settings.lightingMode)
+		{
+			simpleRenderSystem->setLightingMode(settings.lightingMode, oegRenderer.getSwapChainRenderPass());
+		}
+		if (simpleRenderSystem->getTransformMode() != settings.transformMode)
+		{
+			simpleRenderSystem->setTransformMode(settings.transformMode, oegRenderer.getSwapChainRenderPass());
+		}
+
+		// applied even when no frame can be started, later snapshots only carry their own changes
+		if (gpuDrivenRenderSystem)
+		{
+			gpuDrivenRenderSystem->enableOcclusionCulling = settings.occlusionCulling;
+			gpuDrivenRenderSystem->applySceneChanges(snapshot.sceneChanges);
+		}
+
+		if (auto commandBuffer = oegRenderer.beginFrame(snapshot.frameNumber))
+		{
 			int frameIndex = oegRenderer.getFrameIndex();
+			OegGpuProfiler& gpuProfiler = oegRenderer.getGpuProfiler();
+
+			// the GlobalUbo is written in lateLatchCamera, recording only references it
+			FrameInfo frameInfo{
+				frameIndex,
+				snapshot.frameTime,
+				commandBuffer,
+				snapshot.camera,
+				oegRenderer.getCommandRecorder(),
+				globalDescriptorSets[frameIndex]
+			};
+
+			// only the world transforms that moved since this frame's buffer was written are re-uploaded
+			if (gpuDrivenRenderSystem)
+			{
+				gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_UPLOADS);
+				gpuDrivenRenderSystem->updateTransforms(frameInfo);
+				gpuProfiler.endScope(commandBuffer);
+			}
+
+			// compute work has to be recorded outside the render pass
+			if (settings.gpuDrivenRendering)
+			{
+				gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_CULL);
+				gpuDrivenRenderSystem->updateDepthPyramid(
+					oegRenderer.getSwapChainExtent(), oegRenderer.getDepthFormat(), oegRenderer.getDepthImageViews());
+				gpuDrivenRenderSystem->cullGameObjects(frameInfo, CullPhase::Early);
+				gpuProfiler.endScope(commandBuffer);
+			}
 
-			updateGlobalUbo(frameIndex, frameTime);
+			gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_SCENE);
 			oegRenderer.beginSwapChainRenderPass(commandBuffer);
+			// inside the pass, so ImGui is left out of the statistics
+			gpuProfiler.beginPipelineStatistics(commandBuffer);
 
-			FrameInfo frameInfo{frameIndex, frameTime, commandBuffer, camera};
-			simpleRenderSystem->renderGameObjects(frameInfo, gameObjects);
+			if (settings.gpuDrivenRendering)
+			{
+				gpuDrivenRenderSystem->renderGameObjects(frameInfo, CullPhase::Early);
+
+				// objects that were hidden last frame are tested against the depth of the early pass
+				if (gpuDrivenRenderSystem->enableOcclusionCulling)
+				{
+					gpuProfiler.endPipelineStatistics(commandBuffer);
+					oegRenderer.endSwapChainRenderPass(commandBuffer);
+					gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_LATE_CULL);
+					gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_HI_Z_BUILD);
+					gpuDrivenRenderSystem->buildDepthPyramid(
+						frameInfo, oegRenderer.getCurrentDepthImage(), oegRenderer.getCurrentImageIndex());
+					gpuProfiler.endScope(commandBuffer);
+					gpuDrivenRenderSystem->cullGameObjects(frameInfo, CullPhase::Late);
+					gpuProfiler.endScope(commandBuffer);
+					oegRenderer.beginSwapChainRenderPass(commandBuffer, true);
+					gpuProfiler.beginPipelineStatistics(commandBuffer);
+					gpuDrivenRenderSystem->renderGameObjects(frameInfo, CullPhase::Late);
+				}
+			}
+			else
+			{
+				simpleRenderSystem->renderGameObjects(frameInfo, snapshot.simpleDraws);
+			}
+			gpuProfiler.endPipelineStatistics(commandBuffer);
+			gpuProfiler.endScope(commandBuffer);
 
-			if (ImDrawData* drawData = ImGui::GetDrawData())
+			if (ImDrawData* drawData = snapshot.imguiDrawData.get())
 			{
+				OEG_TRACE_ZONE("ImGui_ImplVulkan_RenderDrawData");
+				gpuProfiler.beginScope(commandBuffer, GPU_SCOPE_IMGUI);
 				ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+				frameInfo.recorder.invalidate();
+				gpuProfiler.endScope(commandBuffer);
 			}
 			oegRenderer.endSwapChainRenderPass(commandBuffer);
-			oegRenderer.endFrame();
+			oegRenderer.endFrame([&] { lateLatchCamera(snapshot, frameIndex, frameStats); });
 		}
 
-		ImGui::Render();
+		// taken even when no frame was started, so the next frame only counts its own
+		frameStats.uploadBytes = OegBuffer::takeUploadedBytes();
+		OEG_TRACE_COUNTER("uploadBytes", frameStats.uploadBytes);
 	}
 
-	void OegEngine::updateGlobalUbo(const int frameIndex, float frameTime)
+	void OegEngine::lateLatchCamera(const RenderSnapshot& snapshot, int frameIndex, RenderThreadStats& frameStats)
 	{
-		GlobalUbo ubo{};
-		ubo.projectionView = camera.getProjection() * camera.getView();
+		// beginFrame waited for this frame index's fence, so the GPU is done with its slice of the ubo buffer
+		GlobalUbo ubo = snapshot.ubo;
+		std::chrono::steady_clock::time_point inputTime = snapshot.inputTime;
+		if (snapshot.settings.lateLatchCamera)
+		{
+			// culling used the snapshot's camera, objects at the frustum edge may be late by a frame when turning fast
+			const LatchedCamera latest = latestCamera.read();
+			if (latest.inputTime > inputTime)
+			{
+				ubo.projectionView = latest.projectionView;
+				inputTime = latest.inputTime;
+			}
+		}
+		updateGlobalUbo(frameIndex, ubo);
 
+		const auto submitTime = std::chrono::steady_clock::now();
+		frameStats.inputToSubmitMs = std::chrono::duration<float, std::milli>(submitTime - inputTime).count();
+		frameStats.snapshotInputToSubmitMs =
+			std::chrono::duration<float, std::milli>(submitTime - snapshot.inputTime).count();
+	}
+
+	void OegEngine::updateGlobalUbo(const int frameIndex, const GlobalUbo& ubo)
+	{
 		globalUboBuffer->writeToIndex(&ubo, frameIndex);
 		globalUboBuffer->flushIndex(frameIndex);
 	}
 
+	void OegEngine::pickEntity(float x, float y)
+	{
+		const ImVec2 windowSize = ImGui::GetIO().DisplaySize;
+		if (windowSize.x <= 0.0f || windowSize.y <= 0.0f)
+		{
+			return;
+		}
+
+		// window y points down like vulkan's ndc y, so no flip is needed
+		const glm::vec2 ndc{2.0f * x / windowSize.x - 1.0f, 2.0f * y / windowSize.y - 1.0f};
+		const glm::mat4 inverseProjectionView = glm::inverse(camera.getProjection() * camera.getView());
+		const glm::vec4 nearPoint = inverseProjectionView * glm::vec4{ndc, 0.0f, 1.0f};
+		const glm::vec4 farPoint = inverseProjectionView * glm::vec4{ndc, 1.0f, 1.0f};
+
+		const glm::vec3 origin = glm::vec3{nearPoint} / nearPoint.w;
+		const glm::vec3 end = glm::vec3{farPoint} / farPoint.w;
+		const float length = glm::length(end - origin);
+
+		RayHit hit{};
+		pickedEntity = sceneBvh.raycast(origin, (end - origin) / length, length, hit)
+			? registry.getEntities()[hit.objectIndex]
+			: Entity{};
+	}
+
 	void OegEngine::loadGameObjects()
 	{
-		auto oegModel = OegModel::createModelFromFile(oegDevice, "models/test.obj");
-		OegGameObject cube = OegGameObject::createGameObject();
+		// every instance shares the shapes of the file
+		std::vector<std::shared_ptr<OegModel>> shapes;
+		for (auto& oegModel : OegModel::createShapeModelsFromFile(oegDevice, "models/test.obj"))
+		{
+			// Convert unique_ptr to shared_ptr
+			shapes.push_back(std::shared_ptr(std::move(oegModel)));
+		}
+
+		if (options.scene == "cube")
+		{
+			addModelInstance(shapes, glm::vec3(0.0f, 0.0f, 2.5f), 0.5f);
+		}
+		else if (options.scene == "grid")
+		{
+			// a floor of small cubes around the single cube's spot, enough roots for culling and the BVH to matter
+			constexpr int gridSize = 32;
+			constexpr float spacing = 0.75f;
+			for (int x = 0; x < gridSize; x++)
+			{
+				for (int z = 0; z < gridSize; z++)
+				{
+					const glm::vec3 translation{
+						(static_cast<float>(x) - gridSize * 0.5f) * spacing,
+						0.0f,
+						2.5f + (static_cast<float>(z) - gridSize * 0.5f) * spacing
+					};
+					addModelInstance(shapes, translation, 0.25f);
+				}
+			}
+		}
+		else
+		{
+			throw std::runtime_error("unknown scene: " + options.scene);
+		}
+	}
 
-		// Convert unique_ptr to shared_ptr
-		cube.model = std::shared_ptr(std::move(oegModel));
-		cube.transform.translation = glm::vec3(0.0f, 0.0f, 2.5f);
-		cube.transform.scale = glm::vec3(0.5f, 0.5f, 0.5f);
+	Entity OegEngine::addModelInstance(const std::vector<std::shared_ptr<OegModel>>& shapes,
+	                                   const glm::vec3& translation, float scale)
+	{
+		// the root carries the placement, every shape of the file becomes a part under it
+		const Entity root = registry.create();
+		registry.transform(root).setTranslation(translation);
+		registry.transform(root).setScale(glm::vec3(scale));
 
-		gameObjects.push_back(std::move(cube));
+		for (const auto& shape : shapes)
+		{
+			const Entity part = registry.create();
+			registry.model(part) = shape;
+			registry.setParent(part, root);
+		}
+		return root;
+	}
+
+	void OegEngine::recordFrameStat(uint64_t frame, FrameStat stat, float value)
+	{
+		if (recordedFrameStats)
+		{
+			recordedFrameStats->set(frame, static_cast<size_t>(stat), value);
+		}
+	}
+
+	void OegEngine::recordRecorderStats(uint64_t frame, const CommandRecorderStats& stats)
+	{
+		recordFrameStat(frame, FrameStat::DrawCalls, static_cast<float>(stats.drawCalls));
+		recordFrameStat(frame, FrameStat::Instances, static_cast<float>(stats.instanceCount));
+		recordFrameStat(frame, FrameStat::Triangles, static_cast<float>(stats.triangleCount));
+		recordFrameStat(frame, FrameStat::Binds, static_cast<float>(stats.bindCalls));
+		recordFrameStat(frame, FrameStat::PushConstants, static_cast<float>(stats.pushConstantCalls));
+	}
+
+	void OegEngine::recordGpuProfile(const GpuFrameProfile& profile)
+	{
+		if (!recordedFrameStats)
+		{
+			return;
+		}
+
+		const GpuPipelineStatistics& statistics = profile.pipelineStatistics;
+		if (statistics.valid)
+		{
+			recordFrameStat(profile.frameId, FrameStat::InputAssemblyPrimitives,
+			                static_cast<float>(statistics.inputAssemblyPrimitives));
+			recordFrameStat(profile.frameId, FrameStat::VertexShaderInvocations,
+			                static_cast<float>(statistics.vertexShaderInvocations));
+			recordFrameStat(profile.frameId, FrameStat::ClippingInvocations,
+			                static_cast<float>(statistics.clippingInvocations));
+			recordFrameStat(profile.frameId, FrameStat::ClippingPrimitives,
+			                static_cast<float>(statistics.clippingPrimitives));
+			recordFrameStat(profile.frameId, FrameStat::FragmentShaderInvocations,
+			                static_cast<float>(statistics.fragmentShaderInvocations));
+		}
+		if (!profile.valid)
+		{
+			return;
+		}
+
+		// a scope can be opened more than once a frame, its column gets the sum. Scopes the frame did not
+		// open, like the culls without GPU-driven rendering, stay unset
+		std::array<float, GPU_SCOPE_STATS.size()> scopeMilliseconds{};
+		std::array<bool, GPU_SCOPE_STATS.size()> scopeOpened{};
+		for (const GpuScopeTime& scope : profile.scopes)
+		{
+			for (size_t i = 0; i < GPU_SCOPE_STATS.size(); i++)
+			{
+				if (std::string_view(scope.name) == GPU_SCOPE_STATS[i].first)
+				{
+					scopeMilliseconds[i] += scope.milliseconds;
+					scopeOpened[i] = true;
+				}
+			}
+		}
+
+		recordFrameStat(profile.frameId, FrameStat::Gpu, profile.frameMilliseconds);
+		for (size_t i = 0; i < GPU_SCOPE_STATS.size(); i++)
+		{
+			if (scopeOpened[i])
+			{
+				recordFrameStat(profile.frameId, GPU_SCOPE_STATS[i].second, scopeMilliseconds[i]);
+			}
+		}
 	}
 
 
@@ -163,6 +901,49 @@ namespace oeg
 			oegDevice.properties.limits.minUniformBufferOffsetAlignment // VkDeviceSize (minOffsetAlignment)
 		);
 		globalUboBuffer->map();
-		simpleRenderSystem = std::make_unique<SimpleRenderSystem>(oegDevice, oegRenderer.getSwapChainRenderPass());
+
+		descriptorAllocator = std::make_unique<OegDescriptorAllocator>(
+			oegDevice,
+			OegSwapChain::MAX_FRAMES_IN_FLIGHT,
+			std::vector<OegDescriptorAllocator::PoolSizeRatio>{
+				{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+				{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+			});
+		globalSetLayout = OegDescriptorSetLayout::Builder(oegDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+			.build();
+
+		// one set per frame in flight, each pointing at its own slice of the ubo buffer
+		for (int i = 0; i < OegSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			VkDescriptorBufferInfo bufferInfo = globalUboBuffer->descriptorInfoForIndex(i);
+			globalDescriptorSets.push_back(
+				OegDescriptorWriter(*globalSetLayout, *descriptorAllocator)
+				.writeBuffer(0, &bufferInfo)
+				.build());
+		}
+
+		simpleRenderSystem = std::make_unique<SimpleRenderSystem>(
+			oegDevice,
+			oegRenderer.getSwapChainRenderPass(),
+			globalSetLayout->getDescriptorSetLayout(),
+			*descriptorAllocator,
+			pipelineManager);
+
+		if (GpuDrivenRenderSystem::isSupported(oegDevice))
+		{
+			// the first snapshot carries the whole scene
+			gpuDrivenRenderSystem = std::make_unique<GpuDrivenRenderSystem>(
+				oegDevice,
+				oegRenderer.getSwapChainRenderPass(),
+				globalSetLayout->getDescriptorSetLayout(),
+				pipelineManager);
+		}
+
+		const PipelineManagerStats pipelineStats = pipelineManager.getStats();
+		std::cout << "pipeline manager: " << pipelineStats.pipelineCount << " pipelines ("
+			<< pipelineStats.deduplicatedRequests << " requests deduplicated), " << pipelineStats.shaderModuleCount
+			<< " shader modules (" << pipelineStats.sharedShaderModules << " shared), "
+			<< pipelineStats.libraryPartCount << " pipeline library parts" << std::endl;
 	}
 } // namespace oeg
@@ -1,27 +1,120 @@
 #pragma once
 
 #include "../engine/oeg_camera.h"
+#include "../engine/oeg_camera_path.h"
 #include "../engine/oeg_device.h"
+#include "../engine/oeg_fixed_timestep.h"
+#include "../engine/oeg_flight_recorder.h"
+#include "../engine/oeg_frame_stats.h"
 #include "../engine/oeg_window.h"
 #include "../engine/oeg_renderer.h"
 #include "../engine/oeg_game_object.h"
 #include "../engine/oeg_buffer.h"
+#include "../engine/oeg_bvh.h"
+#include "../engine/oeg_descriptors.h"
+#include "../engine/oeg_job_system.h"
+#include "../engine/oeg_latest_value.h"
+#include "../engine/oeg_metrics_file.h"
+#include "../engine/oeg_pipeline_manager.h"
+#include "../engine/oeg_registry.h"
+#include "../engine/oeg_scene_graph.h"
+#include "../engine/oeg_snapshot_buffer.h"
+#include "../engine/oeg_trace.h"
+#include "../engine/oeg_transform_updater.h"
 #include "simple_render_system.h"
+#include "gpu_driven_render_system.h"
 #include "key_move_controller.h"
+#include "render_snapshot.h"
 
 #include <chrono>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace oeg
 {
+	struct EngineOptions
+	{
+		// no window and no surface, frames are rendered offscreen as fast as the device allows
+		bool headless{false};
+		// stop after this many frames, 0 runs until the window is closed
+		uint64_t frameCount{0};
+		// "cube" or "grid", see OegEngine::loadGameObjects
+		std::string scene{"cube"};
+		// flown instead of the keyboard camera when not empty
+		OegCameraPath cameraPath;
+		// the keyboard flight is saved here when the engine stops, for later playback
+		std::string recordCameraPathFile;
+		// per-frame stage timings, see FrameStat, needs a frameCount
+		bool recordFrameStats{false};
+		uint64_t warmupFrames{0};
+		// traces from the start and writes the last OegEngine::TRACE_DUMP_SECONDS here when the engine stops
+		std::string traceFile;
+		// writes PREFIX_frameN.json when frame N is a spike, see OegFlightRecorder
+		std::string flightRecorderPrefix;
+		float spikeFactor{OegFlightRecorder::DEFAULT_SPIKE_FACTOR};
+		// rewritten every OegEngine::METRICS_INTERVAL_SECONDS with the newest frame's counters, see OegMetricsFile
+		std::string metricsFile;
+	};
+
+	// columns of the per-frame stats, main thread stages first, then render thread and GPU
+	enum class FrameStat : size_t
+	{
+		Frame,
+		Simulate,
+		Transforms,
+		Bvh,
+		// parts of Bvh, a build only in frames that rebuilt the tree
+		BvhBuild,
+		BvhRefit,
+		// the queries of the frame's culling, after the update
+		BvhQuery,
+		Prepare,
+		SnapshotWait,
+		Record,
+		RenderWait,
+		Gpu,
+		// the GPU scopes of renderFrame
+		GpuUploads,
+		GpuCull,
+		GpuScene,
+		GpuLateCull,
+		// part of GpuLateCull
+		GpuHiZBuild,
+		GpuImGui,
+		// counts of the command recorder
+		DrawCalls,
+		Instances,
+		Triangles,
+		Binds,
+		PushConstants,
+		// pipeline statistics of the scene passes
+		InputAssemblyPrimitives,
+		VertexShaderInvocations,
+		ClippingInvocations,
+		ClippingPrimitives,
+		FragmentShaderInvocations,
+		Count
+	};
+
+	/**
+	 * Input, UI and simulation run on the main thread, which ends every frame by filling a
+	 * RenderSnapshot. The render thread records and presents the snapshots one frame behind, so a
+	 * slow present only delays the main thread once both snapshot slots are in use.
+	 */
 	class OegEngine
 	{
 	public:
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		// of CPU zones and GPU scopes in a trace dump
+		static constexpr float TRACE_DUMP_SECONDS = 5.0f;
+		static constexpr float METRICS_INTERVAL_SECONDS = 1.0f;
 
-		OegEngine();
+		explicit OegEngine(const EngineOptions& options = {});
 
 		~OegEngine();
 
@@ -31,6 +124,10 @@ namespace oeg
 
 		void run();
 
+		// nullptr unless EngineOptions::recordFrameStats, complete once run has returned
+		const OegFrameStats* getFrameStats() const { return recordedFrameStats.get(); }
+		std::string getDeviceName() const { return oegDevice.properties.deviceName; }
+
 	private:
 		void initImGui();
 
@@ -38,22 +135,87 @@ namespace oeg
 
 		void mainLoop();
 
-		void renderFrame(float frameTime);
+		// main thread, one fixed step of everything that moves
+		void simulate(float dt);
+
+		// main thread, simulates and hands the frame to the render thread, false once it has stopped
+		bool submitSnapshot(float frameTime);
+
+		// render thread
+		void renderLoop();
+		void renderFrame(RenderSnapshot& snapshot, RenderThreadStats& frameStats);
+		// runs right before submit, writes the GlobalUbo with the newest camera the main thread has
+		void lateLatchCamera(const RenderSnapshot& snapshot, int frameIndex, RenderThreadStats& frameStats);
+		void updateGlobalUbo(int frameIndex, const GlobalUbo& ubo);
 
-		void updateGlobalUbo(int frameIndex, float frameTime);
+		RenderThreadStats getRenderThreadStats();
+		// main thread, every METRICS_INTERVAL_SECONDS
+		void writeMetrics(const RenderThreadStats& renderThreadStats, float frameTimeMs);
 
 		void loadGameObjects();
+		// a root at translation with every shape as a part under it
+		Entity addModelInstance(const std::vector<std::shared_ptr<OegModel>>& shapes, const glm::vec3& translation,
+		                        float scale);
+
+		// safe from any thread, every thread writes its own columns
+		void recordFrameStat(uint64_t frame, FrameStat stat, float value);
+		void recordRecorderStats(uint64_t frame, const CommandRecorderStats& stats);
+		void recordGpuProfile(const GpuFrameProfile& profile);
 
 		void updateDeltaTime(std::chrono::time_point<std::chrono::high_resolution_clock>& currentTime);
 
-		void updateCamera(OegGameObject& viewerObject, KeyboardMovementController& cameraController);
+		void updateCamera(TransformComponent& viewerTransform, KeyboardMovementController& cameraController);
+
+		// casts a ray through the cursor at window coordinates x, y into the scene BVH
+		void pickEntity(float x, float y);
 
-		OegWindow oegWindow{WIDTH, HEIGHT, "Vulkan App"};
+		EngineOptions options;
+		// first in, last out, everything below may schedule jobs
+		OegJobSystem jobSystem;
+		OegWindow oegWindow;
 		OegDevice oegDevice{oegWindow};
 		OegRenderer oegRenderer{oegWindow, oegDevice};
+		OegPipelineManager pipelineManager{oegDevice};
+		std::unique_ptr<OegDescriptorAllocator> descriptorAllocator;
+		std::unique_ptr<OegDescriptorSetLayout> globalSetLayout;
 		std::unique_ptr<OegBuffer> globalUboBuffer;
+		std::vector<VkDescriptorSet> globalDescriptorSets;
 		std::unique_ptr<SimpleRenderSystem> simpleRenderSystem;
-		std::vector<OegGameObject> gameObjects;
+		std::unique_ptr<GpuDrivenRenderSystem> gpuDrivenRenderSystem;
+		RenderSettings renderSettings{};
+		OegRegistry registry;
+		OegTransformUpdater transformUpdater;
+		OegSceneGraph sceneGraph;
+		OegBvh sceneBvh;
+		Entity pickedEntity{};
 		OegCamera camera;
+
+		// simulation runs at a fixed rate, the camera is drawn between its last two steps
+		OegFixedTimestep simulationClock;
+		KeyboardMovementController cameraController;
+		// the camera is not drawn, so it lives outside the registry
+		TransformComponent viewerTransform{};
+		TransformComponent previousViewerTransform{};
+		float simulationTime{0.0f};
+		OegCameraPath recordedCameraPath;
+
+		std::unique_ptr<OegFrameStats> recordedFrameStats;
+		std::unique_ptr<OegFlightRecorder> flightRecorder;
+		std::unique_ptr<OegMetricsFile> metricsFile;
+		std::chrono::steady_clock::time_point lastMetricsWriteTime{};
+
+		OegSnapshotBuffer<RenderSnapshot> snapshots;
+		std::thread renderThread;
+		std::exception_ptr renderThreadException;
+		uint64_t frameNumber{0};
+		// layout of the registry the last snapshot's scene changes were captured against
+		uint64_t snapshotLayoutVersion{~0ull};
+		float snapshotWaitMs{0.0f};
+		// when glfwPollEvents last returned, the input the current frame follows from
+		std::chrono::steady_clock::time_point inputTime{};
+		OegLatestValue<LatchedCamera> latestCamera;
+
+		std::mutex renderStatsMutex;
+		RenderThreadStats renderStats{};
 	};
 } // namespace oeg
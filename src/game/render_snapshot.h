@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../engine/oeg_camera.h"
+#include "../engine/oeg_command_recorder.h"
+#include "../engine/oeg_gpu_profiler.h"
+#include "../engine/oeg_imgui_draw_data.h"
+#include "simple_render_system.h"
+#include "gpu_driven_render_system.h"
+
+// 3rd party
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "glm/glm.hpp"
+
+// std
+#include <chrono>
+#include <cstdint>
+
+namespace oeg
+{
+	struct alignas(16) GlobalUbo
+	{
+		glm::mat4 projectionView{1.0f};
+		glm::vec3 directionToLight = normalize(glm::vec3(1.0f, -3.0f, -1.0f));
+	};
+
+	// choices made in the UI that the render thread applies to its render systems
+	struct RenderSettings
+	{
+		bool gpuDrivenRendering{false};
+		bool occlusionCulling{true};
+		LightingMode lightingMode{LightingMode::Diffuse};
+		TransformMode transformMode{TransformMode::Matrix};
+		// replace the snapshot's camera with the newest one right before submit
+		bool lateLatchCamera{true};
+	};
+
+	// camera of the newest main thread frame, and when the input it follows from was polled
+	struct LatchedCamera
+	{
+		glm::mat4 projectionView{1.0f};
+		std::chrono::steady_clock::time_point inputTime{};
+	};
+
+	/**
+	 * Everything the render thread needs for one frame, filled by the simulation thread. Nothing in it
+	 * points into the registry or ImGui, so the simulation can move on to the next frame while this one
+	 * is recorded.
+	 */
+	struct RenderSnapshot
+	{
+		uint64_t frameNumber{0};
+		float frameTime{0.0f};
+		OegCamera camera;
+		GlobalUbo ubo{};
+		// when the input the camera follows from was polled
+		std::chrono::steady_clock::time_point inputTime{};
+		RenderSettings settings{};
+
+		// only filled when the simple render system draws this frame
+		SimpleDrawPacket simpleDraws;
+		// filled whenever the GPU-driven render system exists, it has to see every change
+		SceneChanges sceneChanges;
+		OegImGuiDrawData imguiDrawData;
+	};
+
+	// written by the render thread after every frame, read by the UI
+	struct RenderThreadStats
+	{
+		CommandRecorderStats recorderStats{};
+		OcclusionStats occlusionStats{};
+		bool lightingModeReady{true};
+		float renderTimeMs{0.0f};
+		// time the render thread waited for a snapshot, high when the simulation is the bottleneck
+		float snapshotWaitMs{0.0f};
+		// input poll to submit of the camera the frame was drawn with, and of the snapshot's own camera
+		float inputToSubmitMs{0.0f};
+		float snapshotInputToSubmitMs{0.0f};
+		// scopes of the newest frame the GPU has finished, a few frames behind the others
+		GpuFrameProfile gpuProfile{};
+		// written to mapped buffers while recording
+		uint64_t uploadBytes{0};
+	};
+}
@@ -0,0 +1,40 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 boundingSphere;
+    uvec4 drawInfo;
+};
+
+// firstInstance of each indirect draw is the object index, so gl_InstanceIndex selects the object
+layout(std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// written right before submit, see OegRenderer::endFrame
+layout(set = 1, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    vec3 directionToLight;
+} ubo;
+
+const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+const float AMBIENT = 0.02;
+
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+    gl_Position = ubo.projectionView * object.modelMatrix * vec4(position, 1.0);
+
+    vec3 normalWorldSpace = normalize(mat3(object.normalMatrix) * normal);
+
+    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0);
+
+    fragColor = lightIntensity * color;
+}
@@ -0,0 +1,50 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    vec3 directionToLight;
+} ubo;
+
+// PackedTransform, 10 tightly packed floats per object: rotation quaternion xyzw, translation xyz, scale xyz
+// firstInstance of each draw is the object's slot, so gl_InstanceIndex selects it
+layout(std430, set = 1, binding = 0) readonly buffer TransformBuffer {
+    float transforms[];
+};
+
+// 0 = diffuse, 1 = world space normals, 2 = unlit vertex color
+layout(constant_id = 0) const uint LIGHTING_MODE = 0;
+
+const float AMBIENT = 0.02;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    uint base = uint(gl_InstanceIndex) * 10u;
+    vec4 rotation = vec4(transforms[base + 0], transforms[base + 1], transforms[base + 2], transforms[base + 3]);
+    vec3 translation = vec3(transforms[base + 4], transforms[base + 5], transforms[base + 6]);
+    vec3 scale = vec3(transforms[base + 7], transforms[base + 8], transforms[base + 9]);
+
+    // model matrix is translate * rotate * scale, its inverse transpose is rotate * (1 / scale)
+    vec3 positionWorld = translation + rotate(rotation, scale * position);
+    gl_Position = ubo.projectionView * vec4(positionWorld, 1.0);
+
+    vec3 normalWorldSpace = normalize(rotate(rotation, normal / scale));
+
+    if (LIGHTING_MODE == 1) {
+        fragColor = normalWorldSpace * 0.5 + 0.5;
+    } else if (LIGHTING_MODE == 2) {
+        fragColor = color;
+    } else {
+        float lightIntensity = AMBIENT + max(dot(normalWorldSpace, ubo.directionToLight), 0);
+        fragColor = lightIntensity * color;
+    }
+}
\ No newline at end of file
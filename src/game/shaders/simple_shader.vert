@@ -7,20 +7,33 @@ layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 fragColor;
 
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionView;
+    vec3 directionToLight;
+} ubo;
+
 layout(push_constant) uniform Push {
-    mat4 transform;// projection * view * model
+    mat4 modelMatrix;
     mat4 normalMatrix;
 } push;
 
-const vec3 DIRECTION_TO_LIGHT = normalize(vec3(1.0, -3.0, -1.0));
+// 0 = diffuse, 1 = world space normals, 2 = unlit vertex color
+layout(constant_id = 0) const uint LIGHTING_MODE = 0;
+
 const float AMBIENT = 0.02;
 
 void main() {
-    gl_Position = push.transform * vec4(position, 1.0);
+    gl_Position = ubo.projectionView * push.modelMatrix * vec4(position, 1.0);
 
+    // computed on the CPU, exact under a non uniformly scaled parent where the model matrix has shear
     vec3 normalWorldSpace = normalize(mat3(push.normalMatrix) * normal);
 
-    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, DIRECTION_TO_LIGHT), 0);
-
-    fragColor = lightIntensity * color;
+    if (LIGHTING_MODE == 1) {
+        fragColor = normalWorldSpace * 0.5 + 0.5;
+    } else if (LIGHTING_MODE == 2) {
+        fragColor = color;
+    } else {
+        float lightIntensity = AMBIENT + max(dot(normalWorldSpace, ubo.directionToLight), 0);
+        fragColor = lightIntensity * color;
+    }
 }
\ No newline at end of file
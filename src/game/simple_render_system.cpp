@@ -1,46 +1,88 @@
 #include "simple_render_system.h"
 
+#include "../engine/oeg_swap_chain.h"
+#include "../engine/oeg_trace.h"
+
 // 3rd party
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm/glm.hpp"
 #include "glm/gtc/constants.hpp"
 
 // std
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 namespace oeg
 {
+	// projection * view comes from the GlobalUbo at set 0. The normal matrix is the world transform's,
+	// a child of a non uniformly scaled parent has shear that rescaling model matrix columns gets wrong.
+	// 128 bytes, the push constant size every device has
 	struct SimplePushConstantData
 	{
-		glm::mat4 transform{1.f};
+		glm::mat4 modelMatrix{1.f};
 		glm::mat4 normalMatrix{1.f};
 	};
 
-	SimpleRenderSystem::SimpleRenderSystem(OegDevice& device, VkRenderPass renderPass)
-		: oegDevice{device}
+	static constexpr const char* VERT_SHADER_FILEPATH = "shaders/simple_shader.vert.spv";
+	static constexpr const char* PACKED_VERT_SHADER_FILEPATH = "shaders/packed_transform_shader.vert.spv";
+	static constexpr const char* FRAG_SHADER_FILEPATH = "shaders/simple_shader.frag.spv";
+
+	// first size of the per frame transform buffers, they grow with the visible object count
+	static constexpr uint32_t INITIAL_TRANSFORM_CAPACITY = 256;
+
+	SimpleRenderSystem::SimpleRenderSystem(
+		OegDevice& device,
+		VkRenderPass renderPass,
+		VkDescriptorSetLayout globalSetLayout,
+		OegDescriptorAllocator& descriptorAllocator,
+		OegPipelineManager& pipelineManager)
+		: oegDevice{device}, descriptorAllocator{descriptorAllocator}, pipelineManager{pipelineManager}
 	{
-		createPipelineLayout();
+		for (auto& variants : pipelineVariants)
+		{
+			variants.fill(OegPipelineManager::INVALID_PIPELINE);
+		}
+		transformSetLayout = OegDescriptorSetLayout::Builder(oegDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+		transformBuffers.resize(OegSwapChain::MAX_FRAMES_IN_FLIGHT);
+		transformDescriptorSets.resize(OegSwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+		for (int i = 0; i < OegSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			reserveTransforms(i, INITIAL_TRANSFORM_CAPACITY);
+		}
+
+		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem()
 	{
+		// a variant may still be compiling against the layout
+		pipelineManager.waitIdle();
 		vkDestroyPipelineLayout(oegDevice.device(), pipelineLayout, nullptr);
 	}
 
-	void SimpleRenderSystem::createPipelineLayout()
+	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
 	{
 		VkPushConstantRange pushConstantRange{
 			// in order: stageFlags, offset, size
-			VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			VK_SHADER_STAGE_VERTEX_BIT,
 			0,
 			sizeof(SimplePushConstantData)
 		};
 
+		// set 1 is only read by the packed transform shader
+		const std::array<VkDescriptorSetLayout, 2> setLayouts{
+			globalSetLayout,
+			transformSetLayout->getDescriptorSetLayout()
+		};
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 		pipelineLayoutInfo.pushConstantRangeCount = 1;
 		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		if (vkCreatePipelineLayout(oegDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
@@ -52,42 +94,279 @@ namespace oeg
 	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
 	{
 		assert(pipelineLayout != nullptr && "Cant create pipeline before pipeline layout");
-		PipelineConfigInfo pipelineConfig{};
 		OegPipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = renderPass;
 		pipelineConfig.pipelineLayout = pipelineLayout;
-		oegPipeline = std::make_unique<OegPipeline>(
-			oegDevice,
-			"shaders/simple_shader.vert.spv",
-			"shaders/simple_shader.frag.spv",
+
+		// the diffuse variant is the shader's default and the fallback for every other lighting mode,
+		// both transform modes need their own since they read the transform differently
+		variant(TransformMode::Matrix, LightingMode::Diffuse) = pipelineManager.createPipeline(
+			VERT_SHADER_FILEPATH,
+			FRAG_SHADER_FILEPATH,
 			pipelineConfig);
+		variant(TransformMode::Packed, LightingMode::Diffuse) = pipelineManager.createPipeline(
+			PACKED_VERT_SHADER_FILEPATH,
+			FRAG_SHADER_FILEPATH,
+			pipelineConfig);
+	}
+
+	void SimpleRenderSystem::requestVariant(VkRenderPass renderPass)
+	{
+		pipelineConfig.renderPass = renderPass;
+
+		PipelineHandle& handle = variant(transformMode, lightingMode);
+		if (handle == OegPipelineManager::INVALID_PIPELINE)
+		{
+			SpecializationConstants specialization{};
+			specialization.set(0, static_cast<uint32_t>(lightingMode));
+			handle = pipelineManager.requestPipeline(
+				transformMode == TransformMode::Packed ? PACKED_VERT_SHADER_FILEPATH : VERT_SHADER_FILEPATH,
+				FRAG_SHADER_FILEPATH,
+				pipelineConfig,
+				specialization,
+				variant(transformMode, LightingMode::Diffuse));
+		}
 	}
 
+	void SimpleRenderSystem::setLightingMode(LightingMode mode, VkRenderPass renderPass)
+	{
+		lightingMode = mode;
+		requestVariant(renderPass);
+	}
 
-	void SimpleRenderSystem::renderGameObjects(
-		FrameInfo& frameInfo,
-		std::vector<OegGameObject>& gameObjects)
+	void SimpleRenderSystem::setTransformMode(TransformMode mode, VkRenderPass renderPass)
 	{
-		oegPipeline->bind(frameInfo.commandBuffer);
+		transformMode = mode;
+		requestVariant(renderPass);
+	}
+
+	/**
+		* Only called for the frame being recorded, whose previous submission has finished, so the old
+		* buffer can go and the frame's descriptor set can be rewritten in place.
+	*/
+	void SimpleRenderSystem::reserveTransforms(int frameIndex, size_t count)
+	{
+		std::unique_ptr<OegBuffer>& buffer = transformBuffers[frameIndex];
+		if (buffer && buffer->getInstanceCount() >= count)
+		{
+			return;
+		}
 
-		auto projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+		const size_t capacity = std::max(count, buffer ? static_cast<size_t>(buffer->getInstanceCount()) * 2 : count);
+		buffer = std::make_unique<OegBuffer>(
+			oegDevice,
+			sizeof(PackedTransform),
+			static_cast<uint32_t>(capacity),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			oegDevice.getAllocator(),
+			1);
+		buffer->map();
 
-		for (auto& obj : gameObjects)
+		VkDescriptorBufferInfo bufferInfo = buffer->descriptorInfo();
+		OegDescriptorWriter writer{*transformSetLayout, descriptorAllocator};
+		writer.writeBuffer(0, &bufferInfo);
+		if (transformDescriptorSets[frameIndex] == VK_NULL_HANDLE)
+		{
+			transformDescriptorSets[frameIndex] = writer.build();
+		}
+		else
+		{
+			writer.overwrite(transformDescriptorSets[frameIndex]);
+		}
+	}
+
+	void SimpleRenderSystem::prepare(
+		const OegCamera& camera,
+		const OegRegistry& registry,
+		const OegSceneGraph& sceneGraph,
+		const OegBvh& bvh,
+		TransformMode mode,
+		SimpleDrawPacket& packet)
+	{
+		const bool packed = mode == TransformMode::Packed;
+		const std::vector<WorldTransform>& worldTransforms = registry.getWorldTransforms();
+		const std::vector<std::shared_ptr<OegModel>>& models = registry.getModels();
+
+		// the BVH already holds world space bounds, the spheres are only needed for the flat culler
+		const bool bvhCulling = enableFrustumCulling && enableBvhCulling;
+
+		// the spheres only follow the dirty ranges while no propagate and no layout change was missed and
+		// the last prepare kept them, otherwise every entity is redone once
+		const bool continuous = registry.getLayoutVersion() == cachedLayoutVersion &&
+			sceneGraph.getPropagateCount() == cachedPropagateCount + 1;
+		const bool resphereAll = !continuous || !spheresCached;
+		cachedLayoutVersion = registry.getLayoutVersion();
+		cachedPropagateCount = sceneGraph.getPropagateCount();
+		spheresCached = !bvhCulling;
+
+		// every entity only writes its own slot, so all of them can be handed out to worker threads.
+		// A static scene has no dirty ranges and costs nothing here.
+		// Entities without a model, like assembly roots, get an empty sphere and are skipped below
+		if (!bvhCulling)
+		{
+			frustumCuller.resize(registry.size());
+			auto updateSpheres = [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (!models[i])
+					{
+						frustumCuller.setSphere(i, BoundingSphere{});
+					}
+					else if (packed)
+					{
+						frustumCuller.setSphere(
+							i, transformSphere(models[i]->getBoundingSphere(), worldTransforms[i].packed));
+					}
+					else
+					{
+						frustumCuller.setSphere(
+							i, transformSphere(models[i]->getBoundingSphere(), worldTransforms[i].modelMatrix));
+					}
+				}
+			};
+			if (resphereAll)
+			{
+				registry.parallelFor(updateSpheres);
+			}
+			else
+			{
+				for (const DirtyRange& range : sceneGraph.getDirtyRanges())
+				{
+					updateSpheres(range.first, range.first + range.count);
+				}
+			}
+		}
+
+		if (bvhCulling)
+		{
+			const auto startTime = std::chrono::high_resolution_clock::now();
+			bvh.queryFrustum(camera.getFrustumPlanes(), visibleObjects);
+			const auto endTime = std::chrono::high_resolution_clock::now();
+
+			bvhCullingStats.testedCount = static_cast<uint32_t>(registry.size());
+			bvhCullingStats.visibleCount = static_cast<uint32_t>(visibleObjects.size());
+			bvhCullingStats.culledCount = bvhCullingStats.testedCount - bvhCullingStats.visibleCount;
+			bvhCullingStats.cullTimeMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+		}
+		else if (enableFrustumCulling)
+		{
+			frustumCuller.cull(camera.getFrustumPlanes(), visibleObjects);
+		}
+		else
+		{
+			visibleObjects.resize(registry.size());
+			for (uint32_t i = 0; i < visibleObjects.size(); i++)
+			{
+				visibleObjects[i] = i;
+			}
+		}
+
+		// opaque draws go front to back within each model so early depth testing rejects more fragments
+		const glm::mat4& view = camera.getView();
+		const glm::vec4 viewDepthRow{view[0][2], view[1][2], view[2][2], view[3][2]};
+		drawList.clear();
+		for (uint32_t objectIndex : visibleObjects)
+		{
+			if (!models[objectIndex])
+			{
+				continue;
+			}
+			const glm::vec3 center{worldTransforms[objectIndex].modelMatrix[3]};
+			const float viewDepth = glm::dot(viewDepthRow, glm::vec4{center, 1.0f});
+			drawList.add(OegDrawList::makeSortKey(0, models[objectIndex]->getId(), viewDepth), objectIndex);
+		}
+		drawList.sort();
+
+		// draws of one model are adjacent after the sort, so one reference per run keeps them all alive
+		packet.transformMode = mode;
+		packet.models.clear();
+		packet.modelMatrices.clear();
+		packet.normalMatrices.clear();
+		packet.packedTransforms.clear();
+		packet.modelReferences.clear();
+		for (const auto& item : drawList.getItems())
+		{
+			const std::shared_ptr<OegModel>& model = models[item.objectIndex];
+			if (packet.modelReferences.empty() || packet.modelReferences.back() != model)
+			{
+				packet.modelReferences.push_back(model);
+			}
+			packet.models.push_back(model.get());
+			if (packed)
+			{
+				packet.packedTransforms.push_back(worldTransforms[item.objectIndex].packed);
+			}
+			else
+			{
+				packet.modelMatrices.push_back(worldTransforms[item.objectIndex].modelMatrix);
+				packet.normalMatrices.push_back(glm::mat4{worldTransforms[item.objectIndex].normalMatrix});
+			}
+		}
+	}
+
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, const SimpleDrawPacket& packet)
+	{
+		OEG_TRACE_ZONE("renderGameObjects");
+		OegCommandRecorder& recorder = frameInfo.recorder;
+		pipelineManager.bind(variant(packet.transformMode, lightingMode), recorder);
+		recorder.bindDescriptorSets(
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0,
+			1,
+			&frameInfo.globalDescriptorSet);
+
+		if (packet.transformMode == TransformMode::Packed)
+		{
+			renderPacked(frameInfo, packet);
+			return;
+		}
+
+		for (size_t i = 0; i < packet.models.size(); i++)
 		{
 			SimplePushConstantData push{};
-			auto modelMatrix = obj.transform.mat4();
-			push.transform = projectionView * modelMatrix;
-			push.normalMatrix = obj.transform.normalMatrix();
+			push.modelMatrix = packet.modelMatrices[i];
+			push.normalMatrix = packet.normalMatrices[i];
 
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
+			recorder.pushConstants(
 				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				VK_SHADER_STAGE_VERTEX_BIT,
 				0,
 				sizeof(SimplePushConstantData),
 				&push);
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+			// repeated binds of the same model are dropped by the recorder
+			packet.models[i]->bind(recorder);
+			packet.models[i]->draw(recorder);
+		}
+	}
+
+	void SimpleRenderSystem::renderPacked(FrameInfo& frameInfo, const SimpleDrawPacket& packet)
+	{
+		const size_t drawCount = packet.models.size();
+		reserveTransforms(frameInfo.frameIndex, drawCount);
+
+		OegBuffer& transformBuffer = *transformBuffers[frameInfo.frameIndex];
+		auto* transforms = static_cast<PackedTransform*>(transformBuffer.getMappedMemory());
+
+		OegCommandRecorder& recorder = frameInfo.recorder;
+		recorder.bindDescriptorSets(
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			1,
+			1,
+			&transformDescriptorSets[frameInfo.frameIndex]);
+
+		OegBuffer::countUpload(drawCount * sizeof(PackedTransform));
+		// slots follow draw order, the slot travels as firstInstance so no push constants are needed
+		for (uint32_t slot = 0; slot < drawCount; slot++)
+		{
+			transforms[slot] = packet.packedTransforms[slot];
+
+			packet.models[slot]->bind(recorder);
+			packet.models[slot]->draw(recorder, slot);
 		}
+		transformBuffer.flush(drawCount * sizeof(PackedTransform));
 	}
 }
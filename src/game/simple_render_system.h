@@ -1,36 +1,152 @@
 #pragma once
 
 // my shit
+#include "../engine/oeg_buffer.h"
+#include "../engine/oeg_bvh.h"
 #include "../engine/oeg_camera.h"
+#include "../engine/oeg_descriptors.h"
 #include "../engine/oeg_device.h"
+#include "../engine/oeg_draw_list.h"
 #include "../engine/oeg_game_object.h"
+#include "../engine/oeg_registry.h"
+#include "../engine/oeg_scene_graph.h"
 #include "../engine/oeg_pipeline.h"
+#include "../engine/oeg_pipeline_manager.h"
 #include "../engine/oeg_frame_info.h"
+#include "../engine/oeg_frustum_culler.h"
 
 
 // std
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace oeg
 {
+	enum class LightingMode : uint32_t
+	{
+		Diffuse = 0,
+		Normals = 1,
+		Unlit = 2,
+		Count
+	};
+
+	enum class TransformMode : uint32_t
+	{
+		Matrix = 0, // model matrix built on the CPU, pushed per draw
+		Packed = 1, // PackedTransform uploaded to a storage buffer, expanded in the vertex shader
+		Count
+	};
+
+	/**
+	 * One frame's draws in submission order. Built by SimpleRenderSystem::prepare on the simulation
+	 * thread and recorded by renderGameObjects on the render thread, so it owns everything it refers to.
+	 */
+	struct SimpleDrawPacket
+	{
+		TransformMode transformMode{TransformMode::Matrix};
+		std::vector<OegModel*> models;
+		// one per draw, only the arrays of transformMode are filled
+		std::vector<glm::mat4> modelMatrices;
+		std::vector<glm::mat4> normalMatrices;
+		std::vector<PackedTransform> packedTransforms;
+		// keeps the drawn models alive while the packet waits for the render thread
+		std::vector<std::shared_ptr<OegModel>> modelReferences;
+	};
+
+	/**
+	 * prepare, the culling switches and the culling and draw list stats belong to the simulation
+	 * thread, everything else to the render thread.
+	 */
 	class SimpleRenderSystem
 	{
 	public:
-		SimpleRenderSystem(OegDevice& device, VkRenderPass renderPass);
+		SimpleRenderSystem(
+			OegDevice& device,
+			VkRenderPass renderPass,
+			VkDescriptorSetLayout globalSetLayout,
+			OegDescriptorAllocator& descriptorAllocator,
+			OegPipelineManager& pipelineManager);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
-		void renderGameObjects(FrameInfo& frameInfo, std::vector<OegGameObject>& gameObjects);
+		/**
+		 * \brief Culls and sorts the registry's entities for camera into packet. Culling spheres are kept
+		 * between calls and only redone for sceneGraph's dirty ranges, so it has to be called after every
+		 * propagate or it redoes them all
+		 */
+		void prepare(
+			const OegCamera& camera,
+			const OegRegistry& registry,
+			const OegSceneGraph& sceneGraph,
+			const OegBvh& bvh,
+			TransformMode mode,
+			SimpleDrawPacket& packet);
+		void renderGameObjects(FrameInfo& frameInfo, const SimpleDrawPacket& packet);
+
+		const CullingStats& getCullingStats() const
+		{
+			return enableBvhCulling ? bvhCullingStats : frustumCuller.getStats();
+		}
+		const DrawListStats& getDrawListStats() const { return drawList.getStats(); }
+
+		/**
+		 * \brief Variants other than diffuse are compiled in the background the first time they are picked,
+		 * against renderPass since the swapchain may have been recreated after construction
+		 */
+		void setLightingMode(LightingMode mode, VkRenderPass renderPass);
+		LightingMode getLightingMode() const { return lightingMode; }
+		bool isLightingModeReady() const { return pipelineManager.isReady(variant(transformMode, lightingMode)); }
+
+		void setTransformMode(TransformMode mode, VkRenderPass renderPass);
+		TransformMode getTransformMode() const { return transformMode; }
+
+		bool enableFrustumCulling{true};
+		// frustum culling walks the scene BVH instead of testing every bounding sphere
+		bool enableBvhCulling{false};
 
 	private:
-		void createPipelineLayout();
+		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
 		void createPipeline(VkRenderPass renderPass);
+		// requests the pipeline for the current transform and lighting mode if it does not exist yet
+		void requestVariant(VkRenderPass renderPass);
+		void reserveTransforms(int frameIndex, size_t count);
+		void renderPacked(FrameInfo& frameInfo, const SimpleDrawPacket& packet);
+
+		PipelineHandle& variant(TransformMode transform, LightingMode lighting)
+		{
+			return pipelineVariants[static_cast<size_t>(transform)][static_cast<size_t>(lighting)];
+		}
+		PipelineHandle variant(TransformMode transform, LightingMode lighting) const
+		{
+			return pipelineVariants[static_cast<size_t>(transform)][static_cast<size_t>(lighting)];
+		}
 
 		OegDevice& oegDevice;
+		OegDescriptorAllocator& descriptorAllocator;
+		OegPipelineManager& pipelineManager;
 
-		std::unique_ptr<OegPipeline> oegPipeline;
+		PipelineConfigInfo pipelineConfig{};
+		std::array<
+			std::array<PipelineHandle, static_cast<size_t>(LightingMode::Count)>,
+			static_cast<size_t>(TransformMode::Count)> pipelineVariants;
+		LightingMode lightingMode{LightingMode::Diffuse};
+		TransformMode transformMode{TransformMode::Matrix};
 		VkPipelineLayout pipelineLayout;
+
+		// per frame in flight, set 1 of the packed transform shader
+		std::unique_ptr<OegDescriptorSetLayout> transformSetLayout;
+		std::vector<std::unique_ptr<OegBuffer>> transformBuffers;
+		std::vector<VkDescriptorSet> transformDescriptorSets;
+		// what the culler's spheres were last brought up to date against
+		uint64_t cachedLayoutVersion{~0ull};
+		uint64_t cachedPropagateCount{~0ull};
+		bool spheresCached{false};
+
+		OegFrustumCuller frustumCuller;
+		CullingStats bvhCullingStats{};
+		std::vector<uint32_t> visibleObjects;
+		OegDrawList drawList;
 	};
 }